@@ -37,12 +37,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <math.h>
 #include <string.h>
 #include "serialize.h"
+#include "enclave.h"
 
-void *(*gmp_realloc_func)(void *, size_t, size_t);
-void (*gmp_free_func)(void *, size_t);
-
-void *reallocate_function(void *, size_t, size_t);
-void free_function(void *, size_t);
+void *(*gmp_alloc_func)(size_t)= NULL;
+void *(*gmp_realloc_func)(void *, size_t, size_t)= NULL;
+void (*gmp_free_func)(void *, size_t)= NULL;
 
 void e_calc_pi (mpf_t *pi, uint64_t digits);
 
@@ -53,40 +52,142 @@ void e_calc_pi (mpf_t *pi, uint64_t digits);
 
 char *result;
 size_t len_result= 0;
+size_t size_result= 0;
 
 void tgmp_init()
 {
 	result= NULL;
 	len_result= 0;
+	size_result= 0;
+
+	/* Don't wrap our own hooks if we're called twice. */
+
+	if ( gmp_free_func != NULL ) return;
+
+	mp_get_memory_functions(&gmp_alloc_func, &gmp_realloc_func,
+		&gmp_free_func);
+	mp_set_memory_functions(&allocate_function, &reallocate_function,
+		&free_function);
+}
+
+/*
+ * Every GMP allocation in the enclave comes through these, so they also
+ * keep the heap accounting in heap.c. When the heap runs out, the
+ * scratch pools and then the result cache give back what they're
+ * keeping, and the allocation is tried again.
+ */
+
+void *allocate_function (size_t sz)
+{
+	void *ptr;
 
-	mp_get_memory_functions(NULL, &gmp_realloc_func, &gmp_free_func);
-	mp_set_memory_functions(NULL, &reallocate_function, &free_function);
+	if ( ! in_enclave() ) return gmp_alloc_func(sz);
+
+	ptr= gmp_alloc_func(sz);
+	if ( ptr == NULL && scratch_trim() ) ptr= gmp_alloc_func(sz);
+	if ( ptr == NULL && memo_trim() ) ptr= gmp_alloc_func(sz);
+
+	heap_note_alloc(sz, ptr != NULL);
+
+	return ptr;
 }
 
 void free_function (void *ptr, size_t sz)
 {
+	if ( ! in_enclave() ) {
+		gmp_free_func(ptr, sz);
+		return;
+	}
+
 	if ( sgx_is_within_enclave(ptr, sz) ) gmp_free_func(ptr, sz);
 	else abort();
+
+	heap_note_free(sz);
 }
 
 void *reallocate_function (void *ptr, size_t osize, size_t nsize)
 {
+	void *nptr;
+
+	if ( ! in_enclave() ) return gmp_realloc_func(ptr, osize, nsize);
 	if ( ! sgx_is_within_enclave(ptr, osize) ) abort();
 
-	return gmp_realloc_func(ptr, osize, nsize);
+	nptr= gmp_realloc_func(ptr, osize, nsize);
+	if ( nptr == NULL && scratch_trim() )
+		nptr= gmp_realloc_func(ptr, osize, nsize);
+	if ( nptr == NULL && memo_trim() )
+		nptr= gmp_realloc_func(ptr, osize, nsize);
+	heap_note_realloc(osize, nsize, nptr != NULL);
+
+	return nptr;
+}
+
+void result_clear ()
+{
+	if ( result != NULL ) {
+		free_function(result, size_result);
+		result= NULL;
+		len_result= 0;
+		size_result= 0;
+	}
+}
+
+/*
+ * Binary results are exactly len bytes long. Strings also have their
+ * terminating NULL, which the application doesn't fetch.
+ */
+
+size_t result_set (char *buf, size_t len)
+{
+	result_clear();
+
+	result= buf;
+	len_result= len;
+	size_result= len;
+
+	return len_result;
+}
+
+/* The pending result, its length, and the size of its buffer */
+
+const char *result_get (size_t *len, size_t *size)
+{
+	*len= len_result;
+	*size= size_result;
+
+	return result;
+}
+
+size_t result_set_str (char *str)
+{
+	result_clear();
+
+	if ( str == NULL ) return 0;
+
+	result= str;
+	len_result= strlen(str);
+	size_result= len_result+1;
+
+	return len_result;
 }
 
 int e_get_result(char *str, size_t len)
 {
+	uint64_t start;
+
 	/* Make sure the application doesn't ask for more bytes than 
 	 * were allocated for the result. */
 
 	if ( len > len_result ) return 0;
 
+	start= stats_start();
+
 	/*
 	 * Marshal our result out of the enclave. Make sure the destination
 	 * buffer is completely outside the enclave, and that what we are
 	 * copying is completely inside the enclave.
+	 *
+	 * Batch results are binary, so copy bytes rather than a string.
 	 */
 
 	if ( result == NULL || str == NULL || len == 0 ) return 0;
@@ -94,12 +195,12 @@ int e_get_result(char *str, size_t len)
 	if ( ! sgx_is_within_enclave(result, len) ) return 0;
 
 	if ( sgx_is_outside_enclave(str, len+1) ) { /* Include terminating NULL */
-		strncpy(str, result, len); 
+		memcpy(str, result, len);
 		str[len]= '\0';
 
-		gmp_free_func(result, NULL);
-		result= NULL;
-		len_result= 0;
+		result_clear();
+
+		stats_record(STATS_GET_RESULT, start, 0, len);
 
 		return 1;
 	}
@@ -107,9 +208,32 @@ int e_get_result(char *str, size_t len)
 	return 0;
 }
 
+/*
+ * The string ECALLs below look in the result cache before doing any
+ * work, and cache what they compute. A hit is recorded like any other
+ * successful call.
+ */
+
+static size_t cached (int op, uint64_t param, char *str_a, char *str_b,
+	uint64_t start)
+{
+	size_t len_a= strlen(str_a), len_b= strlen(str_b), len;
+
+	len= memo_get(op, param, str_a, len_a, str_b, len_b);
+	if ( len ) stats_record(op, start, len_a+len_b, len);
+
+	return len;
+}
+
+static void cache (int op, uint64_t param, char *str_a, char *str_b)
+{
+	memo_put(op, param, str_a, strlen(str_a), str_b, strlen(str_b));
+}
+
 size_t e_mpz_add(char *str_a, char *str_b)
 {
-	mpz_t a, b, c;
+	mpz_t *a, *b, *c;
+	uint64_t start;
 
 	/*
 	 * Marshal untrusted values into the enclave so we don't accidentally
@@ -121,137 +245,174 @@ size_t e_mpz_add(char *str_a, char *str_b)
 
 	if ( str_a == NULL || str_b == NULL ) return 0;
 
+	start= stats_start();
+
 	/* Clear the last, serialized result */
 
-	if ( result != NULL ) {
-		gmp_free_func(result, NULL);
-		result= NULL;
-		len_result= 0;
-	}
+	result_clear();
 
-	mpz_inits(a, b, c, NULL);
+	if ( cached(STATS_MPZ_ADD, 0, str_a, str_b, start) ) return len_result;
+
+	scratch_open();
+	a= scratch_mpz();
+	b= scratch_mpz();
+	c= scratch_mpz();
 
 	/* Deserialize */
 
-	if ( mpz_deserialize(&a, str_a) == -1 ) return 0;
-	if ( mpz_deserialize(&b, str_b) == -1 ) return 0;
+	if ( mpz_deserialize(a, str_a) == -1 ) goto cleanup;
+	if ( mpz_deserialize(b, str_b) == -1 ) goto cleanup;
 
-	mpz_add(c, a, b);
+	mpz_add(*c, *a, *b);
 
 	/* Serialize the result */
 
-	result= mpz_serialize(c);
-	if ( result == NULL ) return 0;
+	if ( result_set_str(mpz_serialize(*c)) ) {
+		cache(STATS_MPZ_ADD, 0, str_a, str_b);
+		stats_record(STATS_MPZ_ADD, start, strlen(str_a)+strlen(str_b),
+			len_result);
+	}
+
+cleanup:
+	scratch_close();
 
-	len_result= strlen(result);
 	return len_result;
 }
 
 size_t e_mpz_mul(char *str_a, char *str_b)
 {
-	mpz_t a, b, c;
+	mpz_t *a, *b, *c;
+	uint64_t start;
 
 	/* Marshal untrusted values into the enclave. */
 
 	if ( str_a == NULL || str_b == NULL ) return 0;
 
+	start= stats_start();
+
 	/* Clear the last, serialized result */
 
-	if ( result != NULL ) {
-		gmp_free_func(result, NULL);
-		result= NULL;
-		len_result= 0;
-	}
+	result_clear();
+
+	if ( cached(STATS_MPZ_MUL, 0, str_a, str_b, start) ) return len_result;
 
-	mpz_inits(a, b, c, NULL);
+	scratch_open();
+	a= scratch_mpz();
+	b= scratch_mpz();
+	c= scratch_mpz();
 
 	/* Deserialize */
 
-	if ( mpz_deserialize(&a, str_a) == -1 ) return 0;
-	if ( mpz_deserialize(&b, str_b) == -1 ) return 0;
+	if ( mpz_deserialize(a, str_a) == -1 ) goto cleanup;
+	if ( mpz_deserialize(b, str_b) == -1 ) goto cleanup;
 
-	mpz_mul(c, a, b);
+	mpz_mul(*c, *a, *b);
 
 	/* Serialize the result */
 
-	result= mpz_serialize(c);
-	if ( result == NULL ) return 0;
+	if ( result_set_str(mpz_serialize(*c)) ) {
+		cache(STATS_MPZ_MUL, 0, str_a, str_b);
+		stats_record(STATS_MPZ_MUL, start, strlen(str_a)+strlen(str_b),
+			len_result);
+	}
+
+cleanup:
+	scratch_close();
 
-	len_result= strlen(result);
 	return len_result;
 }
 
 size_t e_mpz_div(char *str_a, char *str_b)
 {
-	mpz_t a, b, c;
+	mpz_t *a, *b, *c;
+	uint64_t start;
 
 	/* Marshal untrusted values into the enclave */
 
 	if ( str_a == NULL || str_b == NULL ) return 0;
 
+	start= stats_start();
+
 	/* Clear the last, serialized result */
 
-	if ( result != NULL ) {
-		gmp_free_func(result, NULL);
-		result= NULL;
-		len_result= 0;
-	}
+	result_clear();
 
-	mpz_inits(a, b, c, NULL);
+	if ( cached(STATS_MPZ_DIV, 0, str_a, str_b, start) ) return len_result;
+
+	scratch_open();
+	a= scratch_mpz();
+	b= scratch_mpz();
+	c= scratch_mpz();
 
 	/* Deserialize */
 
-	if ( mpz_deserialize(&a, str_a) == -1 ) return 0;
-	if ( mpz_deserialize(&b, str_b) == -1 ) return 0;
+	if ( mpz_deserialize(a, str_a) == -1 ) goto cleanup;
+	if ( mpz_deserialize(b, str_b) == -1 ) goto cleanup;
+
+	/* GMP raises SIGFPE on division by zero, taking the enclave down. */
+
+	if ( mpz_sgn(*b) == 0 ) goto cleanup;
 
-	mpz_div(c, a, b);
+	mpz_div(*c, *a, *b);
 
 	/* Serialize the result */
 
-	result= mpz_serialize(c);
-	if ( result == NULL ) return 0;
+	if ( result_set_str(mpz_serialize(*c)) ) {
+		cache(STATS_MPZ_DIV, 0, str_a, str_b);
+		stats_record(STATS_MPZ_DIV, start, strlen(str_a)+strlen(str_b),
+			len_result);
+	}
+
+cleanup:
+	scratch_close();
 
-	len_result= strlen(result);
 	return len_result;
 }
 
 size_t e_mpf_div(char *str_a, char *str_b, int digits)
 {
-	mpz_t a, b;
-	mpf_t fa, fb, fc;
+	mpz_t *a, *b;
+	mpf_t *fc;
+	uint64_t start;
 
 	/* Marshal untrusted values into the enclave */
 
 	if ( str_a == NULL || str_b == NULL ) return 0;
 
+	start= stats_start();
+
 	/* Clear the last, serialized result */
 
-	if ( result != NULL ) {
-		gmp_free_func(result, NULL);
-		result= NULL;
-		len_result= 0;
-	}
+	result_clear();
 
-	mpz_inits(a, b, NULL);
-	mpf_inits(fa, fb, fc, NULL);
+	if ( cached(STATS_MPF_DIV, (uint64_t) digits, str_a, str_b, start) )
+		return len_result;
 
-	/* Deserialize */
+	scratch_open();
+	a= scratch_mpz();
+	b= scratch_mpz();
 
-	if ( mpz_deserialize(&a, str_a) == -1 ) return 0;
-	if ( mpz_deserialize(&b, str_b) == -1 ) return 0;
+	/* Deserialize */
 
-	mpf_set_z(fa, a);
-	mpf_set_z(fb, b);
+	if ( mpz_deserialize(a, str_a) == -1 ) goto cleanup;
+	if ( mpz_deserialize(b, str_b) == -1 ) goto cleanup;
 
-	mpf_div(fc, fa, fb);
+	/* Only as precise as the digits asked for, and NULL for b == 0 */
 
+	fc= fdiv_digits(*a, *b, digits, FDIV_AUTO);
+	if ( fc == NULL ) goto cleanup;
 
 	/* Serialize the result */
 
-	result= mpf_serialize(fc, digits);
-	if ( result == NULL ) return 0;
+	if ( result_set_str(mpf_serialize(*fc, digits)) ) {
+		cache(STATS_MPF_DIV, (uint64_t) digits, str_a, str_b);
+		stats_record(STATS_MPF_DIV, start, strlen(str_a)+strlen(str_b),
+			len_result);
+	}
+
+cleanup:
+	scratch_close();
 
-	len_result= strlen(result);
 	return len_result;
 }
 
@@ -259,20 +420,20 @@ size_t e_mpf_div(char *str_a, char *str_b, int digits)
 
 #define DIGITS_PER_ITERATION 14.1816 /* Roughly */
 
-mpz_t c3, c4, c5;
-int pi_init= 0;
+static mpz_t c3, c4, c5;
 
 size_t e_pi (uint64_t digits)
 {
 	mpf_t pi;
+	uint64_t start;
+
+	start= stats_start();
 
 	/* Clear the last, serialized result */
 
-	if ( result != NULL ) {
-		gmp_free_func(result, NULL);
-		result= NULL;
-		len_result= 0;
-	}
+	result_clear();
+
+	if ( cached(STATS_PI, digits, "", "", start) ) return len_result;
 
 	/*
 	 * Perform our operations on a variable that's located in the enclave,
@@ -287,29 +448,79 @@ size_t e_pi (uint64_t digits)
 
 	mpf_set_prec(pi, mpf_get_prec(pi));
 
-	result= mpf_serialize(pi, digits+1);
-	if ( result == NULL ) return 0;
+	if ( result_set_str(mpf_serialize(pi, digits+1)) ) {
+		cache(STATS_PI, digits, "", "");
+		stats_record(STATS_PI, start, sizeof(digits), len_result);
+	}
+
+	mpf_clear(pi);
 
-	len_result= strlen(result);
 	return len_result;
 }
 
 void e_calc_pi (mpf_t *pi, uint64_t digits)
 {
-	uint64_t k, n;
-	mp_bitcnt_t precision;
+	struct pi_sum ps;
+
+	pi_begin(&ps, digits);
+	pi_step(&ps, ps.n);
+	pi_end(&ps, pi);
+}
+
+/*
+ * The sum is carried in a struct pi_sum so that it can be evaluated a
+ * few terms at a time (see chunk.c). Everything is initialized with an
+ * explicit precision so that no global state is touched.
+ */
+
+static volatile int pi_init= 0;
+
+static void pi_constants ()
+{
+	if ( pi_init == 2 ) return;
+
+	if ( __sync_bool_compare_and_swap(&pi_init, 0, 1) ) {
+		/* Constants needed in 'sum'. */
+
+		mpz_inits(c3, c4, c5, NULL);
+
+		mpz_set_ui(c3, 13591409);
+		mpz_set_ui(c4, 545140134);
+		mpz_set_si(c5, -640320);
+
+		__sync_synchronize();
+		pi_init= 2;
+	} else {
+		while ( pi_init != 2 ) __asm__ __volatile__ ("pause");
+	}
+}
+
+/* The number of terms of the sum needed for this many digits */
+
+uint64_t pi_terms (uint64_t digits)
+{
+	return (digits/DIGITS_PER_ITERATION)+1;
+}
+
+void pi_begin (struct pi_sum *ps, uint64_t digits)
+{
 	static double bits= log2(10);
-	mpz_t kf, kf3, threekf, sixkf, z1, z2, c4k, c5_3k;
-	mpf_t C, sum, div, f2;
 
-	n= (digits/DIGITS_PER_ITERATION)+1;
-	precision= (digits * bits)+1;
+	ps->k= 0;
+	ps->n= pi_terms(digits);
+	ps->precision= (digits * bits)+1;
 
-	mpf_set_default_prec(precision);
+	pi_constants();
 
-	/* Re-initialize the pi variable to use our new precision */
+	mpf_init2(ps->sum, ps->precision);
+	mpf_set_ui(ps->sum, 0);
+}
 
-	mpf_set_prec(*pi, precision);
+int pi_step (struct pi_sum *ps, uint64_t terms)
+{
+	uint64_t k, end;
+	mpz_t *kf, *kf3, *threekf, *sixkf, *z1, *z2, *c4k, *c5_3k;
+	mpf_t *div, *f2;
 
 	/*
 
@@ -325,57 +536,77 @@ void e_calc_pi (mpf_t *pi, uint64_t digits)
 
 	*/
 
-	mpz_inits(sixkf, z1, z2, kf, kf3, threekf, c4k, c5_3k, NULL);
-	mpf_inits(C, sum, div, f2, NULL);
+	end= ( terms < ps->n-ps->k ) ? ps->k+terms : ps->n;
 
-	/* Calculate 'C' */
+	/* These keep their limbs for the next chunk, or the next call. */
 
-	mpf_sqrt_ui(C, 10005);
-	mpf_mul_ui(C, C, 426880);
+	scratch_open();
+	sixkf= scratch_mpz();
+	z1= scratch_mpz();
+	z2= scratch_mpz();
+	kf= scratch_mpz();
+	kf3= scratch_mpz();
+	threekf= scratch_mpz();
+	c4k= scratch_mpz();
+	c5_3k= scratch_mpz();
+	div= scratch_mpf(ps->precision);
+	f2= scratch_mpf(ps->precision);
 
-	if ( ! pi_init ) {
-		/* Constants needed in 'sum'. */
+	for (k= ps->k; k< end; ++k) {
+		/* Numerator */
+		mpz_fac_ui(*sixkf, 6*k);
+		mpz_mul_ui(*c4k, c4, k);
+		mpz_add(*c4k, *c4k, c3);
+		mpz_mul(*z1, *c4k, *sixkf);
+		mpf_set_z(*div, *z1);
 
-		mpz_inits(c3, c4, c5, NULL);
+		/* Denominator */
+		mpz_fac_ui(*threekf, 3*k);
+		mpz_fac_ui(*kf, k);
+		mpz_pow_ui(*kf3, *kf, 3);
+		mpz_mul(*z2, *threekf, *kf3);
+		mpz_pow_ui(*c5_3k, c5, 3*k);
+		mpz_mul(*z2, *z2, *c5_3k);
 
-		mpz_set_ui(c3, 13591409);
-		mpz_set_ui(c4, 545140134);
-		mpz_set_si(c5, -640320);
+		/* Divison */
 
-		pi_init= 1;
+		mpf_set_z(*f2, *z2);
+		mpf_div(*div, *div, *f2);
+
+		/* Sum */
+
+		mpf_add(ps->sum, ps->sum, *div);
 	}
 
+	ps->k= end;
 
-	mpf_set_ui(sum, 0);
+	scratch_close();
 
-	for (k= 0; k< n; ++k) {
-		/* Numerator */
-		mpz_fac_ui(sixkf, 6*k);
-		mpz_mul_ui(c4k, c4, k);
-		mpz_add(c4k, c4k, c3);
-		mpz_mul(z1, c4k, sixkf);
-		mpf_set_z(div, z1);
+	return ( ps->k < ps->n );
+}
 
-		/* Denominator */
-		mpz_fac_ui(threekf, 3*k);
-		mpz_fac_ui(kf, k);
-		mpz_pow_ui(kf3, kf, 3);
-		mpz_mul(z2, threekf, kf3);
-		mpz_pow_ui(c5_3k, c5, 3*k);
-		mpz_mul(z2, z2, c5_3k);
+void pi_end (struct pi_sum *ps, mpf_t *pi)
+{
+	mpf_t *C;
 
-		/* Divison */
+	/* Re-initialize the pi variable to use our new precision */
 
-		mpf_set_z(f2, z2);
-		mpf_div(div, div, f2);
+	mpf_set_prec(*pi, ps->precision);
 
-		/* Sum */
+	/* Calculate 'C' */
 
-		mpf_add(sum, sum, div);
-	}
+	scratch_open();
+	C= scratch_mpf(ps->precision);
+	mpf_sqrt_ui(*C, 10005);
+	mpf_mul_ui(*C, *C, 426880);
 
-	mpf_div(*pi, C, sum);
+	mpf_div(*pi, *C, ps->sum);
 
-	mpf_clears(div, sum, f2, NULL);
+	scratch_close();
+	mpf_clear(ps->sum);
 }
 
+void pi_abandon (struct pi_sum *ps)
+{
+	mpf_clear(ps->sum);
+}
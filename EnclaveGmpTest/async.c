@@ -0,0 +1,226 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_trts.h>
+#include <sgx_tgmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include "enclave.h"
+#include "serialize.h"
+#include "async_ring.h"
+
+/*
+ * Workers for asynchronous requests (see async_ring.h). A host thread
+ * enters through e_async_worker() and stays, taking requests off the
+ * submission queue until it is told to stop or has found nothing to
+ * do for spin polls in a row. Then it returns, so that an idle engine
+ * does not hold a core; the host puts it to sleep until there is work
+ * and sends it back in.
+ *
+ * Nothing here touches the pending result used by e_get_result(), so
+ * the workers can run alongside the ordinary ECALLs.
+ */
+
+static int async_run (struct async_req *ureq);
+static int async_compute (struct async_req *req, uint64_t *out_len);
+static char *copy_in (const char *str, uint64_t len);
+
+int e_async_worker (void *ring, uint64_t spin)
+{
+	struct async_ring *r= (struct async_ring *) ring;
+	uint64_t idle= 0;
+	int n= 0;
+
+	if ( ! sgx_is_outside_enclave(r, sizeof(struct async_ring)) ) return -1;
+
+	while ( ! r->stop ) {
+		struct async_req *ureq= async_dequeue(&r->sq);
+
+		if ( ureq == NULL ) {
+			if ( ++idle >= spin ) break;
+			__asm__ __volatile__ ("pause");
+			continue;
+		}
+		idle= 0;
+
+		/* A request we can't write back to is dropped. */
+
+		if ( ! async_run(ureq) ) continue;
+
+		while ( ! async_enqueue(&r->cq, ureq) ) {
+			if ( r->stop ) return n;
+			__asm__ __volatile__ ("pause");
+		}
+		++n;
+	}
+
+	return n;
+}
+
+static int async_run (struct async_req *ureq)
+{
+	struct async_req req;
+	uint64_t out_len= 0;
+	int32_t status;
+
+	if ( ! sgx_is_outside_enclave(ureq, sizeof(struct async_req)) )
+		return 0;
+
+	/* Read the request once, so the host can't change it under us. */
+
+	memcpy(&req, ureq, sizeof(struct async_req));
+
+	status= async_compute(&req, &out_len);
+
+	ureq->out_len= out_len;
+	__atomic_store_n(&ureq->status, status, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+static int async_compute (struct async_req *req, uint64_t *out_len)
+{
+	char *str_a= NULL, *str_b= NULL, *out= NULL;
+	mpz_t *a, *b, *c;
+	mpf_t *fc, pi;
+	int status= ASYNC_EINVAL;
+	size_t len;
+
+	switch (req->op) {
+	case ASYNC_NOP:
+		return ASYNC_DONE;
+
+	case ASYNC_PI:
+		if ( req->param == 0 ) return ASYNC_EINVAL;
+
+		mpf_init(pi);
+		e_calc_pi(&pi, req->param+1);
+
+		out= mpf_serialize(pi, req->param+1);
+		mpf_clear(pi);
+		break;
+
+	case ASYNC_MPZ_ADD:
+	case ASYNC_MPZ_MUL:
+	case ASYNC_MPZ_DIV:
+	case ASYNC_MPF_DIV:
+		if ( req->op == ASYNC_MPF_DIV &&
+			( req->param == 0 || req->param > INT32_MAX ) )
+		{
+			return ASYNC_EINVAL;
+		}
+
+		str_a= copy_in(req->a, req->len_a);
+		str_b= copy_in(req->b, req->len_b);
+		if ( str_a == NULL || str_b == NULL ) goto cleanup;
+
+		scratch_open();
+		a= scratch_mpz();
+		b= scratch_mpz();
+		c= scratch_mpz();
+
+		if ( mpz_deserialize(a, str_a) == -1 ||
+			mpz_deserialize(b, str_b) == -1 )
+		{
+			scratch_close();
+			goto cleanup;
+		}
+
+		if ( req->op == ASYNC_MPZ_ADD ) {
+			mpz_add(*c, *a, *b);
+			out= mpz_serialize(*c);
+		} else if ( req->op == ASYNC_MPZ_MUL ) {
+			mpz_mul(*c, *a, *b);
+			out= mpz_serialize(*c);
+		} else if ( mpz_sgn(*b) == 0 ) {
+			scratch_close();
+			goto cleanup;
+		} else if ( req->op == ASYNC_MPZ_DIV ) {
+			mpz_div(*c, *a, *b);
+			out= mpz_serialize(*c);
+		} else {
+			fc= fdiv_digits(*a, *b, (int) req->param, FDIV_AUTO);
+			out= mpf_serialize(*fc, (int) req->param);
+		}
+
+		scratch_close();
+		break;
+
+	default:
+		return ASYNC_EINVAL;
+	}
+
+	/* Marshal the result out, if the host left room for it. */
+
+	if ( out == NULL ) {
+		status= ASYNC_EFAIL;
+		goto cleanup;
+	}
+
+	len= strlen(out);
+	*out_len= len;
+
+	if ( len > req->out_size ) {
+		status= ASYNC_ESPACE;
+	} else if ( ! sgx_is_outside_enclave(req->out, len) ) {
+		status= ASYNC_EINVAL;
+	} else {
+		memcpy(req->out, out, len);
+		status= ASYNC_DONE;
+	}
+
+	gmp_free_func(out, len+1);
+
+cleanup:
+	free(str_a);
+	free(str_b);
+
+	return status;
+}
+
+/* Copy an operand into the enclave and terminate it. */
+
+static char *copy_in (const char *str, uint64_t len)
+{
+	char *s;
+
+	if ( str == NULL || len == 0 || len >= SIZE_MAX ) return NULL;
+	if ( ! sgx_is_outside_enclave(str, len) ) return NULL;
+
+	s= malloc(len+1);
+	if ( s == NULL ) return NULL;
+
+	memcpy(s, str, len);
+	s[len]= '\0';
+
+	return s;
+}
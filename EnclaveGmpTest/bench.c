@@ -0,0 +1,158 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include <string.h>
+#include "enclave.h"
+#include "bench_ops.h"
+#include "serialize.h"
+
+/*
+ * Instrumented versions of the arithmetic ECALLs for sgxgmpbench. The
+ * enclave has no clock of its own, so phases are timed with an OCALL
+ * to the host. The cost of the OCALL itself is reported separately so
+ * the host can subtract it from each phase:
+ *
+ *   ns[0]  deserializing the operands
+ *   ns[1]  the computation
+ *   ns[2]  serializing the result
+ *   ns[3]  an empty interval between two clock reads
+ *
+ * The operations are the BENCH_ codes in bench_ops.h.
+ */
+
+static uint64_t clock_ns ();
+
+static uint64_t clock_ns ()
+{
+	uint64_t ns= 0;
+
+	if ( ocall_clock_ns(&ns) != SGX_SUCCESS ) return 0;
+
+	return ns;
+}
+
+void e_nop ()
+{
+}
+
+size_t e_bench_op (int op, char *str_a, char *str_b, int digits,
+	uint64_t *ns)
+{
+	mpz_t a, b, c;
+	mpf_t fc, *q= NULL;
+	uint64_t t0, t1, t2, t3;
+	char *out= NULL;
+
+	if ( ns == NULL ) return 0;
+
+	result_clear();
+
+	if ( op == BENCH_PI ) {
+		if ( digits <= 0 ) return 0;
+
+		t0= clock_ns();
+		t1= clock_ns();
+
+		mpf_init(fc);
+		e_calc_pi(&fc, (uint64_t) digits+1);
+
+		t2= clock_ns();
+		out= mpf_serialize(fc, digits+1);
+		t3= clock_ns();
+
+		mpf_clear(fc);
+	} else {
+		if ( str_a == NULL || str_b == NULL ) return 0;
+		if ( op < BENCH_ADD || op > BENCH_FDIV_FIXED || op == BENCH_PI )
+			return 0;
+
+		mpz_inits(a, b, c, NULL);
+		scratch_open();
+
+		t0= clock_ns();
+		if ( mpz_deserialize(&a, str_a) == -1 ||
+			mpz_deserialize(&b, str_b) == -1 ||
+			( op == BENCH_DIV && mpz_sgn(b) == 0 ) ) {
+
+			scratch_close();
+			mpz_clears(a, b, c, NULL);
+			return 0;
+		}
+		t1= clock_ns();
+
+		switch (op) {
+		case BENCH_ADD:
+			mpz_add(c, a, b);
+			break;
+		case BENCH_MUL:
+			mpz_mul(c, a, b);
+			break;
+		case BENCH_DIV:
+			mpz_div(c, a, b);
+			break;
+		case BENCH_FDIV:
+			q= fdiv_digits(a, b, digits, FDIV_AUTO);
+			break;
+		case BENCH_FDIV_FLOAT:
+			q= fdiv_digits(a, b, digits, FDIV_FLOAT);
+			break;
+		case BENCH_FDIV_FIXED:
+			q= fdiv_digits(a, b, digits, FDIV_FIXED);
+			break;
+		}
+
+		t2= clock_ns();
+		if ( op >= BENCH_FDIV ) {
+			if ( q != NULL ) out= mpf_serialize(*q, digits);
+			t3= clock_ns();
+		} else {
+			out= mpz_serialize(c);
+			t3= clock_ns();
+		}
+
+		scratch_close();
+		mpz_clears(a, b, c, NULL);
+	}
+
+	ns[0]= t1-t0;
+	ns[1]= t2-t1;
+	ns[2]= t3-t2;
+
+	t0= clock_ns();
+	t1= clock_ns();
+	ns[3]= t1-t0;
+
+	if ( out == NULL ) return 0;
+
+	return result_set_str(out);
+}
@@ -0,0 +1,99 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include "serialize.h"
+#include "enclave.h"
+
+/*
+ * Pi in chunks. e_pi_begin() starts the sum, each e_pi_step() adds up
+ * to the given number of terms, and e_pi_end() turns the sum into pi and
+ * leaves it as the pending result. Between the calls the enclave is
+ * free for other requests, which is how a scheduler can run short work
+ * in the middle of a long computation.
+ *
+ * One chunked computation runs per enclave; e_pi_begin() returns 0 if
+ * one is already underway. The calls must not overlap each other.
+ */
+
+static struct pi_sum chunk;
+static uint64_t chunk_digits= 0;
+static int chunk_busy= 0;
+
+int e_pi_begin (uint64_t digits)
+{
+	if ( chunk_busy || digits == 0 ) return 0;
+
+	pi_begin(&chunk, digits+1);
+	chunk_digits= digits;
+	chunk_busy= 1;
+
+	return 1;
+}
+
+int e_pi_step (uint64_t terms)
+{
+	if ( ! chunk_busy ) return -1;
+
+	return pi_step(&chunk, terms);
+}
+
+/*
+ * Returns the length of the result, or 0 if there is no computation or
+ * the sum is unfinished. Either way the computation is over: calling
+ * this early is how to abandon one.
+ */
+
+size_t e_pi_end ()
+{
+	mpf_t pi;
+	size_t len;
+
+	result_clear();
+
+	if ( ! chunk_busy ) return 0;
+	chunk_busy= 0;
+
+	if ( chunk.k < chunk.n ) {
+		pi_abandon(&chunk);
+		return 0;
+	}
+
+	mpf_init2(pi, chunk.precision);
+	pi_end(&chunk, &pi);
+
+	len= result_set_str(mpf_serialize(pi, chunk_digits+1));
+
+	mpf_clear(pi);
+
+	return len;
+}
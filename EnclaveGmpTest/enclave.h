@@ -0,0 +1,193 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __ENCLAVE__H
+#define __ENCLAVE__H
+
+#include <sgx_tgmp.h>
+#include "ecall_stats.h"
+
+/* The original GMP allocators, saved by tgmp_init() */
+
+extern void *(*gmp_alloc_func)(size_t);
+extern void *(*gmp_realloc_func)(void *, size_t, size_t);
+extern void (*gmp_free_func)(void *, size_t);
+
+/*
+ * The hooks that replace them, which keep the heap accounting. In the
+ * native build the host shares them, and they only count calls made
+ * from the enclave code, for which in_enclave() is true.
+ */
+
+#ifndef in_enclave
+#define in_enclave()	1
+#endif
+
+
+void *allocate_function (size_t sz);
+void *reallocate_function (void *ptr, size_t osize, size_t nsize);
+void free_function (void *ptr, size_t sz);
+
+/*
+ * The pending result that the application fetches with e_get_result().
+ * The buffer must have come from the GMP allocator.
+ */
+
+void result_clear ();
+size_t result_set (char *buf, size_t len);
+size_t result_set_str (char *str);
+const char *result_get (size_t *len, size_t *size);
+
+/* Heap accounting, called from the GMP memory hooks (heap.c) */
+
+void heap_note_alloc (size_t sz, int ok);
+void heap_note_realloc (size_t osize, size_t nsize, int ok);
+void heap_note_free (size_t sz);
+void heap_note_kept (int64_t bytes, int64_t blocks);
+
+void e_calc_pi (mpf_t *pi, uint64_t digits);
+
+/*
+ * The Chudnovsky sum behind e_calc_pi(), split so that it can be
+ * evaluated a few terms at a time. pi_step() returns nonzero while terms
+ * remain. pi_end() stores the result in pi and frees the sum;
+ * pi_abandon() just frees it. None of these change the default precision.
+ */
+
+struct pi_sum {
+	uint64_t k, n;
+	mp_bitcnt_t precision;
+	mpf_t sum;
+};
+
+uint64_t pi_terms (uint64_t digits);
+void pi_begin (struct pi_sum *ps, uint64_t digits);
+int pi_step (struct pi_sum *ps, uint64_t terms);
+void pi_end (struct pi_sum *ps, mpf_t *pi);
+void pi_abandon (struct pi_sum *ps);
+
+/*
+ * Parallel jobs. An ECALL posts a job and returns; the application
+ * then enters the enclave from several threads through e_worker(),
+ * each of which calls the work function with its own thread id.
+ * e_job_finish() calls the finish function to produce the result.
+ * Reserve the slot with job_reserve() before touching the job's
+ * arguments, then job_publish() it, or job_cancel() on failure.
+ *
+ * JOB_MAX_THREADS must not exceed TCSNum in the enclave config.
+ */
+
+#define JOB_MAX_THREADS 8
+
+typedef void (*job_work_t)(void *arg, int tid);
+typedef size_t (*job_finish_t)(void *arg);
+
+int job_reserve ();
+void job_publish (job_work_t work, job_finish_t finish, void *arg);
+void job_cancel ();
+
+/*
+ * Per-ECALL counters. Take a timestamp with stats_start() on entry and
+ * record the call with stats_record() once it has succeeded. Both are
+ * nearly free while the counters are off.
+ */
+
+uint64_t stats_start ();
+void stats_record (int ecall, uint64_t start, size_t bytes_in,
+	size_t bytes_out);
+
+/*
+ * Scratch temporaries (scratch.c), which keep their limbs from one
+ * ECALL to the next. Bracket their use with scratch_open() and
+ * scratch_close(); everything taken in between is handed back at the
+ * close. Never clear them, and don't keep them past the close.
+ */
+
+#define SCRATCH_MPZ	16
+#define SCRATCH_MPF	8
+
+void scratch_open ();
+void scratch_close ();
+mpz_t *scratch_mpz ();
+mpf_t *scratch_mpf (mp_bitcnt_t precision);
+mpz_t *scratch_mpz_vec (size_t n);
+int scratch_trim ();
+
+/*
+ * Division to a number of decimal digits (fdiv.c). The result is a
+ * scratch float, so call it between scratch_open() and scratch_close().
+ */
+
+#define FDIV_AUTO	0
+#define FDIV_FLOAT	1
+#define FDIV_FIXED	2
+
+mpf_t *fdiv_digits (mpz_t a, mpz_t b, int digits, int method);
+
+/*
+ * The result cache (memo.c), keyed by the ECALL's STATS_ code, a
+ * parameter and the operand bytes. memo_get() makes a cached result
+ * the pending one and returns its length, or 0 on a miss; memo_put()
+ * caches the pending result. Both do nothing while the cache is off.
+ */
+
+size_t memo_get (int op, uint64_t param, const void *a, size_t len_a,
+	const void *b, size_t len_b);
+void memo_put (int op, uint64_t param, const void *a, size_t len_a,
+	const void *b, size_t len_b);
+int memo_trim ();
+
+/*
+ * Spilling integers that won't be needed for a while to untrusted
+ * memory, encrypted (spill.c). spill_out() spills x if spilling is on
+ * and x is big enough, and spill_in() brings it back, returning 0 if
+ * it can't. Always pair them: spill_in() does nothing for a value that
+ * wasn't spilled.
+ */
+
+#define SPILL_MAC_SIZE	16
+
+struct spill {
+	uint64_t handle;	/* The host's, or 0 if x wasn't spilled */
+	uint64_t seq;		/* Makes the IV */
+	size_t size;		/* In limbs */
+	int negative;
+	uint8_t mac[SPILL_MAC_SIZE];
+};
+
+int spill_out (mpz_t x, struct spill *s);
+int spill_in (mpz_t x, struct spill *s);
+
+/* A random state seeded from sgx_read_rand(), one per job thread. */
+
+gmp_randstate_t *enclave_randstate (int tid);
+
+#endif
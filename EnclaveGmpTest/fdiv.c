@@ -0,0 +1,115 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include <math.h>
+#include "enclave.h"
+
+/*
+ * Floating point division to the precision the caller asked for. The
+ * quotient is only ever serialized to the requested digits, so it is
+ * computed to that many digits' worth of bits plus FDIV_GUARD_BITS,
+ * rather than at GMP's default precision, which is too little for
+ * long results and more than short ones need.
+ *
+ * There are two ways to get there:
+ *
+ *   FDIV_FLOAT  Convert both operands to floats at that precision and
+ *               divide. Operands longer than the precision are
+ *               truncated first, so the cost depends only on digits.
+ *
+ *   FDIV_FIXED  Shift a left until the integer quotient has enough
+ *               bits, divide exactly with mpz_tdiv_q(), and shift the
+ *               result back. No float conversions, and a short divisor
+ *               gets GMP's single-limb division, but the whole divisor
+ *               takes part.
+ *
+ * FDIV_AUTO takes the fixed path while the shifted dividend (the
+ * precision plus the length of the divisor) is no longer than
+ * FDIV_FIXED_MAX_BITS, and the float path after that. The limit is
+ * from sgxgmpbench's compute times for fdiv_float and fdiv_fixed, with
+ * the native backend, at 64 to 1024 bits and 10 to 300 digits (-d).
+ * Up to 1024 shifted bits the fixed path took 0.74 to 1.25 times as
+ * long as the float path; with 1024-bit divisors it took 1.5 to 2
+ * times as long, at every digit count. Rerun those before moving it.
+ */
+
+#define FDIV_GUARD_BITS		32
+#define FDIV_FIXED_MAX_BITS	1024
+
+/*
+ * The quotient a/b to digits decimal digits, as a scratch float, or
+ * NULL if b is zero or digits is less than one. Call inside
+ * scratch_open().
+ */
+
+mpf_t *fdiv_digits (mpz_t a, mpz_t b, int digits, int method)
+{
+	static double bits= log2(10);
+	mp_bitcnt_t prec;
+	mpf_t *q;
+	long shift;
+
+	if ( mpz_sgn(b) == 0 || digits < 1 ) return NULL;
+
+	prec= (mp_bitcnt_t) (digits*bits)+1+FDIV_GUARD_BITS;
+
+	/* Enough that the integer quotient has prec bits or more */
+
+	shift= (long) prec+(long) mpz_sizeinbase(b, 2)-
+		(long) mpz_sizeinbase(a, 2);
+	if ( shift < 0 ) shift= 0;
+
+	if ( method == FDIV_AUTO ) {
+		method= ( mpz_sizeinbase(a, 2)+shift <= FDIV_FIXED_MAX_BITS ) ?
+			FDIV_FIXED : FDIV_FLOAT;
+	}
+
+	q= scratch_mpf(prec);
+
+	if ( method == FDIV_FIXED ) {
+		mpz_t *t= scratch_mpz();
+
+		mpz_mul_2exp(*t, a, (mp_bitcnt_t) shift);
+		mpz_tdiv_q(*t, *t, b);
+		mpf_set_z(*q, *t);
+		mpf_div_2exp(*q, *q, (mp_bitcnt_t) shift);
+	} else {
+		mpf_t *fa= scratch_mpf(prec), *fb= scratch_mpf(prec);
+
+		mpf_set_z(*fa, a);
+		mpf_set_z(*fb, b);
+		mpf_div(*q, *fa, *fb);
+	}
+
+	return q;
+}
@@ -0,0 +1,155 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include <string.h>
+#include "enclave.h"
+
+/*
+ * Fixed-width arithmetic for crypto-sized operands. Operands are
+ * unsigned, exactly bits/8 bytes long, and little-endian, which on
+ * x86 is also the layout of a GMP limb array. The results are written
+ * straight to the caller's buffer instead of going through
+ * e_get_result(), and there is no string conversion or heap use: the
+ * operands are copied to limb arrays on the stack and handed to the
+ * mpn layer.
+ *
+ * Each supported width gets its own copy of the kernel with the limb
+ * count as a compile time constant.
+ */
+
+#define FIXED_MAX_BITS	2048
+#define FIXED_LIMBS(b)	((b)/GMP_NUMB_BITS)
+#define FIXED_MAX_LIMBS	FIXED_LIMBS(FIXED_MAX_BITS)
+
+#define FIXED_ADD 0
+#define FIXED_SUB 1
+#define FIXED_MUL 2
+
+static inline __attribute__((always_inline)) int fixed_op (int op,
+	const mp_size_t n, const unsigned char *a, const unsigned char *b,
+	unsigned char *c)
+{
+	mp_limb_t la[FIXED_MAX_LIMBS], lb[FIXED_MAX_LIMBS];
+	mp_limb_t lc[2*FIXED_MAX_LIMBS];
+	int carry= 0;
+
+	memcpy(la, a, n*sizeof(mp_limb_t));
+	memcpy(lb, b, n*sizeof(mp_limb_t));
+
+	switch (op) {
+	case FIXED_ADD:
+		carry= (int) mpn_add_n(lc, la, lb, n);
+		memcpy(c, lc, n*sizeof(mp_limb_t));
+		break;
+	case FIXED_SUB:
+		carry= (int) mpn_sub_n(lc, la, lb, n);
+		memcpy(c, lc, n*sizeof(mp_limb_t));
+		break;
+	case FIXED_MUL:
+		mpn_mul_n(lc, la, lb, n);
+		memcpy(c, lc, 2*n*sizeof(mp_limb_t));
+		break;
+	}
+
+	return carry;
+}
+
+/* Returns the carry (or borrow), or -1 for an unsupported width. */
+
+static int fixed_dispatch (int op, uint32_t bits, const unsigned char *a,
+	const unsigned char *b, unsigned char *c)
+{
+	switch (bits) {
+	case 256:
+		return fixed_op(op, FIXED_LIMBS(256), a, b, c);
+	case 512:
+		return fixed_op(op, FIXED_LIMBS(512), a, b, c);
+	case 1024:
+		return fixed_op(op, FIXED_LIMBS(1024), a, b, c);
+	case 2048:
+		return fixed_op(op, FIXED_LIMBS(2048), a, b, c);
+	}
+
+	return -1;
+}
+
+int e_fixed_add (uint32_t bits, const unsigned char *a,
+	const unsigned char *b, unsigned char *c, size_t len)
+{
+	uint64_t start;
+	int rv;
+
+	if ( a == NULL || b == NULL || c == NULL ) return -1;
+	if ( len != bits/8 ) return -1;
+
+	start= stats_start();
+
+	rv= fixed_dispatch(FIXED_ADD, bits, a, b, c);
+	if ( rv != -1 ) stats_record(STATS_FIXED_ADD, start, 2*len, len);
+
+	return rv;
+}
+
+int e_fixed_sub (uint32_t bits, const unsigned char *a,
+	const unsigned char *b, unsigned char *c, size_t len)
+{
+	uint64_t start;
+	int rv;
+
+	if ( a == NULL || b == NULL || c == NULL ) return -1;
+	if ( len != bits/8 ) return -1;
+
+	start= stats_start();
+
+	rv= fixed_dispatch(FIXED_SUB, bits, a, b, c);
+	if ( rv != -1 ) stats_record(STATS_FIXED_SUB, start, 2*len, len);
+
+	return rv;
+}
+
+int e_fixed_mul (uint32_t bits, const unsigned char *a,
+	const unsigned char *b, size_t len, unsigned char *c, size_t clen)
+{
+	uint64_t start;
+	int rv;
+
+	if ( a == NULL || b == NULL || c == NULL ) return -1;
+	if ( len != bits/8 || clen != 2*len ) return -1;
+
+	start= stats_start();
+
+	rv= fixed_dispatch(FIXED_MUL, bits, a, b, c);
+	if ( rv != -1 ) stats_record(STATS_FIXED_MUL, start, 2*len, clen);
+
+	return rv;
+}
@@ -0,0 +1,141 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <string.h>
+#include "enclave.h"
+#include "ecall_stats.h"
+
+/*
+ * Heap accounting for the GMP memory hooks in EnclaveGmpTest.c. The
+ * sizes are the ones GMP passes to the hooks, which are exact for
+ * GMP's own objects; our code has to pass the real size when it frees
+ * a string or batch itself. Any thread may allocate, so everything is
+ * updated atomically.
+ */
+
+static struct heap_stats heap;
+
+static inline int heap_class (size_t sz);
+static void heap_grow (size_t sz);
+
+void heap_note_alloc (size_t sz, int ok)
+{
+	if ( ! ok ) {
+		__sync_fetch_and_add(&heap.failures, 1);
+		return;
+	}
+
+	__sync_fetch_and_add(&heap.allocs, 1);
+	__sync_fetch_and_add(&heap.live_blocks, 1);
+	__sync_fetch_and_add(&heap.size_class[heap_class(sz)], 1);
+	heap_grow(sz);
+}
+
+void heap_note_realloc (size_t osize, size_t nsize, int ok)
+{
+	if ( ! ok ) {
+		__sync_fetch_and_add(&heap.failures, 1);
+		return;
+	}
+
+	__sync_fetch_and_add(&heap.reallocs, 1);
+	__sync_fetch_and_add(&heap.size_class[heap_class(nsize)], 1);
+
+	if ( nsize >= osize ) heap_grow(nsize-osize);
+	else __sync_fetch_and_sub(&heap.live_bytes, osize-nsize);
+}
+
+void heap_note_free (size_t sz)
+{
+	__sync_fetch_and_add(&heap.frees, 1);
+	__sync_fetch_and_sub(&heap.live_blocks, 1);
+	__sync_fetch_and_sub(&heap.live_bytes, sz);
+}
+
+/*
+ * A change in what the scratch pools or the result cache keep, which
+ * is already counted as live
+ */
+
+void heap_note_kept (int64_t bytes, int64_t blocks)
+{
+	__sync_fetch_and_add(&heap.kept_bytes, (uint64_t) bytes);
+	__sync_fetch_and_add(&heap.kept_blocks, (uint64_t) blocks);
+}
+
+/*
+ * Copy out a snapshot and return its size. Nothing is copied if buf is
+ * too small. The counters are read one at a time, so a snapshot taken
+ * while other threads are allocating can be slightly inconsistent.
+ */
+
+size_t e_heap_stats (unsigned char *buf, size_t len, int reset)
+{
+	struct heap_stats *out;
+	int i;
+
+	if ( buf == NULL || len < sizeof(heap) ) return sizeof(heap);
+
+	out= (struct heap_stats *) buf;
+	memcpy(out, &heap, sizeof(heap));
+
+	if ( reset ) {
+		__sync_lock_test_and_set(&heap.allocs, 0);
+		__sync_lock_test_and_set(&heap.reallocs, 0);
+		__sync_lock_test_and_set(&heap.frees, 0);
+		__sync_lock_test_and_set(&heap.failures, 0);
+		for (i= 0; i< HEAP_SIZE_CLASSES; ++i)
+			__sync_lock_test_and_set(&heap.size_class[i], 0);
+		__sync_lock_test_and_set(&heap.peak_bytes, heap.live_bytes);
+	}
+
+	return sizeof(heap);
+}
+
+static void heap_grow (size_t sz)
+{
+	uint64_t live, peak;
+
+	live= __sync_add_and_fetch(&heap.live_bytes, sz);
+
+	do {
+		peak= __atomic_load_n(&heap.peak_bytes, __ATOMIC_RELAXED);
+		if ( live <= peak ) return;
+	} while ( ! __sync_bool_compare_and_swap(&heap.peak_bytes, peak, live) );
+}
+
+static inline int heap_class (size_t sz)
+{
+	int c= ( sz ) ? 64-__builtin_clzll((unsigned long long) sz) : 0;
+
+	return ( c < HEAP_SIZE_CLASSES ) ? c : HEAP_SIZE_CLASSES-1;
+}
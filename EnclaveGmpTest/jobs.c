@@ -0,0 +1,138 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_trts.h>
+#include "enclave.h"
+
+/*
+ * Enclaves can't create threads, so parallel work is done by host
+ * threads that enter through e_worker(). Only one job can be
+ * outstanding at a time. The work function is responsible for
+ * dividing the job among the threads that show up, usually by
+ * claiming items with an atomic counter, so it doesn't matter how
+ * many threads actually arrive (or whether any do at all).
+ */
+
+#define JOB_IDLE	0
+#define JOB_POSTING	1
+#define JOB_READY	2
+#define JOB_FINISHING	3
+
+static struct {
+	job_work_t work;
+	job_finish_t finish;
+	void *arg;
+	volatile int state;
+	volatile int nworkers;
+	volatile int active;
+} job= { NULL, NULL, NULL, JOB_IDLE, 0, 0 };
+
+/*
+ * Posting takes two steps. job_reserve() claims the job slot, and only
+ * then may the caller fill in the job's arguments, since until the slot
+ * is claimed they may belong to a job that is still running. It then
+ * either posts the job with job_publish() or gives the slot back with
+ * job_cancel().
+ */
+
+int job_reserve ()
+{
+	return __sync_bool_compare_and_swap(&job.state, JOB_IDLE, JOB_POSTING);
+}
+
+void job_publish (job_work_t work, job_finish_t finish, void *arg)
+{
+	job.work= work;
+	job.finish= finish;
+	job.arg= arg;
+	job.nworkers= 0;
+	job.active= 0;
+
+	__sync_synchronize();
+	job.state= JOB_READY;
+}
+
+void job_cancel ()
+{
+	__sync_synchronize();
+	job.state= JOB_IDLE;
+}
+
+int e_worker ()
+{
+	int tid;
+
+	if ( job.state != JOB_READY ) return 0;
+
+	__sync_fetch_and_add(&job.active, 1);
+
+	/* We may have raced with e_job_finish() */
+
+	if ( job.state != JOB_READY ) {
+		__sync_fetch_and_sub(&job.active, 1);
+		return 0;
+	}
+
+	tid= __sync_fetch_and_add(&job.nworkers, 1);
+	if ( tid < JOB_MAX_THREADS ) job.work(job.arg, tid);
+
+	__sync_fetch_and_sub(&job.active, 1);
+
+	return 1;
+}
+
+size_t e_job_finish ()
+{
+	uint64_t start;
+	size_t len;
+
+	if ( ! __sync_bool_compare_and_swap(&job.state, JOB_READY, JOB_FINISHING) )
+		return 0;
+
+	start= stats_start();
+
+	/* The application should have joined its workers already. */
+
+	while ( job.active ) __asm__ __volatile__ ("pause");
+
+	/* Nobody came, so do the work on this thread. */
+
+	if ( job.nworkers == 0 ) job.work(job.arg, 0);
+
+	len= job.finish(job.arg);
+
+	job.state= JOB_IDLE;
+
+	if ( len ) stats_record(STATS_JOB_FINISH, start, 0, len);
+
+	return len;
+}
@@ -0,0 +1,507 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "enclave.h"
+#include "serialize.h"
+
+/*
+ * Terms of linear recurrences, far along, in one call.
+ *
+ * e_lucas() gives the Lucas sequences U_n(P, Q) and V_n(P, Q), which
+ * include the Fibonacci (U with P=1, Q=-1) and Lucas (V) numbers, by
+ * fast doubling. It keeps U_k and U_k+1 and takes k to 2k or 2k+1 with
+ *
+ *   U_2k   = U_k (2 U_k+1 - P U_k)
+ *   U_2k+1 = U_k+1^2 - Q U_k^2
+ *   U_2k+2 = P U_2k+1 - Q U_2k
+ *
+ * and then V_n = 2 U_n+1 - P U_n. Unlike the doubling formulas that use
+ * V, these never divide by 2, so any modulus works.
+ *
+ * e_linrec_job() handles any order d, x_n+d = c_0 x_n + ... +
+ * c_d-1 x_n+d-1, by raising the companion matrix M to the nth power
+ * by squaring, left to right. The squarings are the expensive part,
+ * and they run on the job threads, one entry of the product at a time;
+ * multiplying by M only moves columns over and adds multiples of the
+ * last one, so it's done serially between squarings. With a modulus,
+ * every entry is reduced as it is made.
+ *
+ * Without a modulus the terms grow linearly in n, so both refuse an n
+ * whose working set, estimated from how fast the sequence can grow,
+ * would be over LINREC_MAX_BITS, rather than run the heap out partway.
+ * The default is 8 MiB, half the default enclave heap; raise it along
+ * with HeapMaxSize.
+ */
+
+#define LINREC_MAX_ORDER	16
+
+#ifndef LINREC_MAX_BITS
+#define LINREC_MAX_BITS		(1UL<<26)
+#endif
+
+struct linrec_job {
+	size_t d;
+	uint64_t n;
+	int bit;		/* Of n, for the squaring now running */
+	mpz_t m;		/* 0 for none */
+	mpz_t *c, *x;		/* Coefficients and x_0..x_d-1 */
+	mpz_t *s, *t;		/* The power so far, and its square */
+	mpz_t *col;		/* For multiplying by M */
+
+	/*
+	 * The high half of ctr is the squaring and the low half the
+	 * next entry to claim. Whoever finishes the last entry moves
+	 * the job on to the next squaring, or ends it.
+	 */
+
+	volatile uint64_t ctr;
+	volatile size_t done;
+	volatile int over;
+};
+
+static struct linrec_job lj;
+
+static void lucas (mpz_t u, mpz_t v, uint64_t n, mpz_t p, mpz_t q, mpz_t m);
+static int lucas_fits (uint64_t n, mpz_t p, mpz_t q);
+static int linrec_fits (uint64_t n, size_t d, mpz_t *c, mpz_t *x);
+static double log2_mpz (mpz_t x);
+static void reduce (mpz_t x, mpz_t m);
+static void linrec_work (void *arg, int tid);
+static size_t linrec_finish (void *arg);
+static void linrec_next (struct linrec_job *job);
+static void mul_companion (struct linrec_job *job);
+static void linrec_free (struct linrec_job *job);
+
+/*
+ * The input is a batch of P, Q and m, with m 0 for no modulus, and the
+ * result a batch of U_n and V_n.
+ */
+
+size_t e_lucas (unsigned char *buf, size_t len, uint64_t n)
+{
+	mpz_t vals[3], uv[2];
+	unsigned char *out;
+	size_t i, olen= 0;
+	uint64_t start;
+
+	start= stats_start();
+
+	result_clear();
+
+	if ( buf == NULL ) return 0;
+
+	olen= memo_get(STATS_LUCAS, n, buf, len, "", 0);
+	if ( olen ) {
+		stats_record(STATS_LUCAS, start, len, olen);
+		return olen;
+	}
+
+	for (i= 0; i< 3; ++i) mpz_init(vals[i]);
+
+	if ( mpz_batch_deserialize(vals, 3, buf, len) == -1 ||
+		mpz_sgn(vals[2]) < 0 ) goto cleanup;
+	if ( mpz_sgn(vals[2]) == 0 && ! lucas_fits(n, vals[0], vals[1]) )
+		goto cleanup;
+
+	mpz_inits(uv[0], uv[1], NULL);
+
+	lucas(uv[0], uv[1], n, vals[0], vals[1], vals[2]);
+
+	out= mpz_batch_serialize(uv, 2, &olen);
+	if ( out == NULL ) olen= 0;
+	else result_set((char *) out, olen);
+	if ( olen ) memo_put(STATS_LUCAS, n, buf, len, "", 0);
+
+	mpz_clears(uv[0], uv[1], NULL);
+
+cleanup:
+	for (i= 0; i< 3; ++i) mpz_clear(vals[i]);
+
+	if ( olen ) stats_record(STATS_LUCAS, start, len, olen);
+
+	return olen;
+}
+
+static void lucas (mpz_t u, mpz_t v, uint64_t n, mpz_t p, mpz_t q, mpz_t m)
+{
+	mpz_t *u0, *u1, *a, *b;
+	int bit;
+
+	/* GMP has its own, faster, doubling for plain Fibonacci numbers */
+
+	if ( mpz_sgn(m) == 0 && mpz_cmp_ui(p, 1) == 0 &&
+		mpz_cmp_si(q, -1) == 0 && n <= ULONG_MAX )
+	{
+		if ( n == 0 ) {
+			mpz_set_ui(u, 0);
+			mpz_set_ui(v, 2);
+			return;
+		}
+
+		/* L_n = F_n + 2 F_n-1 */
+
+		mpz_fib2_ui(u, v, (unsigned long) n);
+		mpz_mul_2exp(v, v, 1);
+		mpz_add(v, v, u);
+		return;
+	}
+
+	scratch_open();
+
+	u0= scratch_mpz();
+	u1= scratch_mpz();
+	a= scratch_mpz();
+	b= scratch_mpz();
+
+	mpz_set_ui(*u0, 0);
+	mpz_set_ui(*u1, 1);
+	reduce(*u1, m);
+
+	for (bit= 63; bit >= 0 && ! (n>>bit & 1); --bit);
+
+	for (; bit >= 0; --bit) {
+		/* a= U_2k */
+
+		mpz_mul_2exp(*a, *u1, 1);
+		mpz_submul(*a, p, *u0);
+		reduce(*a, m);
+		mpz_mul(*a, *a, *u0);
+		reduce(*a, m);
+
+		/* b= U_2k+1 */
+
+		mpz_mul(*u0, *u0, *u0);
+		mpz_mul(*b, *u1, *u1);
+		mpz_submul(*b, q, *u0);
+		reduce(*b, m);
+
+		if ( n>>bit & 1 ) {
+			mpz_swap(*u0, *b);
+			mpz_mul(*u1, p, *u0);
+			mpz_submul(*u1, q, *a);
+			reduce(*u1, m);
+		} else {
+			mpz_swap(*u0, *a);
+			mpz_swap(*u1, *b);
+		}
+	}
+
+	mpz_set(u, *u0);
+	mpz_mul_2exp(v, *u1, 1);
+	mpz_submul(v, p, *u0);
+	reduce(v, m);
+
+	scratch_close();
+}
+
+/*
+ * The roots of x^2 - P x + Q are at most R = (|P| + sqrt(P^2 + 4|Q|))/2
+ * in size, and |U_n| <= n R^n-1, |V_n| <= 2 R^n. The fast doubling
+ * keeps about six values that size.
+ */
+
+static int lucas_fits (uint64_t n, mpz_t p, mpz_t q)
+{
+	mpz_t w, a;
+	double r, bits;
+	size_t k;
+
+	mpz_inits(w, a, NULL);
+
+	mpz_abs(a, q);
+	mpz_mul(w, p, p);
+	mpz_addmul_ui(w, a, 4);
+	mpz_abs(a, p);
+
+	/* Scale down so the doubles can't overflow */
+
+	k= mpz_sizeinbase(a, 2);
+	if ( k < mpz_sizeinbase(w, 2)/2 ) k= mpz_sizeinbase(w, 2)/2;
+	k= ( k > 64 ) ? k-64 : 0;
+	mpz_tdiv_q_2exp(a, a, k);
+	mpz_tdiv_q_2exp(w, w, 2*k);
+
+	r= (mpz_get_d(a)+sqrt(mpz_get_d(w)))/2;
+	mpz_clears(w, a, NULL);
+
+	if ( r <= 1 ) r= 1;
+	bits= (double) n*(k+log2(r))+log2((double) n+1)+2;
+
+	return ( 6*bits <= (double) LINREC_MAX_BITS );
+}
+
+/*
+ * With S = max(1, |c_0| + ... + |c_d-1|), the entries of M^n are at
+ * most S^n, and x_n at most d S^n max |x_i|. The job keeps 2d^2 + 2d
+ * values that size.
+ */
+
+static int linrec_fits (uint64_t n, size_t d, mpz_t *c, mpz_t *x)
+{
+	mpz_t s;
+	double xbits= 0, bits;
+	size_t i;
+
+	mpz_init(s);
+	for (i= 0; i< d; ++i) {
+		if ( mpz_sgn(c[i]) < 0 ) mpz_sub(s, s, c[i]);
+		else mpz_add(s, s, c[i]);
+
+		if ( mpz_sgn(x[i]) && log2_mpz(x[i]) > xbits )
+			xbits= log2_mpz(x[i]);
+	}
+
+	bits= ( mpz_cmp_ui(s, 1) > 0 ) ? (double) n*log2_mpz(s) : 0;
+	bits+= xbits+log2((double) d)+2;
+	mpz_clear(s);
+
+	return ( (2*d*d+2*d)*bits <= (double) LINREC_MAX_BITS );
+}
+
+/* log2 of x > 0, for any size of x */
+
+static double log2_mpz (mpz_t x)
+{
+	signed long int e;
+	double m;
+
+	m= mpz_get_d_2exp(&e, x);
+
+	return (double) e+log2(fabs(m));
+}
+
+/* Into [0, m), unless m is 0 */
+
+static void reduce (mpz_t x, mpz_t m)
+{
+	if ( mpz_sgn(m) ) mpz_mod(x, x, m);
+}
+
+/*
+ * The input is a batch of m (0 for none), c_0..c_d-1 and x_0..x_d-1,
+ * and the result a batch of x_n..x_n+d-1, so that a sequence can be
+ * carried on from where it stopped.
+ */
+
+int e_linrec_job (unsigned char *buf, size_t len, uint64_t n)
+{
+	mpz_t *vals, *c, *s;
+	size_t i, j, d, count;
+
+	if ( buf == NULL ) return 0;
+
+	count= mpz_batch_count(buf, len);
+	if ( count == (size_t) -1 || count%2 != 1 ) return 0;
+
+	d= count/2;
+	if ( d == 0 || d > LINREC_MAX_ORDER ) return 0;
+
+	/* m, c, x, then s, t and col */
+
+	vals= malloc((count+2*d*d+d)*sizeof(mpz_t));
+	if ( vals == NULL ) return 0;
+	for (i= 0; i< count+2*d*d+d; ++i) mpz_init(vals[i]);
+
+	c= &vals[1];
+	s= &vals[count];
+
+	if ( mpz_batch_deserialize(vals, count, buf, len) == -1 ||
+		mpz_sgn(vals[0]) < 0 ) goto error;
+
+	for (i= 0; i< 2*d; ++i) reduce(c[i], vals[0]);
+
+	if ( mpz_sgn(vals[0]) == 0 && ! linrec_fits(n, d, c, &vals[1+d]) )
+		goto error;
+
+	/* s= M, or the identity for n= 0 */
+
+	if ( n == 0 ) {
+		for (i= 0; i< d; ++i) mpz_set_ui(s[i*d+i], 1);
+	} else {
+		for (i= 0; i+1< d; ++i) mpz_set_ui(s[i*d+i+1], 1);
+		for (j= 0; j< d; ++j) mpz_set(s[(d-1)*d+j], c[j]);
+	}
+
+	/* lj belongs to the running job, if there is one, until this */
+
+	if ( ! job_reserve() ) goto error;
+
+	lj.d= d;
+	lj.c= c;
+	lj.x= &vals[1+d];
+	lj.s= s;
+	lj.t= &vals[count+d*d];
+	lj.col= &vals[count+2*d*d];
+	mpz_init_set(lj.m, vals[0]);
+
+	lj.n= n;
+	for (lj.bit= 63; lj.bit > 0 && ! (n>>lj.bit & 1); --lj.bit);
+	--lj.bit;
+
+	lj.ctr= 0;
+	lj.done= 0;
+	lj.over= ( lj.bit < 0 );
+
+	job_publish(linrec_work, linrec_finish, &lj);
+
+	return 1;
+
+error:
+	for (i= 0; i< count+2*d*d+d; ++i) mpz_clear(vals[i]);
+	free(vals);
+	return 0;
+}
+
+static void linrec_work (void *arg, int tid)
+{
+	struct linrec_job *job= (struct linrec_job *) arg;
+	size_t d= job->d;
+	uint64_t claim;
+	size_t e, k;
+	mpz_t *r;
+
+	while ( ! __atomic_load_n(&job->over, __ATOMIC_ACQUIRE) ) {
+		claim= __sync_fetch_and_add(&job->ctr, 1);
+		e= (size_t) (claim & 0xffffffff);
+
+		/* All claimed, so wait for the next squaring to start */
+
+		if ( e >= d*d ) {
+			while ( ! __atomic_load_n(&job->over, __ATOMIC_ACQUIRE) &&
+				__atomic_load_n(&job->ctr, __ATOMIC_ACQUIRE)>>32 ==
+				claim>>32 ) __asm__ __volatile__ ("pause");
+			continue;
+		}
+
+		/* t[e] is row e/d of s times column e%d */
+
+		r= &job->t[e];
+		mpz_set_ui(*r, 0);
+		for (k= 0; k< d; ++k)
+			mpz_addmul(*r, job->s[(e/d)*d+k], job->s[k*d+e%d]);
+		reduce(*r, job->m);
+
+		if ( __sync_add_and_fetch(&job->done, 1) == d*d ) linrec_next(job);
+	}
+}
+
+/* Called by the one thread that finished the squaring */
+
+static void linrec_next (struct linrec_job *job)
+{
+	uint64_t phase;
+	mpz_t *tmp;
+
+	tmp= job->s;
+	job->s= job->t;
+	job->t= tmp;
+
+	if ( job->n>>job->bit & 1 ) mul_companion(job);
+
+	if ( --job->bit < 0 ) {
+		__atomic_store_n(&job->over, 1, __ATOMIC_RELEASE);
+		return;
+	}
+
+	/*
+	 * Nobody can finish an entry of the next squaring before it is
+	 * published, so done can be reset first. A stray claim of an
+	 * entry past the end may be lost to the store, which is harmless.
+	 */
+
+	__atomic_store_n(&job->done, 0, __ATOMIC_RELAXED);
+	phase= __atomic_load_n(&job->ctr, __ATOMIC_RELAXED)>>32;
+	__atomic_store_n(&job->ctr, (phase+1)<<32, __ATOMIC_RELEASE);
+}
+
+/*
+ * s= s M. Column j of the product is column j-1 of s, plus c_j times
+ * the last column.
+ */
+
+static void mul_companion (struct linrec_job *job)
+{
+	size_t d= job->d;
+	size_t i, j;
+
+	for (i= 0; i< d; ++i) {
+		mpz_swap(job->col[i], job->s[i*d+d-1]);
+		for (j= d-1; j> 0; --j) mpz_swap(job->s[i*d+j], job->s[i*d+j-1]);
+		mpz_set_ui(job->s[i*d], 0);
+
+		for (j= 0; j< d; ++j) {
+			mpz_addmul(job->s[i*d+j], job->c[j], job->col[i]);
+			reduce(job->s[i*d+j], job->m);
+		}
+	}
+}
+
+static size_t linrec_finish (void *arg)
+{
+	struct linrec_job *job= (struct linrec_job *) arg;
+	unsigned char *buf;
+	size_t i, k, d= job->d, len= 0;
+
+	/* x_n+i= row i of M^n times x_0..x_d-1, into col */
+
+	for (i= 0; i< d; ++i) {
+		mpz_set_ui(job->col[i], 0);
+		for (k= 0; k< d; ++k)
+			mpz_addmul(job->col[i], job->s[i*d+k], job->x[k]);
+		reduce(job->col[i], job->m);
+	}
+
+	buf= mpz_batch_serialize(job->col, d, &len);
+
+	linrec_free(job);
+
+	if ( buf == NULL ) return 0;
+
+	return result_set((char *) buf, len);
+}
+
+static void linrec_free (struct linrec_job *job)
+{
+	mpz_t *vals= job->c-1;
+	size_t i, d= job->d;
+
+	/* s and t may have been swapped, but both are still in vals */
+
+	for (i= 0; i< 1+2*d+2*d*d+d; ++i) mpz_clear(vals[i]);
+	free(vals);
+	mpz_clear(job->m);
+}
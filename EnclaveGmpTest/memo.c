@@ -0,0 +1,337 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include <string.h>
+#include "enclave.h"
+#include "ecall_stats.h"
+
+/*
+ * A cache of serialized results, for traffic that repeats the same
+ * requests. Entries are keyed by the ECALL (its STATS_ code), an
+ * integer parameter such as the digit count, and the operand bytes,
+ * and the whole key is compared on a hit, so a hash collision can only
+ * cost a miss. A hit hands back a copy of the result without
+ * deserializing or computing anything.
+ *
+ * The cache is off until e_memo_config() gives it a budget. Entries,
+ * keys and results together stay within that budget, the least
+ * recently used going first, and no one entry may take more than a
+ * quarter of it. The entries come from the enclave heap through the
+ * GMP hooks, and if the heap runs out, memo_trim() empties the cache.
+ */
+
+#define MEMO_BUCKETS	4096	/* A power of two */
+#define MEMO_MAX_SHARE	4
+
+struct memo_entry {
+	struct memo_entry *next;	/* In the same bucket */
+	struct memo_entry *newer, *older;
+	uint64_t hash, param;
+	int op;
+	size_t len_a, len_b;
+	size_t len, size;	/* Of the result, and its allocation */
+	size_t bytes;	/* Of the whole entry */
+	unsigned char data[];	/* a, b, then the result */
+};
+
+static struct memo_entry *buckets[MEMO_BUCKETS];
+static struct memo_entry *newest= NULL, *oldest= NULL;
+static struct memo_stats memo;
+static volatile int memo_lock= 0;
+
+static inline void lock ();
+static inline void unlock ();
+static uint64_t memo_hash (int op, uint64_t param, const void *a,
+	size_t len_a, const void *b, size_t len_b);
+static struct memo_entry *memo_find (uint64_t hash, int op, uint64_t param,
+	const void *a, size_t len_a, const void *b, size_t len_b);
+static void memo_unlink (struct memo_entry *e);
+static void memo_evict (uint64_t max);
+
+/*
+ * Set the budget in bytes, shrinking the cache to fit, and return the
+ * old one. 0 turns the cache off and empties it.
+ */
+
+uint64_t e_memo_config (uint64_t max_bytes)
+{
+	uint64_t old;
+
+	lock();
+	old= memo.max_bytes;
+	__atomic_store_n(&memo.max_bytes, max_bytes, __ATOMIC_RELAXED);
+	memo_evict(max_bytes);
+	unlock();
+
+	return old;
+}
+
+/* Like e_heap_stats() */
+
+size_t e_memo_stats (unsigned char *buf, size_t len, int reset)
+{
+	if ( buf == NULL || len < sizeof(memo) ) return sizeof(memo);
+
+	lock();
+	memcpy(buf, &memo, sizeof(memo));
+	if ( reset ) memo.hits= memo.misses= memo.inserts= memo.evictions= 0;
+	unlock();
+
+	return sizeof(memo);
+}
+
+/*
+ * Look for a cached result and, if there is one, make a copy of it the
+ * pending result. Returns its length, or 0 on a miss.
+ */
+
+size_t memo_get (int op, uint64_t param, const void *a, size_t len_a,
+	const void *b, size_t len_b)
+{
+	struct memo_entry *e;
+	uint64_t hash;
+	char *buf= NULL;
+	size_t len= 0, size= 0;
+
+	if ( ! __atomic_load_n(&memo.max_bytes, __ATOMIC_RELAXED) ) return 0;
+
+	hash= memo_hash(op, param, a, len_a, b, len_b);
+
+	lock();
+
+	e= memo_find(hash, op, param, a, len_a, b, len_b);
+	if ( e == NULL ) {
+		++memo.misses;
+		unlock();
+		return 0;
+	}
+
+	/* Move it to the front, and copy the result out. */
+
+	if ( e != newest ) {
+		memo_unlink(e);
+		e->older= newest;
+		e->newer= NULL;
+		newest->newer= e;
+		newest= e;
+	}
+
+	buf= allocate_function(e->size);
+	if ( buf != NULL ) {
+		memcpy(buf, e->data+e->len_a+e->len_b, e->size);
+		len= e->len;
+		size= e->size;
+		++memo.hits;
+	} else {
+		++memo.misses;
+	}
+
+	unlock();
+
+	if ( buf == NULL ) return 0;
+
+	/* String results carry their NULL. */
+
+	return ( size > len ) ? result_set_str(buf) : result_set(buf, len);
+}
+
+/* Cache the pending result as the one for this request. */
+
+void memo_put (int op, uint64_t param, const void *a, size_t len_a,
+	const void *b, size_t len_b)
+{
+	struct memo_entry *e;
+	const char *res;
+	size_t len, size, bytes;
+	uint64_t hash, max;
+
+	max= __atomic_load_n(&memo.max_bytes, __ATOMIC_RELAXED);
+	if ( ! max ) return;
+
+	res= result_get(&len, &size);
+	if ( res == NULL ) return;
+
+	bytes= sizeof(struct memo_entry)+len_a+len_b+size;
+	if ( bytes > max/MEMO_MAX_SHARE ) return;
+
+	hash= memo_hash(op, param, a, len_a, b, len_b);
+
+	/* Fill it in before taking the lock, which allocation can't. */
+
+	e= allocate_function(bytes);
+	if ( e == NULL ) return;
+
+	e->hash= hash;
+	e->param= param;
+	e->op= op;
+	e->len_a= len_a;
+	e->len_b= len_b;
+	e->len= len;
+	e->size= size;
+	e->bytes= bytes;
+	memcpy(e->data, a, len_a);
+	memcpy(e->data+len_a, b, len_b);
+	memcpy(e->data+len_a+len_b, res, size);
+
+	lock();
+
+	/* Another thread may have got here first, or turned it off. */
+
+	if ( memo.max_bytes < bytes*MEMO_MAX_SHARE ||
+		memo_find(hash, op, param, a, len_a, b, len_b) != NULL )
+	{
+		unlock();
+		free_function(e, bytes);
+		return;
+	}
+
+	memo_evict(memo.max_bytes-bytes);
+
+	e->next= buckets[hash&(MEMO_BUCKETS-1)];
+	buckets[hash&(MEMO_BUCKETS-1)]= e;
+
+	e->newer= NULL;
+	e->older= newest;
+	if ( newest != NULL ) newest->newer= e;
+	newest= e;
+	if ( oldest == NULL ) oldest= e;
+
+	++memo.inserts;
+	++memo.entries;
+	memo.bytes+= bytes;
+	heap_note_kept((int64_t) bytes, 1);
+
+	unlock();
+}
+
+/*
+ * Called when an allocation fails. Empties the cache, unless the
+ * failure came from inside it. Returns nonzero if anything was freed.
+ */
+
+int memo_trim ()
+{
+	uint64_t entries;
+
+	if ( __sync_lock_test_and_set(&memo_lock, 1) ) return 0;
+
+	entries= memo.entries;
+	memo_evict(0);
+	unlock();
+
+	return ( entries != 0 );
+}
+
+static inline void lock ()
+{
+	while ( __sync_lock_test_and_set(&memo_lock, 1) )
+		__asm__ __volatile__ ("pause");
+}
+
+static inline void unlock ()
+{
+	__sync_lock_release(&memo_lock);
+}
+
+/* FNV-1a */
+
+static uint64_t memo_hash (int op, uint64_t param, const void *a,
+	size_t len_a, const void *b, size_t len_b)
+{
+	const unsigned char *p;
+	uint64_t h= 0xcbf29ce484222325ULL;
+	uint64_t head[3];
+	size_t i;
+
+	head[0]= (uint64_t) op;
+	head[1]= param;
+	head[2]= (uint64_t) len_a;
+
+	for (p= (const unsigned char *) head, i= 0; i< sizeof(head); ++i)
+		h= (h^p[i])*0x100000001b3ULL;
+	for (p= a, i= 0; i< len_a; ++i) h= (h^p[i])*0x100000001b3ULL;
+	for (p= b, i= 0; i< len_b; ++i) h= (h^p[i])*0x100000001b3ULL;
+
+	return h;
+}
+
+static struct memo_entry *memo_find (uint64_t hash, int op, uint64_t param,
+	const void *a, size_t len_a, const void *b, size_t len_b)
+{
+	struct memo_entry *e;
+
+	for (e= buckets[hash&(MEMO_BUCKETS-1)]; e != NULL; e= e->next) {
+		if ( e->hash == hash && e->op == op && e->param == param &&
+			e->len_a == len_a && e->len_b == len_b &&
+			memcmp(e->data, a, len_a) == 0 &&
+			memcmp(e->data+len_a, b, len_b) == 0 )
+		{
+			return e;
+		}
+	}
+
+	return NULL;
+}
+
+/* Take an entry off the LRU list, but not out of its bucket. */
+
+static void memo_unlink (struct memo_entry *e)
+{
+	if ( e->newer != NULL ) e->newer->older= e->older;
+	else newest= e->older;
+
+	if ( e->older != NULL ) e->older->newer= e->newer;
+	else oldest= e->newer;
+}
+
+/* Drop the oldest entries until the cache fits in max bytes. */
+
+static void memo_evict (uint64_t max)
+{
+	while ( oldest != NULL && memo.bytes > max ) {
+		struct memo_entry *e= oldest, **pp;
+
+		for (pp= &buckets[e->hash&(MEMO_BUCKETS-1)]; *pp != e;
+			pp= &(*pp)->next);
+		*pp= e->next;
+
+		memo_unlink(e);
+
+		++memo.evictions;
+		--memo.entries;
+		memo.bytes-= e->bytes;
+		heap_note_kept(-(int64_t) e->bytes, -1);
+
+		free_function(e, e->bytes);
+	}
+}
@@ -0,0 +1,280 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include <stdlib.h>
+#include "enclave.h"
+#include "serialize.h"
+
+/*
+ * Rational arithmetic. The add, sub, mul and div calls take a batch of
+ * two or more rationals and fold the operation left to right:
+ *
+ *   q1 op q2 op ... op qn
+ *
+ * The intermediate values are never reduced, which saves a gcd per
+ * step at the cost of larger operands. The final value is
+ * canonicalized only if asked, so a long chain can be split across
+ * several calls and reduced once at the end.
+ *
+ * GMP's mpq functions require canonical inputs, so the folding is done
+ * on the numerators and denominators directly.
+ */
+
+#define MPQ_ADD 0
+#define MPQ_SUB 1
+#define MPQ_MUL 2
+#define MPQ_DIV 3
+
+static mpq_t *q_load (unsigned char *buf, size_t len, size_t *n);
+static void q_release (mpq_t *q, size_t n);
+static size_t q_store (mpq_t *q, size_t n);
+static int q_fold (int op, mpq_t acc, mpq_t *q, size_t n);
+static size_t q_op (int op, unsigned char *buf, size_t len,
+	int canonical);
+
+static mpq_t *q_load (unsigned char *buf, size_t len, size_t *n)
+{
+	mpq_t *q;
+	size_t i;
+
+	if ( buf == NULL ) return NULL;
+
+	*n= mpq_batch_count(buf, len);
+	if ( *n == (size_t) -1 || *n == 0 ) return NULL;
+
+	q= malloc(*n*sizeof(mpq_t));
+	if ( q == NULL ) return NULL;
+
+	for (i= 0; i< *n; ++i) mpq_init(q[i]);
+
+	if ( mpq_batch_deserialize(q, *n, buf, len) == -1 ) {
+		q_release(q, *n);
+		return NULL;
+	}
+
+	return q;
+}
+
+static void q_release (mpq_t *q, size_t n)
+{
+	size_t i;
+
+	for (i= 0; i< n; ++i) mpq_clear(q[i]);
+	free(q);
+}
+
+static size_t q_store (mpq_t *q, size_t n)
+{
+	unsigned char *out;
+	size_t olen;
+
+	out= mpq_batch_serialize(q, n, &olen);
+	if ( out == NULL ) return 0;
+
+	return result_set((char *) out, olen);
+}
+
+static int q_fold (int op, mpq_t acc, mpq_t *q, size_t n)
+{
+	mpz_ptr an= mpq_numref(acc), ad= mpq_denref(acc);
+	mpz_t t;
+	size_t i;
+
+	mpz_init(t);
+	mpq_set(acc, q[0]);
+
+	for (i= 1; i< n; ++i) {
+		mpz_srcptr qn= mpq_numref(q[i]), qd= mpq_denref(q[i]);
+
+		switch (op) {
+		case MPQ_ADD:
+		case MPQ_SUB:
+			/* Sums in a common unit are the usual case. */
+
+			if ( mpz_cmp(ad, qd) == 0 ) {
+				if ( op == MPQ_ADD ) mpz_add(an, an, qn);
+				else mpz_sub(an, an, qn);
+				break;
+			}
+
+			mpz_mul(t, qn, ad);
+			mpz_mul(an, an, qd);
+			if ( op == MPQ_ADD ) mpz_add(an, an, t);
+			else mpz_sub(an, an, t);
+			mpz_mul(ad, ad, qd);
+			break;
+		case MPQ_MUL:
+			mpz_mul(an, an, qn);
+			mpz_mul(ad, ad, qd);
+			break;
+		case MPQ_DIV:
+			if ( mpz_sgn(qn) == 0 ) {
+				mpz_clear(t);
+				return 0;
+			}
+
+			mpz_mul(an, an, qd);
+			mpz_mul(ad, ad, qn);
+			if ( mpz_sgn(ad) < 0 ) {
+				mpz_neg(an, an);
+				mpz_neg(ad, ad);
+			}
+			break;
+		default:
+			mpz_clear(t);
+			return 0;
+		}
+	}
+
+	mpz_clear(t);
+
+	return 1;
+}
+
+static size_t q_op (int op, unsigned char *buf, size_t len,
+	int canonical)
+{
+	mpq_t *q, acc;
+	size_t n, rv= 0;
+	uint64_t start;
+
+	start= stats_start();
+
+	/* Clear the last, serialized result */
+
+	result_clear();
+
+	q= q_load(buf, len, &n);
+	if ( q == NULL ) return 0;
+
+	mpq_init(acc);
+
+	if ( n >= 2 && q_fold(op, acc, q, n) ) {
+		if ( canonical ) mpq_canonicalize(acc);
+		rv= q_store(&acc, 1);
+	}
+
+	mpq_clear(acc);
+	q_release(q, n);
+
+	/* The MPQ_ ops are in the same order as their counters. */
+
+	if ( rv ) stats_record(STATS_MPQ_ADD+op, start, len, rv);
+
+	return rv;
+}
+
+size_t e_mpq_add (unsigned char *buf, size_t len, int canonical)
+{
+	return q_op(MPQ_ADD, buf, len, canonical);
+}
+
+size_t e_mpq_sub (unsigned char *buf, size_t len, int canonical)
+{
+	return q_op(MPQ_SUB, buf, len, canonical);
+}
+
+size_t e_mpq_mul (unsigned char *buf, size_t len, int canonical)
+{
+	return q_op(MPQ_MUL, buf, len, canonical);
+}
+
+size_t e_mpq_div (unsigned char *buf, size_t len, int canonical)
+{
+	return q_op(MPQ_DIV, buf, len, canonical);
+}
+
+/* Reduce every rational in the batch to lowest terms. */
+
+size_t e_mpq_canonicalize (unsigned char *buf, size_t len)
+{
+	mpq_t *q;
+	size_t i, n, rv;
+	uint64_t start;
+
+	start= stats_start();
+
+	result_clear();
+
+	q= q_load(buf, len, &n);
+	if ( q == NULL ) return 0;
+
+	for (i= 0; i< n; ++i) mpq_canonicalize(q[i]);
+
+	rv= q_store(q, n);
+	q_release(q, n);
+
+	if ( rv ) stats_record(STATS_MPQ_CANONICALIZE, start, len, rv);
+
+	return rv;
+}
+
+/*
+ * Compare exactly two rationals. This doesn't need canonical inputs,
+ * just positive denominators, which deserializing guarantees.
+ */
+
+int e_mpq_cmp (unsigned char *buf, size_t len, int *cmp)
+{
+	mpq_t *q;
+	mpz_t l, r;
+	size_t n;
+	uint64_t start;
+
+	if ( cmp == NULL ) return 0;
+
+	start= stats_start();
+
+	q= q_load(buf, len, &n);
+	if ( q == NULL ) return 0;
+
+	if ( n != 2 ) {
+		q_release(q, n);
+		return 0;
+	}
+
+	mpz_inits(l, r, NULL);
+	mpz_mul(l, mpq_numref(q[0]), mpq_denref(q[1]));
+	mpz_mul(r, mpq_numref(q[1]), mpq_denref(q[0]));
+
+	*cmp= mpz_cmp(l, r);
+	if ( *cmp > 0 ) *cmp= 1;
+	else if ( *cmp < 0 ) *cmp= -1;
+
+	mpz_clears(l, r, NULL);
+	q_release(q, n);
+
+	stats_record(STATS_MPQ_CMP, start, len, sizeof(*cmp));
+
+	return 1;
+}
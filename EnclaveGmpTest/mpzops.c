@@ -0,0 +1,106 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include "enclave.h"
+#include "serialize.h"
+
+/*
+ * Many integer operations in one call, for sgxgmpmath -f. ops holds one
+ * MPZ_OP_ code per operation, and buf a batch of their operands, a and
+ * b for each in turn. The results are written straight to out as a
+ * batch, in order, rather than going through e_get_result(), so any
+ * number of threads can make this call at once.
+ *
+ * Returns the length of the result batch, or 0 if the input is bad,
+ * a divisor is zero, or out is too small. A result is never longer
+ * than the operands it came from plus a byte.
+ */
+
+size_t e_mpz_ops (unsigned char *ops, size_t nops, unsigned char *buf,
+	size_t len, unsigned char *out, size_t out_len)
+{
+	mpz_t *vals;
+	size_t i, n, olen= 0;
+	uint64_t start;
+
+	start= stats_start();
+
+	if ( ops == NULL || buf == NULL || out == NULL || nops == 0 ) return 0;
+
+	n= mpz_batch_count(buf, len);
+	if ( n == (size_t) -1 || n/2 != nops || n%2 ) return 0;
+
+	/* Same-sized batches reuse the last one's integers and limbs. */
+
+	scratch_open();
+	vals= scratch_mpz_vec(n);
+	if ( vals == NULL ) goto cleanup;
+
+	if ( mpz_batch_deserialize(vals, n, buf, len) == -1 ) goto cleanup;
+
+	/*
+	 * Operation i reads vals[2i] and vals[2i+1], so its result can go
+	 * in vals[i], which has already been used.
+	 */
+
+	for (i= 0; i< nops; ++i) {
+		mpz_ptr a= vals[2*i], b= vals[2*i+1];
+
+		switch (ops[i]) {
+		case MPZ_OP_ADD:
+			mpz_add(vals[i], a, b);
+			break;
+		case MPZ_OP_SUB:
+			mpz_sub(vals[i], a, b);
+			break;
+		case MPZ_OP_MUL:
+			mpz_mul(vals[i], a, b);
+			break;
+		case MPZ_OP_DIV:
+			if ( mpz_sgn(b) == 0 ) goto cleanup;
+			mpz_div(vals[i], a, b);
+			break;
+		default:
+			goto cleanup;
+		}
+	}
+
+	olen= mpz_batch_write(out, out_len, vals, nops);
+
+cleanup:
+	scratch_close();
+
+	if ( olen ) stats_record(STATS_MPZ_OPS, start, len+nops, olen);
+
+	return olen;
+}
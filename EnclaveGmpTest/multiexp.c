@@ -0,0 +1,322 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include "enclave.h"
+#include "serialize.h"
+
+/*
+ * Multi-exponentiation: r = g1^e1 * g2^e2 * ... * gn^en mod m
+ *
+ * The input is a batch of m, g1..gn, e1..en. Small batches use Straus'
+ * interleaved method, where all of the terms share one chain of
+ * squarings. Larger batches use Pippenger's bucket method, which avoids
+ * the per-base precomputation tables.
+ */
+
+#define MULTIEXP_STRAUS_MAX	32
+#define MULTIEXP_MAX_WINDOW	16
+
+static void straus (mpz_t r, mpz_t *g, mpz_t *e, size_t n, mpz_t m,
+	size_t bits);
+static int pippenger (mpz_t r, mpz_t *g, mpz_t *e, size_t n, mpz_t m,
+	size_t bits);
+static unsigned long digit (mpz_t e, size_t pos, unsigned int w);
+
+size_t e_multi_exp (unsigned char *buf, size_t len)
+{
+	mpz_t *vals, *g, *e, r;
+	unsigned char *out;
+	size_t i, n, nterms, bits= 1, olen= 0;
+	uint64_t start;
+	int ok= 0;
+
+	start= stats_start();
+
+	/* Clear the last, serialized result */
+
+	result_clear();
+
+	if ( buf == NULL ) return 0;
+
+	n= mpz_batch_count(buf, len);
+	if ( n == (size_t) -1 || n%2 != 1 ) return 0;
+
+	nterms= (n-1)/2;
+
+	/* The same exponentiation again comes straight from the cache. */
+
+	olen= memo_get(STATS_MULTI_EXP, 0, buf, len, "", 0);
+	if ( olen ) {
+		stats_record(STATS_MULTI_EXP, start, len, olen);
+		return olen;
+	}
+
+	vals= malloc(n*sizeof(mpz_t));
+	if ( vals == NULL ) return 0;
+
+	for (i= 0; i< n; ++i) mpz_init(vals[i]);
+	mpz_init(r);
+
+	g= &vals[1];
+	e= &vals[1+nterms];
+
+	if ( mpz_batch_deserialize(vals, n, buf, len) == -1 ) goto cleanup;
+	if ( mpz_sgn(vals[0]) <= 0 ) goto cleanup;
+
+	/* Reduce the bases, and turn negative exponents into inverses. */
+
+	for (i= 0; i< nterms; ++i) {
+		size_t ebits;
+
+		mpz_mod(g[i], g[i], vals[0]);
+		if ( mpz_sgn(e[i]) < 0 ) {
+			if ( ! mpz_invert(g[i], g[i], vals[0]) ) goto cleanup;
+			mpz_neg(e[i], e[i]);
+		}
+
+		ebits= mpz_sizeinbase(e[i], 2);
+		if ( ebits > bits ) bits= ebits;
+	}
+
+	if ( nterms <= MULTIEXP_STRAUS_MAX ) {
+		straus(r, g, e, nterms, vals[0], bits);
+	} else if ( ! pippenger(r, g, e, nterms, vals[0], bits) ) {
+		goto cleanup;
+	}
+
+	ok= 1;
+
+cleanup:
+	if ( ok ) {
+		out= mpz_batch_serialize(&r, 1, &olen);
+		if ( out == NULL ) olen= 0;
+		else result_set((char *) out, olen);
+		if ( olen ) memo_put(STATS_MULTI_EXP, 0, buf, len, "", 0);
+	}
+
+	for (i= 0; i< n; ++i) mpz_clear(vals[i]);
+	mpz_clear(r);
+	free(vals);
+
+	if ( olen ) stats_record(STATS_MULTI_EXP, start, len, olen);
+
+	return olen;
+}
+
+/* The w-bit digit of e starting at bit pos */
+
+static unsigned long digit (mpz_t e, size_t pos, unsigned int w)
+{
+	unsigned long d= 0;
+	unsigned int b;
+
+	for (b= 0; b< w; ++b) d|= (unsigned long) mpz_tstbit(e, pos+b) << b;
+
+	return d;
+}
+
+/*
+ * Straus: precompute g^1 .. g^(2^w-1) for every base, then walk the
+ * exponents a window at a time from the top, squaring w times and
+ * multiplying in one table entry per base. The window minimizes the
+ * multiplications needed for the table plus the scan.
+ */
+
+static void straus (mpz_t r, mpz_t *g, mpz_t *e, size_t n, mpz_t m,
+	size_t bits)
+{
+	mpz_t *table;
+	unsigned int w, bw= 1;
+	size_t i, j, k, tsize, nwin, cost, best= (size_t) -1;
+
+	for (w= 1; w<= 8; ++w) {
+		cost= n*((1UL<<w)-2)+n*((bits+w-1)/w);
+		if ( cost < best ) {
+			best= cost;
+			bw= w;
+		}
+	}
+
+	w= bw;
+	tsize= 1UL<<w;
+
+	table= malloc(n*tsize*sizeof(mpz_t));
+	if ( table == NULL ) w= 1;
+
+	if ( table != NULL ) {
+		for (i= 0; i< n; ++i) {
+			mpz_t *t= &table[i*tsize];
+
+			mpz_init_set_ui(t[0], 1);
+			mpz_init_set(t[1], g[i]);
+			for (j= 2; j< tsize; ++j) {
+				mpz_init(t[j]);
+				mpz_mul(t[j], t[j-1], g[i]);
+				mpz_mod(t[j], t[j], m);
+			}
+		}
+	}
+
+	mpz_set_ui(r, 1);
+	nwin= (bits+w-1)/w;
+
+	for (k= nwin; k-- > 0; ) {
+		for (j= 0; j< w; ++j) {
+			mpz_mul(r, r, r);
+			mpz_mod(r, r, m);
+		}
+
+		for (i= 0; i< n; ++i) {
+			unsigned long d= digit(e[i], k*w, w);
+
+			if ( d == 0 ) continue;
+
+			/* Without a table we fall back to w=1, where d is 1. */
+
+			mpz_mul(r, r, (table == NULL) ? g[i] : table[i*tsize+d]);
+			mpz_mod(r, r, m);
+		}
+	}
+
+	mpz_mod(r, r, m);
+
+	if ( table != NULL ) {
+		for (i= 0; i< n*tsize; ++i) mpz_clear(table[i]);
+		free(table);
+	}
+}
+
+/*
+ * Pippenger: for each window, drop every base into the bucket for its
+ * digit, then form the product of bucket[d]^d with a running product
+ * from the top bucket down. That costs about n + 2^(c+1) multiplies
+ * per window no matter how many terms share a digit.
+ */
+
+static int pippenger (mpz_t r, mpz_t *g, mpz_t *e, size_t n, mpz_t m,
+	size_t bits)
+{
+	mpz_t *bucket, running, acc;
+	unsigned char *used;
+	unsigned int c, bc= 1;
+	size_t i, j, k, nb, nwin, cost, best= (size_t) -1;
+	int have_running, have_acc;
+
+	for (c= 1; c<= MULTIEXP_MAX_WINDOW; ++c) {
+		cost= ((bits+c-1)/c)*(n+(2UL<<c));
+		if ( cost < best ) {
+			best= cost;
+			bc= c;
+		}
+	}
+
+	c= bc;
+	nb= 1UL<<c;
+
+	bucket= malloc(nb*sizeof(mpz_t));
+	used= malloc(nb);
+	if ( bucket == NULL || used == NULL ) {
+		free(bucket);
+		free(used);
+		return 0;
+	}
+
+	for (j= 0; j< nb; ++j) mpz_init(bucket[j]);
+	mpz_inits(running, acc, NULL);
+
+	mpz_set_ui(r, 1);
+	nwin= (bits+c-1)/c;
+
+	for (k= nwin; k-- > 0; ) {
+		for (j= 0; j< c; ++j) {
+			mpz_mul(r, r, r);
+			mpz_mod(r, r, m);
+		}
+
+		memset(used, 0, nb);
+
+		for (i= 0; i< n; ++i) {
+			unsigned long d= digit(e[i], k*c, c);
+
+			if ( d == 0 ) continue;
+
+			if ( used[d] ) {
+				mpz_mul(bucket[d], bucket[d], g[i]);
+				mpz_mod(bucket[d], bucket[d], m);
+			} else {
+				mpz_set(bucket[d], g[i]);
+				used[d]= 1;
+			}
+		}
+
+		have_running= have_acc= 0;
+
+		for (j= nb-1; j> 0; --j) {
+			if ( used[j] ) {
+				if ( have_running ) {
+					mpz_mul(running, running, bucket[j]);
+					mpz_mod(running, running, m);
+				} else {
+					mpz_set(running, bucket[j]);
+					have_running= 1;
+				}
+			}
+
+			if ( ! have_running ) continue;
+
+			if ( have_acc ) {
+				mpz_mul(acc, acc, running);
+				mpz_mod(acc, acc, m);
+			} else {
+				mpz_set(acc, running);
+				have_acc= 1;
+			}
+		}
+
+		if ( have_acc ) {
+			mpz_mul(r, r, acc);
+			mpz_mod(r, r, m);
+		}
+	}
+
+	mpz_mod(r, r, m);
+
+	for (j= 0; j< nb; ++j) mpz_clear(bucket[j]);
+	mpz_clears(running, acc, NULL);
+	free(bucket);
+	free(used);
+
+	return 1;
+}
@@ -0,0 +1,320 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include <stdlib.h>
+#include <math.h>
+#include "serialize.h"
+#include "enclave.h"
+
+/*
+ * Pi by binary splitting, in pieces that can be computed by different
+ * enclaves and merged. The Chudnovsky sum over terms [a, b) reduces to
+ * three integers:
+ *
+ *   P(a, b) = p(a) ... p(b-1)       p(k) = (6k-5)(2k-1)(6k-1)
+ *   Q(a, b) = q(a) ... q(b-1)       q(k) = k^3 640320^3 / 24
+ *   T(a, b) = Q(a, b) SUM (-1)^k (13591409+545140134k) P(a, k+1)
+ *                          / Q(a, k+1), for k in [a, b)
+ *
+ * with p(0) = q(0) = 1, and adjacent ranges combine as
+ *
+ *   P(a, c) = P(a, b) P(b, c)
+ *   Q(a, c) = Q(a, b) Q(b, c)
+ *   T(a, c) = T(a, b) Q(b, c) + P(a, b) T(b, c)
+ *
+ * Then pi = 426880 sqrt(10005) Q(0, n) / T(0, n). Only the last step
+ * needs floating point, so the partials are exact, and the file format
+ * in serialize.h is just the batch format.
+ *
+ * The number of terms depends on the digits, and the digits are kept
+ * in each partial so that ones made for different runs can't be mixed.
+ *
+ * While the right half of a range is split, the left half's products
+ * sit unused, so they are spilled out of the enclave if spilling is on
+ * and they are big enough (see spill.c). So are the two products that
+ * aren't needed for T while it is combined.
+ */
+
+#define PI_A		13591409
+#define PI_B		545140134
+#define PI_C3_24	10939058860032000UL	/* 640320^3 / 24 */
+
+static int split (mpz_t P, mpz_t Q, mpz_t T, uint64_t a, uint64_t b);
+static int combine (mpz_t P, mpz_t Q, mpz_t T, mpz_t P2, mpz_t Q2,
+	mpz_t T2);
+static int check_part (mpz_t *part, uint64_t digits, uint64_t *a,
+	uint64_t *b);
+
+/*
+ * Computes part number "part" of "parts" equal shares of the terms for
+ * this many digits, and leaves it as the pending result.
+ */
+
+size_t e_pi_split (uint64_t digits, uint64_t part, uint64_t parts)
+{
+	mpz_t vals[PI_PART_LEN];
+	unsigned char *out;
+	uint64_t n, share, extra, a, b;
+	size_t i, len= 0;
+	int ok= 1;
+
+	result_clear();
+
+	if ( digits == 0 || parts == 0 || part >= parts ) return 0;
+
+	/* Match e_pi, which sums to one more digit than it returns */
+
+	n= pi_terms(digits+1);
+	share= n/parts;
+	extra= n%parts;
+	a= part*share + ( part < extra ? part : extra );
+	b= a + share + ( part < extra );
+
+	for (i= 0; i< PI_PART_LEN; ++i) mpz_init(vals[i]);
+
+	mpz_set_ui(vals[PI_PART_DIGITS], digits);
+	mpz_set_ui(vals[PI_PART_A], a);
+	mpz_set_ui(vals[PI_PART_B], b);
+
+	/* With more parts than terms, a part can be empty */
+
+	if ( a < b ) ok= split(vals[PI_PART_P], vals[PI_PART_Q],
+		vals[PI_PART_T], a, b);
+	else {
+		mpz_set_ui(vals[PI_PART_P], 1);
+		mpz_set_ui(vals[PI_PART_Q], 1);
+		mpz_set_ui(vals[PI_PART_T], 0);
+	}
+
+	out= ( ok ) ? mpz_batch_serialize(vals, PI_PART_LEN, &len) : NULL;
+	if ( out == NULL ) len= 0;
+	else result_set((char *) out, len);
+
+	for (i= 0; i< PI_PART_LEN; ++i) mpz_clear(vals[i]);
+
+	return len;
+}
+
+/*
+ * Merges the partials in buf, one batch of PI_PART_LEN integers after
+ * another, which must be for these digits and cover consecutive ranges
+ * in order. The result is the merged partial or, if final is set, pi,
+ * in which case the partials must cover every term.
+ */
+
+size_t e_pi_merge (unsigned char *buf, size_t len, uint64_t digits,
+	int final)
+{
+	mpz_t *vals;
+	size_t i, n, nparts, step, olen= 0;
+	uint64_t a, b, first= 0, last= 0;
+
+	result_clear();
+
+	if ( buf == NULL || digits == 0 ) return 0;
+
+	n= mpz_batch_count(buf, len);
+	if ( n == (size_t) -1 || n == 0 || n%PI_PART_LEN ) return 0;
+	nparts= n/PI_PART_LEN;
+
+	vals= malloc(n*sizeof(mpz_t));
+	if ( vals == NULL ) return 0;
+
+	for (i= 0; i< n; ++i) mpz_init(vals[i]);
+
+	if ( mpz_batch_deserialize(vals, n, buf, len) == -1 ) goto cleanup;
+
+	for (i= 0; i< nparts; ++i) {
+		if ( ! check_part(&vals[i*PI_PART_LEN], digits, &a, &b) )
+			goto cleanup;
+		if ( i == 0 ) first= a;
+		else if ( a != last ) goto cleanup;
+		last= b;
+	}
+
+	/* Merge neighbours pairwise, so the operands stay balanced. */
+
+	for (step= 1; step< nparts; step*= 2) {
+		for (i= 0; i+step< nparts; i+= 2*step) {
+			mpz_t *l= &vals[i*PI_PART_LEN];
+			mpz_t *r= &vals[(i+step)*PI_PART_LEN];
+
+			if ( ! combine(l[PI_PART_P], l[PI_PART_Q], l[PI_PART_T],
+				r[PI_PART_P], r[PI_PART_Q], r[PI_PART_T]) ) goto cleanup;
+		}
+	}
+
+	if ( final ) {
+		mpf_t pi, C, f;
+		mp_bitcnt_t precision= (digits+1)*log2(10)+1;
+
+		if ( first != 0 || last != pi_terms(digits+1) ) goto cleanup;
+		if ( mpz_sgn(vals[PI_PART_T]) == 0 ) goto cleanup;
+
+		mpf_init2(pi, precision);
+		mpf_init2(C, precision);
+		mpf_init2(f, precision);
+
+		mpf_sqrt_ui(C, 10005);
+		mpf_mul_ui(C, C, 426880);
+		mpf_set_z(pi, vals[PI_PART_Q]);
+		mpf_mul(pi, pi, C);
+		mpf_set_z(f, vals[PI_PART_T]);
+		mpf_div(pi, pi, f);
+
+		olen= result_set_str(mpf_serialize(pi, digits+1));
+
+		mpf_clear(f);
+		mpf_clear(C);
+		mpf_clear(pi);
+	} else {
+		unsigned char *out;
+
+		mpz_set_ui(vals[PI_PART_B], last);
+
+		out= mpz_batch_serialize(vals, PI_PART_LEN, &olen);
+		if ( out == NULL ) olen= 0;
+		else result_set((char *) out, olen);
+	}
+
+cleanup:
+	for (i= 0; i< n; ++i) mpz_clear(vals[i]);
+	free(vals);
+
+	return olen;
+}
+
+/* Returns 0 if a spilled value couldn't be brought back */
+
+static int split (mpz_t P, mpz_t Q, mpz_t T, uint64_t a, uint64_t b)
+{
+	struct spill sp, sq, st;
+	mpz_t P2, Q2, T2;
+	uint64_t m;
+	int ok;
+
+	if ( b-a == 1 ) {
+		if ( a == 0 ) {
+			mpz_set_ui(P, 1);
+			mpz_set_ui(Q, 1);
+		} else {
+			mpz_set_ui(P, 6*a-5);
+			mpz_mul_ui(P, P, 2*a-1);
+			mpz_mul_ui(P, P, 6*a-1);
+			mpz_set_ui(Q, a);
+			mpz_pow_ui(Q, Q, 3);
+			mpz_mul_ui(Q, Q, PI_C3_24);
+		}
+
+		mpz_set_ui(T, a);
+		mpz_mul_ui(T, T, PI_B);
+		mpz_add_ui(T, T, PI_A);
+		mpz_mul(T, T, P);
+		if ( a & 1 ) mpz_neg(T, T);
+
+		return 1;
+	}
+
+	m= a+(b-a)/2;
+
+	mpz_inits(P2, Q2, T2, NULL);
+
+	ok= split(P, Q, T, a, m);
+
+	spill_out(P, &sp);
+	spill_out(Q, &sq);
+	spill_out(T, &st);
+
+	if ( ok ) ok= split(P2, Q2, T2, m, b);
+
+	/* Bring all three back, whether or not the right half failed */
+
+	if ( ! spill_in(P, &sp) ) ok= 0;
+	if ( ! spill_in(Q, &sq) ) ok= 0;
+	if ( ! spill_in(T, &st) ) ok= 0;
+
+	if ( ok ) ok= combine(P, Q, T, P2, Q2, T2);
+
+	mpz_clears(P2, Q2, T2, NULL);
+
+	return ok;
+}
+
+/*
+ * Folds the range to the right, (P2, Q2, T2), into (P, Q, T). Each of
+ * the right's products is freed once it has been used. Returns 0 if a
+ * spilled value couldn't be brought back.
+ */
+
+static int combine (mpz_t P, mpz_t Q, mpz_t T, mpz_t P2, mpz_t Q2,
+	mpz_t T2)
+{
+	struct spill sq, sp2;
+	int ok= 1;
+
+	spill_out(Q, &sq);
+	spill_out(P2, &sp2);
+
+	mpz_mul(T, T, Q2);
+	mpz_addmul(T, P, T2);
+	mpz_clear(T2);
+	mpz_init(T2);
+
+	if ( ! spill_in(P2, &sp2) ) ok= 0;
+	mpz_mul(P, P, P2);
+	mpz_clear(P2);
+	mpz_init(P2);
+
+	if ( ! spill_in(Q, &sq) ) ok= 0;
+	mpz_mul(Q, Q, Q2);
+	mpz_clear(Q2);
+	mpz_init(Q2);
+
+	return ok;
+}
+
+static int check_part (mpz_t *part, uint64_t digits, uint64_t *a,
+	uint64_t *b)
+{
+	int i;
+
+	for (i= PI_PART_DIGITS; i<= PI_PART_B; ++i)
+		if ( ! mpz_fits_ulong_p(part[i]) ) return 0;
+
+	if ( mpz_get_ui(part[PI_PART_DIGITS]) != digits ) return 0;
+
+	*a= mpz_get_ui(part[PI_PART_A]);
+	*b= mpz_get_ui(part[PI_PART_B]);
+
+	return ( *a <= *b && *b <= pi_terms(digits+1) );
+}
@@ -0,0 +1,208 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include "enclave.h"
+#include "serialize.h"
+
+/*
+ * Prime generation. Each candidate window starts at a random odd
+ * number of the requested size, and is sieved by the odd primes below
+ * SIEVE_LIMIT before any probable-prime tests are run. Windows are
+ * handed out to the job threads independently, and each window
+ * contributes at most one prime so that the results aren't clustered.
+ */
+
+#define SIEVE_LIMIT	65536
+#define SIEVE_NPRIMES	6542	/* Primes below SIEVE_LIMIT */
+#define SIEVE_WINDOW	4096	/* Odd candidates per window */
+
+/* Candidates must be larger than every sieving prime */
+
+#define PRIME_MIN_BITS	17
+#define PRIME_MAX_BITS	65536
+#define PRIME_MAX_COUNT	65536
+
+static unsigned long small_primes[SIEVE_NPRIMES];
+static size_t n_small_primes= 0;
+
+struct prime_job {
+	mp_bitcnt_t bits;
+	size_t count;
+	int reps;
+	mpz_t *primes;
+	volatile size_t found;
+	volatile int error;
+};
+
+static struct prime_job pj;
+
+static int init_small_primes ();
+static void prime_work (void *arg, int tid);
+static size_t prime_finish (void *arg);
+
+static int init_small_primes ()
+{
+	unsigned char *composite;
+	unsigned long i, j;
+
+	if ( n_small_primes ) return 1;
+
+	composite= calloc(SIEVE_LIMIT, 1);
+	if ( composite == NULL ) return 0;
+
+	for (i= 2; i< SIEVE_LIMIT; ++i) {
+		if ( composite[i] ) continue;
+
+		small_primes[n_small_primes++]= i;
+		for (j= i*i; j< SIEVE_LIMIT; j+= i) composite[j]= 1;
+	}
+
+	free(composite);
+
+	return 1;
+}
+
+int e_prime_gen (uint32_t bits, uint32_t count, int reps)
+{
+	size_t i;
+
+	if ( bits < PRIME_MIN_BITS || bits > PRIME_MAX_BITS ) return 0;
+	if ( count == 0 || count > PRIME_MAX_COUNT ) return 0;
+	if ( reps < 1 ) return 0;
+
+	if ( ! init_small_primes() ) return 0;
+
+	/* pj belongs to the running job, if there is one, until this */
+
+	if ( ! job_reserve() ) return 0;
+
+	pj.primes= malloc(count*sizeof(mpz_t));
+	if ( pj.primes == NULL ) {
+		job_cancel();
+		return 0;
+	}
+
+	for (i= 0; i< count; ++i) mpz_init2(pj.primes[i], bits);
+
+	pj.bits= bits;
+	pj.count= count;
+	pj.reps= reps;
+	pj.found= 0;
+	pj.error= 0;
+
+	job_publish(prime_work, prime_finish, &pj);
+
+	return 1;
+}
+
+static void prime_work (void *arg, int tid)
+{
+	struct prime_job *job= (struct prime_job *) arg;
+	gmp_randstate_t *rs;
+	unsigned char *sieve;
+	mpz_t base, cand;
+	size_t i, j;
+
+	rs= enclave_randstate(tid);
+	sieve= malloc(SIEVE_WINDOW);
+	if ( rs == NULL || sieve == NULL ) {
+		job->error= 1;
+		free(sieve);
+		return;
+	}
+
+	mpz_inits(base, cand, NULL);
+
+	while ( job->found < job->count && ! job->error ) {
+		/* A random, odd, full-sized starting point */
+
+		mpz_urandomb(base, *rs, job->bits);
+		mpz_setbit(base, job->bits-1);
+		mpz_setbit(base, 0);
+
+		/*
+		 * Mark every j where base+2j is divisible by a small prime.
+		 * That's j = -r/2 mod p, with r = base mod p.
+		 */
+
+		memset(sieve, 0, SIEVE_WINDOW);
+		for (i= 1; i< n_small_primes; ++i) {
+			unsigned long p= small_primes[i];
+			unsigned long t= mpz_fdiv_ui(base, p);
+
+			t= ( t == 0 ) ? 0 : p-t;
+			j= ( t & 1 ) ? (t+p)/2 : t/2;
+
+			for (; j< SIEVE_WINDOW; j+= p) sieve[j]= 1;
+		}
+
+		for (j= 0; j< SIEVE_WINDOW; ++j) {
+			if ( sieve[j] ) continue;
+
+			mpz_add_ui(cand, base, 2*j);
+			if ( mpz_sizeinbase(cand, 2) != job->bits ) break;
+
+			if ( mpz_probab_prime_p(cand, job->reps) ) {
+				size_t slot= __sync_fetch_and_add(&job->found, 1);
+
+				if ( slot < job->count ) mpz_set(job->primes[slot], cand);
+				break;
+			}
+
+			if ( job->found >= job->count ) break;
+		}
+	}
+
+	mpz_clears(base, cand, NULL);
+	free(sieve);
+}
+
+static size_t prime_finish (void *arg)
+{
+	struct prime_job *job= (struct prime_job *) arg;
+	unsigned char *buf= NULL;
+	size_t i, len= 0;
+
+	if ( ! job->error && job->found >= job->count )
+		buf= mpz_batch_serialize(job->primes, job->count, &len);
+
+	for (i= 0; i< job->count; ++i) mpz_clear(job->primes[i]);
+	free(job->primes);
+	job->primes= NULL;
+
+	if ( buf == NULL ) return 0;
+
+	return result_set((char *) buf, len);
+}
@@ -0,0 +1,96 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <stdint.h>
+#include "enclave.h"
+
+/*
+ * Stack high-water mark for sizing StackMaxSize. The stack below this
+ * ECALL's frame is painted with a pattern, one of the bench operations
+ * runs, and the deepest word that no longer holds the pattern shows
+ * how much stack the operation used. The paint and the scan are done
+ * by separate functions called from the same frame, so they cover the
+ * same addresses, starting far enough below the frame to miss their
+ * own locals.
+ *
+ * depth must leave room below it within the enclave's StackMaxSize.
+ */
+
+#define STACK_PAINT	0x5a5aa5a55a5aa5a5ULL
+#define STACK_SKIP	512
+
+static void __attribute__((noinline)) stack_paint (char *frame,
+	size_t depth);
+static size_t __attribute__((noinline)) stack_scan (char *frame,
+	size_t depth);
+
+size_t e_stack_probe (size_t depth, int op, char *str_a, char *str_b,
+	int digits, uint64_t *used)
+{
+	char *frame= __builtin_frame_address(0);
+	uint64_t ns[4];
+	size_t len;
+
+	if ( used == NULL || depth <= STACK_SKIP ) return 0;
+
+	stack_paint(frame, depth);
+	len= e_bench_op(op, str_a, str_b, digits, ns);
+	*used= stack_scan(frame, depth);
+
+	return len;
+}
+
+static void stack_paint (char *frame, size_t depth)
+{
+	volatile uint64_t *top, *p;
+
+	top= (volatile uint64_t *) (((uintptr_t) frame-STACK_SKIP) & ~7);
+
+	for (p= top-(depth-STACK_SKIP)/8; p< top; ++p) *p= STACK_PAINT;
+}
+
+/*
+ * Returns the bytes used below frame. A result of depth means the
+ * operation went at least that deep.
+ */
+
+static size_t stack_scan (char *frame, size_t depth)
+{
+	volatile uint64_t *top, *p;
+
+	top= (volatile uint64_t *) (((uintptr_t) frame-STACK_SKIP) & ~7);
+
+	for (p= top-(depth-STACK_SKIP)/8; p< top; ++p)
+		if ( *p != STACK_PAINT ) break;
+
+	return (size_t) (frame-(char *) p);
+}
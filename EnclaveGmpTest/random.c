@@ -0,0 +1,294 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include <sgx_trts.h>
+#include <stdlib.h>
+#include <string.h>
+#include "enclave.h"
+#include "serialize.h"
+
+#define RAND_SEED_LEN 32
+
+#define RAND_MAX_BITS	65536
+#define RAND_MAX_COUNT	(1<<20)
+#define RAND_CHUNK	64	/* Values claimed by a thread at a time */
+
+/*
+ * Each job thread gets its own state so they never contend. States are
+ * seeded once from the hardware RNG and then reused across calls.
+ * Code that isn't running as part of a job uses thread id 0.
+ */
+
+static gmp_randstate_t rstate[JOB_MAX_THREADS];
+static int rstate_seeded[JOB_MAX_THREADS];
+
+gmp_randstate_t *enclave_randstate (int tid)
+{
+	unsigned char seed[RAND_SEED_LEN];
+	mpz_t s;
+
+	if ( tid < 0 || tid >= JOB_MAX_THREADS ) return NULL;
+
+	if ( rstate_seeded[tid] ) return &rstate[tid];
+
+	if ( sgx_read_rand(seed, RAND_SEED_LEN) != SGX_SUCCESS ) return NULL;
+
+	mpz_init(s);
+	mpz_import(s, RAND_SEED_LEN, 1, 1, 1, 0, seed);
+	memset(seed, 0, RAND_SEED_LEN);
+
+	gmp_randinit_default(rstate[tid]);
+	gmp_randseed(rstate[tid], s);
+	mpz_clear(s);
+
+	rstate_seeded[tid]= 1;
+
+	return &rstate[tid];
+}
+
+/*
+ * Random integers in bulk, for nonces, blinding factors and test
+ * vectors. The values are uniform in [0, 2^bits), or in [0, bound) if
+ * buf is a batch holding one positive bound (and bits is 0).
+ *
+ * Every record has the same width, the size of the largest possible
+ * value, with leading zero bytes as needed. That way each value has a
+ * fixed place in the result, and the job threads write their values
+ * straight into the output batch, claiming RAND_CHUNK at a time,
+ * instead of building an array of integers to serialize at the end.
+ *
+ * By default the values are drawn from sgx_read_rand(), so they are
+ * safe to use as secrets. Bounded values are made by rejection,
+ * drawing from the bound's bit length until one is below it. With
+ * fast set, they come from each thread's GMP random state instead,
+ * which is much quicker but is not a cryptographic generator: anyone
+ * who sees enough of its output can predict the rest, so it's only
+ * for values that needn't be secret, like test vectors.
+ */
+
+struct rand_job {
+	mpz_t bound;		/* 0 for a bit size */
+	mp_bitcnt_t bits;
+	size_t width;		/* Bytes per value */
+	size_t count;
+	int fast;
+	unsigned char *buf;
+	size_t len;
+	volatile size_t next;
+	volatile int error;
+};
+
+static struct rand_job rj;
+
+static void rand_work (void *arg, int tid);
+static size_t rand_finish (void *arg);
+static int rand_secure (unsigned char *p, struct rand_job *job, mpz_t x);
+static void put_value (unsigned char *p, size_t width, mpz_t x);
+
+int e_rand_gen (unsigned char *buf, size_t len, uint32_t bits,
+	uint32_t count, int fast)
+{
+	void *(*alloc_func)(size_t);
+	mp_bitcnt_t nbits;
+	size_t reclen;
+	mpz_t bound;
+
+	if ( count == 0 || count > RAND_MAX_COUNT ) return 0;
+
+	mpz_init(bound);
+
+	if ( len ) {
+		if ( bits != 0 ||
+			mpz_batch_deserialize(&bound, 1, buf, len) == -1 ||
+			mpz_sgn(bound) <= 0 ||
+			mpz_sizeinbase(bound, 2) > RAND_MAX_BITS ) goto error;
+
+		/* Values are below the bound, so bits is that of bound-1 */
+
+		mpz_sub_ui(bound, bound, 1);
+		nbits= ( mpz_sgn(bound) ) ? mpz_sizeinbase(bound, 2) : 0;
+		mpz_add_ui(bound, bound, 1);
+	} else {
+		if ( bits == 0 || bits > RAND_MAX_BITS ) goto error;
+		nbits= bits;
+	}
+
+	/* rj belongs to the running job, if there is one, until this */
+
+	if ( ! job_reserve() ) goto error;
+
+	mpz_init(rj.bound);
+	mpz_swap(rj.bound, bound);
+	rj.bits= nbits;
+	rj.width= (rj.bits+7)/8;
+	rj.count= count;
+	rj.fast= fast;
+	rj.next= 0;
+	rj.error= 0;
+
+	reclen= BATCH_REC_LEN+rj.width;
+	rj.len= BATCH_HDR_LEN+count*reclen;
+
+	/* e_get_result() frees this with the GMP allocator */
+
+	mp_get_memory_functions(&alloc_func, NULL, NULL);
+	rj.buf= alloc_func(rj.len);
+	if ( rj.buf == NULL ) {
+		mpz_clear(rj.bound);
+		job_cancel();
+		goto error;
+	}
+
+	rj.buf[0]= count&0xff;
+	rj.buf[1]= (count>>8)&0xff;
+	rj.buf[2]= (count>>16)&0xff;
+	rj.buf[3]= (count>>24)&0xff;
+
+	job_publish(rand_work, rand_finish, &rj);
+
+	mpz_clear(bound);
+	return 1;
+
+error:
+	mpz_clear(bound);
+	return 0;
+}
+
+static void rand_work (void *arg, int tid)
+{
+	struct rand_job *job= (struct rand_job *) arg;
+	size_t reclen= BATCH_REC_LEN+job->width;
+	gmp_randstate_t *rs= NULL;
+	unsigned char *p;
+	size_t i, end;
+	mpz_t x;
+
+	if ( job->fast ) {
+		rs= enclave_randstate(tid);
+		if ( rs == NULL ) {
+			job->error= 1;
+			return;
+		}
+	}
+
+	mpz_init2(x, job->bits);
+
+	while ( ! job->error ) {
+		i= __sync_fetch_and_add(&job->next, RAND_CHUNK);
+		if ( i >= job->count ) break;
+
+		end= ( job->count-i > RAND_CHUNK ) ? i+RAND_CHUNK : job->count;
+		p= job->buf+BATCH_HDR_LEN+i*reclen;
+
+		for (; i< end; ++i, p+= reclen) {
+			p[0]= job->width&0xff;
+			p[1]= (job->width>>8)&0xff;
+			p[2]= (job->width>>16)&0xff;
+			p[3]= (job->width>>24)&0xff;
+			memset(p+4, 0, 4);
+
+			if ( job->fast ) {
+				if ( mpz_sgn(job->bound) )
+					mpz_urandomm(x, *rs, job->bound);
+				else mpz_urandomb(x, *rs, job->bits);
+
+				put_value(p+BATCH_REC_LEN, job->width, x);
+				continue;
+			}
+
+			if ( ! rand_secure(p+BATCH_REC_LEN, job, x) ) {
+				job->error= 1;
+				break;
+			}
+		}
+	}
+
+	mpz_clear(x);
+}
+
+static size_t rand_finish (void *arg)
+{
+	struct rand_job *job= (struct rand_job *) arg;
+	size_t len= 0;
+
+	mpz_clear(job->bound);
+
+	if ( job->error || job->next < job->count ) {
+		/* Don't hand out a buffer with values missing */
+
+		memset(job->buf, 0, job->len);
+		free_function(job->buf, job->len);
+	} else {
+		len= result_set((char *) job->buf, job->len);
+	}
+
+	job->buf= NULL;
+
+	return len;
+}
+
+/*
+ * Fill one value from the hardware RNG. The bytes go straight into
+ * place, with the top byte masked to the bit length; a bounded value
+ * is redrawn until it is below the bound, which takes fewer than two
+ * tries on average.
+ */
+
+static int rand_secure (unsigned char *p, struct rand_job *job, mpz_t x)
+{
+	unsigned char mask;
+
+	if ( job->width == 0 ) return 1;
+
+	mask= ( job->bits%8 ) ? (1<<(job->bits%8))-1 : 0xff;
+
+	for (;;) {
+		if ( sgx_read_rand(p, job->width) != SGX_SUCCESS ) return 0;
+		p[0]&= mask;
+
+		if ( mpz_sgn(job->bound) == 0 ) return 1;
+
+		mpz_import(x, job->width, 1, 1, 1, 0, p);
+		if ( mpz_cmp(x, job->bound) < 0 ) return 1;
+	}
+}
+
+/* Big-endian, padded with zeros on the left to width bytes */
+
+static void put_value (unsigned char *p, size_t width, mpz_t x)
+{
+	size_t n= ( mpz_sgn(x) ) ? (mpz_sizeinbase(x, 2)+7)/8 : 0;
+
+	memset(p, 0, width-n);
+	if ( n ) mpz_export(p+width-n, NULL, 1, 1, 1, 0, x);
+}
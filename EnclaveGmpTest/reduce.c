@@ -0,0 +1,226 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include <stdlib.h>
+#include "enclave.h"
+#include "serialize.h"
+
+/*
+ * Parallel sums and dot products. The vector is cut into equal slices
+ * which the job threads claim one at a time. Each slice, and then the
+ * slice totals, are reduced as a balanced binary tree so that the
+ * operands being added at each level are about the same size.
+ */
+
+#define REDUCE_SLICES_PER_THREAD 4
+
+struct reduce_job {
+	mpz_t *v;
+	mpz_t *w;		/* NULL for a sum */
+	size_t n;
+	mpz_t *partial;
+	size_t nslices;
+	volatile size_t next;
+};
+
+static struct reduce_job rj;
+
+static mpz_t *vec_load (unsigned char *buf, size_t len, size_t *n);
+static void vec_release (mpz_t *v, size_t n);
+static void tree_sum (mpz_t *v, size_t n);
+static int reduce_post (mpz_t *v, mpz_t *w, size_t n);
+static void reduce_work (void *arg, int tid);
+static size_t reduce_finish (void *arg);
+
+static mpz_t *vec_load (unsigned char *buf, size_t len, size_t *n)
+{
+	mpz_t *v;
+	size_t i;
+
+	if ( buf == NULL ) return NULL;
+
+	*n= mpz_batch_count(buf, len);
+	if ( *n == (size_t) -1 ) return NULL;
+
+	/* Always allocate at least one so an empty vector isn't an error. */
+
+	v= malloc((*n ? *n : 1)*sizeof(mpz_t));
+	if ( v == NULL ) return NULL;
+
+	for (i= 0; i< *n; ++i) mpz_init(v[i]);
+
+	if ( mpz_batch_deserialize(v, *n, buf, len) == -1 ) {
+		vec_release(v, *n);
+		return NULL;
+	}
+
+	return v;
+}
+
+static void vec_release (mpz_t *v, size_t n)
+{
+	size_t i;
+
+	if ( v == NULL ) return;
+
+	for (i= 0; i< n; ++i) mpz_clear(v[i]);
+	free(v);
+}
+
+/* Sum v[0..n-1] pairwise into v[0] */
+
+static void tree_sum (mpz_t *v, size_t n)
+{
+	size_t i, step;
+
+	for (step= 1; step< n; step*= 2)
+		for (i= 0; i+step< n; i+= 2*step) mpz_add(v[i], v[i], v[i+step]);
+}
+
+/*
+ * The input buffers only live as long as the ECALL, so the vectors are
+ * deserialized before the job is posted.
+ */
+
+int e_vec_sum (unsigned char *buf, size_t len)
+{
+	mpz_t *v;
+	size_t n;
+
+	v= vec_load(buf, len, &n);
+	if ( v == NULL ) return 0;
+
+	if ( ! reduce_post(v, NULL, n) ) {
+		vec_release(v, n);
+		return 0;
+	}
+
+	return 1;
+}
+
+int e_vec_dot (unsigned char *buf_a, size_t len_a, unsigned char *buf_b,
+	size_t len_b)
+{
+	mpz_t *v, *w;
+	size_t n, nw;
+
+	v= vec_load(buf_a, len_a, &n);
+	if ( v == NULL ) return 0;
+
+	w= vec_load(buf_b, len_b, &nw);
+	if ( w == NULL || nw != n ) {
+		vec_release(v, n);
+		vec_release(w, nw);
+		return 0;
+	}
+
+	if ( ! reduce_post(v, w, n) ) {
+		vec_release(v, n);
+		vec_release(w, nw);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int reduce_post (mpz_t *v, mpz_t *w, size_t n)
+{
+	size_t i, nslices;
+
+	nslices= JOB_MAX_THREADS*REDUCE_SLICES_PER_THREAD;
+	if ( nslices > n ) nslices= n;
+	if ( nslices == 0 ) nslices= 1;
+
+	/* rj belongs to the running job, if there is one, until this */
+
+	if ( ! job_reserve() ) return 0;
+
+	rj.partial= malloc(nslices*sizeof(mpz_t));
+	if ( rj.partial == NULL ) {
+		job_cancel();
+		return 0;
+	}
+
+	for (i= 0; i< nslices; ++i) mpz_init(rj.partial[i]);
+
+	rj.v= v;
+	rj.w= w;
+	rj.n= n;
+	rj.nslices= nslices;
+	rj.next= 0;
+
+	job_publish(reduce_work, reduce_finish, &rj);
+
+	return 1;
+}
+
+static void reduce_work (void *arg, int tid)
+{
+	struct reduce_job *job= (struct reduce_job *) arg;
+	size_t s;
+
+	while ( (s= __sync_fetch_and_add(&job->next, 1)) < job->nslices ) {
+		size_t i, lo, hi;
+
+		lo= s*job->n/job->nslices;
+		hi= (s+1)*job->n/job->nslices;
+		if ( hi == lo ) continue;
+
+		if ( job->w != NULL )
+			for (i= lo; i< hi; ++i) mpz_mul(job->v[i], job->v[i], job->w[i]);
+
+		tree_sum(&job->v[lo], hi-lo);
+		mpz_swap(job->partial[s], job->v[lo]);
+	}
+}
+
+static size_t reduce_finish (void *arg)
+{
+	struct reduce_job *job= (struct reduce_job *) arg;
+	unsigned char *out;
+	size_t i, olen= 0;
+
+	tree_sum(job->partial, job->nslices);
+
+	out= mpz_batch_serialize(job->partial, 1, &olen);
+
+	for (i= 0; i< job->nslices; ++i) mpz_clear(job->partial[i]);
+	free(job->partial);
+	vec_release(job->v, job->n);
+	vec_release(job->w, job->n);
+	job->v= job->w= job->partial= NULL;
+
+	if ( out == NULL ) return 0;
+
+	return result_set((char *) out, olen);
+}
@@ -0,0 +1,413 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include <stdlib.h>
+#include "enclave.h"
+
+/*
+ * Scratch pools. Each thread in the enclave borrows a pool for the
+ * length of its ECALL and takes its temporaries from it, instead of
+ * initializing fresh ones that have to grow their limbs from nothing.
+ * The temporaries keep their limbs when they are handed back, so the
+ * next call of the same size doesn't allocate at all.
+ *
+ * A thread only knows which pool it holds while it holds it, so this
+ * works whatever the TCS policy does to thread-local storage between
+ * ECALLs. There are more pools than threads can enter the enclave, and
+ * a thread that finds them all busy waits for one; nothing waits while
+ * holding a pool, so that can't deadlock.
+ *
+ * What a pool keeps is capped at SCRATCH_MAX_BYTES, checked whenever
+ * it is handed back. If an allocation fails, scratch_trim() empties
+ * every pool it can, and the rest are emptied as they are handed back.
+ */
+
+#ifndef SCRATCH_MAX_BYTES
+#define SCRATCH_MAX_BYTES	(512*1024)
+#endif
+
+#define SCRATCH_POOLS	(2*JOB_MAX_THREADS)
+#define SCRATCH_DEPTH	8
+
+/* The limbs behind a float of precision p, as mpf_get_prec() gives it */
+
+#define MPF_BYTES(p)	(((p)/GMP_NUMB_BITS+2)*sizeof(mp_limb_t))
+
+struct scratch {
+	volatile int busy;
+	int ready;
+	int depth;
+	int fitting;
+	int nz, nf;	/* Temporaries in use */
+	int vec_used;
+	int mark_nz[SCRATCH_DEPTH], mark_nf[SCRATCH_DEPTH];
+	int mark_vec[SCRATCH_DEPTH];
+	unsigned gen;	/* scratch_gen when last emptied */
+	size_t bytes, blocks;	/* What's kept, as last counted */
+	mpz_t z[SCRATCH_MPZ];
+	size_t zlimbs[SCRATCH_MPZ];	/* Most limbs each has held */
+	mpf_t f[SCRATCH_MPF];
+	mp_bitcnt_t prec[SCRATCH_MPF];	/* Precision each was grown to */
+	mp_bitcnt_t prec0;	/* ... and what a fresh one has */
+	mpz_t *vec;
+	size_t nvec;
+	size_t vec_limbs, vec_blocks;	/* Most the vector has held */
+};
+
+static struct scratch pools[SCRATCH_POOLS];
+static volatile unsigned scratch_gen= 0;
+
+/* The pool this thread holds, if any */
+
+static __thread struct scratch *mine= NULL;
+
+static struct scratch *scratch_claim ();
+static void scratch_fit (struct scratch *p, size_t max);
+static void scratch_tally (struct scratch *p);
+static void scratch_count (struct scratch *p);
+
+/*
+ * Start using temporaries. Everything taken after this is handed back
+ * by the matching scratch_close(), and the calls can nest.
+ */
+
+void scratch_open ()
+{
+	struct scratch *p= mine;
+
+	if ( p == NULL ) p= mine= scratch_claim();
+	if ( p->depth == SCRATCH_DEPTH ) abort();
+
+	p->mark_nz[p->depth]= p->nz;
+	p->mark_nf[p->depth]= p->nf;
+	p->mark_vec[p->depth]= p->vec_used;
+	++p->depth;
+}
+
+void scratch_close ()
+{
+	struct scratch *p= mine;
+	int j;
+
+	if ( p == NULL || p->depth == 0 ) abort();
+
+	--p->depth;
+	p->nz= p->mark_nz[p->depth];
+
+	/* Floats go back to the precision they were allocated at. */
+
+	for (j= p->mark_nf[p->depth]; j< p->nf; ++j)
+		mpf_set_prec_raw(p->f[j], p->prec[j]);
+	p->nf= p->mark_nf[p->depth];
+	p->vec_used= p->mark_vec[p->depth];
+
+	if ( p->depth ) return;
+
+	/* Keep what fits, and hand the pool back. */
+
+	scratch_fit(p, ( p->gen == scratch_gen ) ? SCRATCH_MAX_BYTES : 0);
+
+	mine= NULL;
+	__sync_lock_release(&p->busy);
+}
+
+/*
+ * An integer, set to zero. Taking more than SCRATCH_MPZ at once is a
+ * bug.
+ */
+
+mpz_t *scratch_mpz ()
+{
+	struct scratch *p= mine;
+	mpz_t *z;
+
+	if ( p == NULL || p->nz == SCRATCH_MPZ ) abort();
+
+	z= &p->z[p->nz++];
+	mpz_set_ui(*z, 0);
+
+	return z;
+}
+
+/*
+ * A float of the given precision, set to zero. A float that was grown
+ * to a higher precision is used at this one without reallocating.
+ */
+
+mpf_t *scratch_mpf (mp_bitcnt_t precision)
+{
+	struct scratch *p= mine;
+	mpf_t *f;
+	int i;
+
+	if ( p == NULL || p->nf == SCRATCH_MPF ) abort();
+
+	/* Counted as in use before it grows, so a trim leaves it alone. */
+
+	i= p->nf++;
+	f= &p->f[i];
+
+	if ( p->prec[i] < precision ) {
+		mpf_set_prec(*f, precision);
+		p->prec[i]= mpf_get_prec(*f);
+	}
+	mpf_set_prec_raw(*f, precision);
+	mpf_set_ui(*f, 0);
+
+	return f;
+}
+
+/*
+ * An array of n integers, for a batch. There is one per pool, so it
+ * can't be taken twice at once. The values are left as they were.
+ */
+
+mpz_t *scratch_mpz_vec (size_t n)
+{
+	struct scratch *p= mine;
+	mpz_t *vec;
+	size_t i;
+
+	if ( p == NULL || p->vec_used ) abort();
+
+	p->vec_used= 1;
+
+	if ( n > p->nvec ) {
+		vec= allocate_function(n*sizeof(mpz_t));
+		if ( vec == NULL ) {
+			p->vec_used= 0;
+			return NULL;
+		}
+
+		for (i= 0; i< n; ++i) mpz_init(vec[i]);
+		for (i= 0; i< p->nvec; ++i) {
+			mpz_swap(vec[i], p->vec[i]);
+			mpz_clear(p->vec[i]);
+		}
+
+		if ( p->vec != NULL ) free_function(p->vec, p->nvec*sizeof(mpz_t));
+		p->vec= vec;
+		p->nvec= n;
+	}
+
+	return p->vec;
+}
+
+/*
+ * Called when an allocation fails. Empty this thread's idle
+ * temporaries and every pool that isn't in use, and have the others
+ * emptied when they are handed back. Returns nonzero if anything was
+ * freed, so that the allocation is worth retrying.
+ */
+
+int scratch_trim ()
+{
+	size_t before= 0, after= 0;
+	int i;
+
+	__sync_fetch_and_add(&scratch_gen, 1);
+
+	for (i= 0; i< SCRATCH_POOLS; ++i) {
+		struct scratch *p= &pools[i];
+
+		if ( p == mine ) {
+			if ( p->fitting ) continue;
+			scratch_count(p);
+			before+= p->bytes;
+			scratch_fit(p, 0);
+			after+= p->bytes;
+		} else if ( ! __sync_lock_test_and_set(&p->busy, 1) ) {
+			before+= p->bytes;
+			if ( p->ready ) scratch_fit(p, 0);
+			after+= p->bytes;
+			__sync_lock_release(&p->busy);
+		}
+	}
+
+	return ( after < before );
+}
+
+static struct scratch *scratch_claim ()
+{
+	struct scratch *p;
+	int i;
+
+	for (;;) {
+		for (i= 0; i< SCRATCH_POOLS; ++i) {
+			p= &pools[i];
+			if ( ! __atomic_load_n(&p->busy, __ATOMIC_RELAXED) &&
+				! __sync_lock_test_and_set(&p->busy, 1) )
+			{
+				goto claimed;
+			}
+		}
+		__asm__ __volatile__ ("pause");
+	}
+
+claimed:
+	if ( ! p->ready ) {
+		for (i= 0; i< SCRATCH_MPZ; ++i) {
+			mpz_init(p->z[i]);
+			p->zlimbs[i]= 0;
+		}
+		for (i= 0; i< SCRATCH_MPF; ++i) mpf_init2(p->f[i], 1);
+		p->prec0= mpf_get_prec(p->f[0]);
+		for (i= 0; i< SCRATCH_MPF; ++i) p->prec[i]= p->prec0;
+		p->gen= scratch_gen;
+		p->ready= 1;
+		scratch_count(p);
+	}
+
+	return p;
+}
+
+/*
+ * Shrink the idle temporaries, biggest first, until the pool keeps no
+ * more than max bytes or they are all back to their initial size. They
+ * are reinitialized rather than freed, since they stay in the pool.
+ */
+
+static void scratch_fit (struct scratch *p, size_t max)
+{
+	size_t i;
+
+	p->fitting= 1;
+	scratch_tally(p);
+	scratch_count(p);
+
+	if ( p->bytes > max && ! p->vec_used && p->vec != NULL ) {
+		for (i= 0; i< p->nvec; ++i) mpz_clear(p->vec[i]);
+		free_function(p->vec, p->nvec*sizeof(mpz_t));
+		p->vec= NULL;
+		p->nvec= 0;
+		p->vec_limbs= p->vec_blocks= 0;
+		scratch_count(p);
+	}
+
+	while ( p->bytes > max ) {
+		size_t sz, big= 0;
+		int j, which= -1;
+
+		for (j= p->nz; j< SCRATCH_MPZ; ++j) {
+			sz= p->zlimbs[j]*sizeof(mp_limb_t);
+			if ( sz > big ) {
+				big= sz;
+				which= j;
+			}
+		}
+		for (j= p->nf; j< SCRATCH_MPF; ++j) {
+			sz= MPF_BYTES(p->prec[j]);
+			if ( p->prec[j] > p->prec0 && sz > big ) {
+				big= sz;
+				which= SCRATCH_MPZ+j;
+			}
+		}
+
+		if ( which == -1 ) break;
+
+		if ( which < SCRATCH_MPZ ) {
+			mpz_clear(p->z[which]);
+			mpz_init(p->z[which]);
+			p->zlimbs[which]= 0;
+		} else {
+			j= which-SCRATCH_MPZ;
+			mpf_clear(p->f[j]);
+			mpf_init2(p->f[j], 1);
+			p->prec[j]= p->prec0;
+		}
+
+		scratch_count(p);
+	}
+
+	if ( max == 0 ) p->gen= scratch_gen;
+	p->fitting= 0;
+}
+
+/*
+ * GMP grows an integer to hold its value and doesn't shrink it, so the
+ * most limbs an idle one has held when its pool was handed back stands
+ * for what it keeps. The vector is tallied as a whole.
+ */
+
+static void scratch_tally (struct scratch *p)
+{
+	size_t limbs= 0, blocks= 0, i;
+	int j;
+
+	for (j= p->nz; j< SCRATCH_MPZ; ++j) {
+		if ( mpz_size(p->z[j]) > p->zlimbs[j] )
+			p->zlimbs[j]= mpz_size(p->z[j]);
+	}
+
+	if ( p->vec_used || p->vec == NULL ) return;
+
+	for (i= 0; i< p->nvec; ++i) {
+		if ( mpz_size(p->vec[i]) == 0 ) continue;
+		limbs+= mpz_size(p->vec[i]);
+		++blocks;
+	}
+	if ( limbs > p->vec_limbs ) p->vec_limbs= limbs;
+	if ( blocks > p->vec_blocks ) p->vec_blocks= blocks;
+}
+
+/*
+ * Count what the pool keeps, and pass the change on to the heap
+ * accounting. Floats are counted at the precision they were grown to.
+ */
+
+static void scratch_count (struct scratch *p)
+{
+	size_t bytes= 0, blocks= 0;
+	int j;
+
+	for (j= 0; j< SCRATCH_MPZ; ++j) {
+		if ( p->zlimbs[j] == 0 ) continue;
+		bytes+= p->zlimbs[j]*sizeof(mp_limb_t);
+		++blocks;
+	}
+
+	for (j= 0; j< SCRATCH_MPF; ++j) {
+		bytes+= MPF_BYTES(p->prec[j]);
+		++blocks;
+	}
+
+	if ( p->vec != NULL ) {
+		bytes+= p->nvec*sizeof(mpz_t)+p->vec_limbs*sizeof(mp_limb_t);
+		blocks+= 1+p->vec_blocks;
+	}
+
+	heap_note_kept((int64_t) (bytes-p->bytes),
+		(int64_t) (blocks-p->blocks));
+	p->bytes= bytes;
+	p->blocks= blocks;
+}
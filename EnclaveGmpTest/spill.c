@@ -0,0 +1,261 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <sgx_tgmp.h>
+#include <sgx_trts.h>
+#include <sgx_tcrypto.h>
+#include <stdint.h>
+#include <string.h>
+#include "enclave.h"
+#include "ecall_stats.h"
+
+/*
+ * Spilling large integers to untrusted memory. A product tree holds
+ * big intermediates that it won't touch again for a long time, and
+ * rather than leave them to EPC paging, which is slow and can't be
+ * steered, we move them out ourselves and bring them back when they're
+ * needed.
+ *
+ * The limbs are encrypted with AES-GCM under a key made when the
+ * enclave first spills. The IV is a counter, so no two blobs share
+ * one, and the enclave keeps the IV, the size and sign, and the MAC
+ * in a struct spill. The size and sign are authenticated along with
+ * the limbs, so the host can't change, swap or replay a blob without
+ * the reload failing.
+ *
+ * The host keeps the blobs through OCALLs (see ocalls.c), in memory,
+ * or in files if it is told to. Encryption writes straight into the
+ * host's buffer. Reloading copies the blob into the integer first and
+ * decrypts it in place, so that what is authenticated is what's used
+ * even if the host changes its copy meanwhile.
+ */
+
+#define SPILL_IV_SIZE	12
+
+static struct spill_stats spill;
+static sgx_aes_gcm_128bit_key_t spill_key;
+static volatile int key_init= 0;
+static volatile uint64_t spill_seq= 0;
+
+static int spill_key_init ();
+static void spill_iv (uint8_t *iv, uint64_t seq);
+static void spill_grow (uint64_t bytes);
+
+/* Spill integers of at least min_bytes; 0 turns spilling off */
+
+uint64_t e_spill_config (uint64_t min_bytes)
+{
+	return __atomic_exchange_n(&spill.min_bytes, min_bytes,
+		__ATOMIC_RELAXED);
+}
+
+/* Like e_heap_stats() */
+
+size_t e_spill_stats (unsigned char *buf, size_t len, int reset)
+{
+	uint64_t live;
+
+	if ( buf == NULL || len < sizeof(spill) ) return sizeof(spill);
+
+	memcpy(buf, &spill, sizeof(spill));
+
+	if ( reset ) {
+		__atomic_store_n(&spill.spills, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&spill.reloads, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&spill.spill_bytes, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&spill.reload_bytes, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&spill.failures, 0, __ATOMIC_RELAXED);
+		live= __atomic_load_n(&spill.live_bytes, __ATOMIC_RELAXED);
+		__atomic_store_n(&spill.peak_bytes, live, __ATOMIC_RELAXED);
+	}
+
+	return sizeof(spill);
+}
+
+/*
+ * Moves x out of the enclave if spilling is on and x is big enough,
+ * leaving it 0 with its limbs freed. Returns 1 if it did. Either way,
+ * spill_in() must be called on s before x is used again.
+ */
+
+int spill_out (mpz_t x, struct spill *s)
+{
+	struct { uint64_t size, negative; } aad;
+	uint8_t iv[SPILL_IV_SIZE];
+	uint64_t handle, min;
+	size_t bytes;
+	void *buf;
+
+	s->handle= 0;
+
+	min= __atomic_load_n(&spill.min_bytes, __ATOMIC_RELAXED);
+	bytes= mpz_size(x)*sizeof(mp_limb_t);
+	if ( min == 0 || bytes < min || bytes > UINT32_MAX ) return 0;
+
+	if ( ! spill_key_init() ) return 0;
+
+	if ( ocall_spill_alloc(&handle, bytes) != SGX_SUCCESS || handle == 0 )
+		return 0;
+
+	if ( ocall_spill_map(&buf, handle) != SGX_SUCCESS || buf == NULL ||
+		! sgx_is_outside_enclave(buf, bytes) )
+	{
+		ocall_spill_free(handle);
+		return 0;
+	}
+
+	s->seq= __sync_add_and_fetch(&spill_seq, 1);
+	s->size= mpz_size(x);
+	s->negative= ( mpz_sgn(x) < 0 );
+
+	aad.size= s->size;
+	aad.negative= s->negative;
+	spill_iv(iv, s->seq);
+
+	if ( sgx_rijndael128GCM_encrypt(&spill_key,
+		(const uint8_t *) mpz_limbs_read(x), (uint32_t) bytes,
+		(uint8_t *) buf, iv, SPILL_IV_SIZE, (const uint8_t *) &aad,
+		sizeof(aad), (sgx_aes_gcm_128bit_tag_t *) s->mac) != SGX_SUCCESS )
+	{
+		ocall_spill_free(handle);
+		return 0;
+	}
+
+	/* The host may now move the blob out of memory */
+
+	ocall_spill_unmap(handle);
+
+	s->handle= handle;
+
+	mpz_clear(x);
+	mpz_init(x);
+
+	__sync_fetch_and_add(&spill.spills, 1);
+	__sync_fetch_and_add(&spill.spill_bytes, bytes);
+	spill_grow(bytes);
+
+	return 1;
+}
+
+/*
+ * Brings x back. Returns 0 if the blob can't be had or doesn't
+ * authenticate, in which case x is 0. The blob is released either way.
+ */
+
+int spill_in (mpz_t x, struct spill *s)
+{
+	struct { uint64_t size, negative; } aad;
+	uint8_t iv[SPILL_IV_SIZE];
+	size_t bytes;
+	mp_limb_t *limbs;
+	void *buf;
+	int ok= 0;
+
+	if ( s->handle == 0 ) return 1;
+
+	bytes= s->size*sizeof(mp_limb_t);
+
+	if ( ocall_spill_map(&buf, s->handle) != SGX_SUCCESS || buf == NULL ||
+		! sgx_is_outside_enclave(buf, bytes) ) goto done;
+
+	limbs= mpz_limbs_write(x, s->size);
+	memcpy(limbs, buf, bytes);
+
+	aad.size= s->size;
+	aad.negative= s->negative;
+	spill_iv(iv, s->seq);
+
+	if ( sgx_rijndael128GCM_decrypt(&spill_key, (const uint8_t *) limbs,
+		(uint32_t) bytes, (uint8_t *) limbs, iv, SPILL_IV_SIZE,
+		(const uint8_t *) &aad, sizeof(aad),
+		(const sgx_aes_gcm_128bit_tag_t *) s->mac) != SGX_SUCCESS )
+	{
+		mpz_set_ui(x, 0);
+		goto done;
+	}
+
+	mpz_limbs_finish(x, ( s->negative ) ? -(mp_size_t) s->size :
+		(mp_size_t) s->size);
+	ok= 1;
+
+	__sync_fetch_and_add(&spill.reloads, 1);
+	__sync_fetch_and_add(&spill.reload_bytes, bytes);
+
+done:
+	ocall_spill_free(s->handle);
+	s->handle= 0;
+
+	__sync_fetch_and_sub(&spill.live_bytes, bytes);
+	if ( ! ok ) __sync_fetch_and_add(&spill.failures, 1);
+
+	return ok;
+}
+
+static int spill_key_init ()
+{
+	if ( key_init == 2 ) return 1;
+
+	if ( __sync_bool_compare_and_swap(&key_init, 0, 1) ) {
+		if ( sgx_read_rand((unsigned char *) spill_key,
+			sizeof(spill_key)) != SGX_SUCCESS )
+		{
+			key_init= 0;
+			return 0;
+		}
+
+		__sync_synchronize();
+		key_init= 2;
+	} else {
+		while ( key_init == 1 ) __asm__ __volatile__ ("pause");
+	}
+
+	return ( key_init == 2 );
+}
+
+static void spill_iv (uint8_t *iv, uint64_t seq)
+{
+	memset(iv, 0, SPILL_IV_SIZE);
+	memcpy(iv, &seq, sizeof(seq));
+}
+
+static void spill_grow (uint64_t bytes)
+{
+	uint64_t live, peak;
+
+	live= __sync_add_and_fetch(&spill.live_bytes, bytes);
+	peak= spill.peak_bytes;
+	while ( live > peak &&
+		! __sync_bool_compare_and_swap(&spill.peak_bytes, peak, live) )
+	{
+		peak= spill.peak_bytes;
+	}
+}
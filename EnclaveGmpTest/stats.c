@@ -0,0 +1,173 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "EnclaveGmpTest_t.h"
+#include <string.h>
+#include "enclave.h"
+#include "ecall_stats.h"
+
+/*
+ * Each thread that enters the enclave claims a row of counters the
+ * first time it records a call, and after that is the only writer of
+ * that row, so recording needs no locks or atomics. e_get_stats()
+ * adds the rows together as it copies them out. A read that races
+ * with a writer can be off by the call in progress, which is fine for
+ * monitoring.
+ *
+ * Enclave threads are bound to a TCS, so there can't be more of them
+ * than TCSNum. The native build has no such limit, and calls made by
+ * threads beyond STATS_MAX_THREADS aren't counted.
+ */
+
+#define STATS_MAX_THREADS JOB_MAX_THREADS
+
+static struct ecall_stats stats[STATS_MAX_THREADS][STATS_NECALLS];
+static volatile int stats_level= STATS_OFF;
+static volatile int stats_nslots= 0;
+
+/* Row number plus one, so that zero means none yet */
+
+static __thread int stats_slot= 0;
+
+static inline int stats_bucket (uint64_t v, int nbuckets);
+
+int e_stats_enable (int level)
+{
+	int old= stats_level;
+
+	if ( level < STATS_OFF || level > STATS_TIME ) return -1;
+
+	stats_level= level;
+
+	return old;
+}
+
+/*
+ * Copy the counters for one thread, or the sum over all threads, into
+ * buf and return the number of bytes needed. Nothing is copied if buf
+ * is too small. Setting reset zeroes the counters that were read.
+ */
+
+size_t e_get_stats (int thread, unsigned char *buf, size_t len, int reset)
+{
+	struct ecall_stats *out;
+	size_t need= sizeof(stats[0]);
+	int t, i, j, first, last;
+
+	if ( buf == NULL || len < need ) return need;
+
+	out= (struct ecall_stats *) buf;
+	memset(out, 0, need);
+
+	if ( thread == STATS_ALL_THREADS ) {
+		first= 0;
+		last= stats_nslots;
+	} else if ( thread >= 0 && thread < stats_nslots ) {
+		first= thread;
+		last= thread+1;
+	} else {
+		return need;
+	}
+
+	if ( last > STATS_MAX_THREADS ) last= STATS_MAX_THREADS;
+
+	for (t= first; t< last; ++t) {
+		for (i= 0; i< STATS_NECALLS; ++i) {
+			struct ecall_stats *s= &stats[t][i];
+
+			out[i].calls+= s->calls;
+			out[i].ns+= s->ns;
+			out[i].bytes_in+= s->bytes_in;
+			out[i].bytes_out+= s->bytes_out;
+			for (j= 0; j< STATS_LAT_BUCKETS; ++j)
+				out[i].lat_hist[j]+= s->lat_hist[j];
+			for (j= 0; j< STATS_SIZE_BUCKETS; ++j)
+				out[i].size_hist[j]+= s->size_hist[j];
+		}
+
+		if ( reset ) memset(stats[t], 0, sizeof(stats[t]));
+	}
+
+	return need;
+}
+
+/*
+ * Call stats_start() on entry to an ECALL and stats_record() on the
+ * way out. Only calls that get as far as stats_record() are counted.
+ */
+
+uint64_t stats_start ()
+{
+	uint64_t ns;
+
+	if ( stats_level < STATS_TIME ) return 0;
+
+	if ( ocall_clock_ns(&ns) != SGX_SUCCESS ) return 0;
+
+	return ns;
+}
+
+void stats_record (int ecall, uint64_t start, size_t bytes_in,
+	size_t bytes_out)
+{
+	struct ecall_stats *s;
+	uint64_t ns;
+
+	if ( stats_level == STATS_OFF ) return;
+	if ( ecall < 0 || ecall >= STATS_NECALLS ) return;
+
+	if ( stats_slot == 0 )
+		stats_slot= __sync_fetch_and_add(&stats_nslots, 1)+1;
+
+	if ( stats_slot > STATS_MAX_THREADS ) return;
+
+	s= &stats[stats_slot-1][ecall];
+
+	++s->calls;
+	s->bytes_in+= bytes_in;
+	s->bytes_out+= bytes_out;
+	++s->size_hist[stats_bucket(bytes_in, STATS_SIZE_BUCKETS)];
+
+	/* Calls that started before timing was turned on aren't timed. */
+
+	if ( start == 0 ) return;
+	if ( ocall_clock_ns(&ns) != SGX_SUCCESS || ns < start ) return;
+
+	s->ns+= ns-start;
+	++s->lat_hist[stats_bucket(ns-start, STATS_LAT_BUCKETS)];
+}
+
+static inline int stats_bucket (uint64_t v, int nbuckets)
+{
+	int b= ( v ) ? 64-__builtin_clzll(v) : 0;
+
+	return ( b < nbuckets ) ? b : nbuckets-1;
+}
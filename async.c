@@ -0,0 +1,433 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sgx_urts.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "async.h"
+#include "serialize.h"
+
+/*
+ * Polls an enclave worker makes of an empty ring before it leaves the
+ * enclave to sleep, and polls of an empty completion ring the reaper
+ * makes before it starts napping between polls.
+ */
+
+#define WORKER_SPIN	20000
+#define REAPER_SPIN	20000
+#define REAPER_NAP_NS	20000
+
+/* Room for the result; the enclave says so if it needs more. */
+
+#define RESULT_SLACK	32
+
+static void *worker (void *arg);
+static void *reaper (void *arg);
+static void complete (struct async_engine *eng, struct async_op *op);
+static struct async_op *submit (struct async_engine *eng, uint32_t op,
+	mpz_t a, mpz_t b, uint64_t param, async_cb_t cb, void *arg);
+static void push (struct async_engine *eng, struct async_op *op);
+
+struct async_engine *async_start (struct backend *be, int workers)
+{
+	struct async_engine *eng;
+	void *ring;
+	int i;
+
+	if ( workers < 1 ) workers= 1;
+	if ( workers > ASYNC_MAX_WORKERS ) workers= ASYNC_MAX_WORKERS;
+
+	eng= calloc(1, sizeof(struct async_engine));
+	if ( eng == NULL ) return NULL;
+
+	if ( posix_memalign(&ring, 64, sizeof(struct async_ring)) ) {
+		free(eng);
+		return NULL;
+	}
+
+	eng->ring= (struct async_ring *) ring;
+	eng->be= be;
+	async_queue_init(&eng->ring->sq);
+	async_queue_init(&eng->ring->cq);
+	eng->ring->stop= 0;
+
+	pthread_mutex_init(&eng->lock, NULL);
+	pthread_cond_init(&eng->work, NULL);
+	pthread_cond_init(&eng->pending, NULL);
+	pthread_cond_init(&eng->done, NULL);
+
+	if ( pthread_create(&eng->reaper, NULL, reaper, eng) ) goto error;
+
+	for (i= 0; i< workers; ++i) {
+		if ( pthread_create(&eng->workers[i], NULL, worker, eng) ) break;
+		++eng->nworkers;
+	}
+	if ( eng->nworkers ) return eng;
+
+	eng->stop= 1;
+	pthread_cond_broadcast(&eng->pending);
+	pthread_join(eng->reaper, NULL);
+
+error:
+	free(eng->ring);
+	free(eng);
+
+	return NULL;
+}
+
+/* Finish what is in flight, then call the workers out of the enclave. */
+
+void async_stop (struct async_engine *eng)
+{
+	struct timespec nap= { 0, 1000000 };
+	int i;
+
+	while ( __atomic_load_n(&eng->inflight, __ATOMIC_SEQ_CST) )
+		nanosleep(&nap, NULL);
+
+	pthread_mutex_lock(&eng->lock);
+	eng->stop= 1;
+	eng->ring->stop= 1;
+	pthread_cond_broadcast(&eng->work);
+	pthread_cond_broadcast(&eng->pending);
+	pthread_mutex_unlock(&eng->lock);
+
+	for (i= 0; i< eng->nworkers; ++i) pthread_join(eng->workers[i], NULL);
+	pthread_join(eng->reaper, NULL);
+
+	pthread_mutex_destroy(&eng->lock);
+	pthread_cond_destroy(&eng->work);
+	pthread_cond_destroy(&eng->pending);
+	pthread_cond_destroy(&eng->done);
+
+	free(eng->ring);
+	free(eng);
+}
+
+struct async_op *async_nop (struct async_engine *eng, async_cb_t cb,
+	void *arg)
+{
+	return submit(eng, ASYNC_NOP, NULL, NULL, 0, cb, arg);
+}
+
+struct async_op *async_mpz_add (struct async_engine *eng, mpz_t a, mpz_t b,
+	async_cb_t cb, void *arg)
+{
+	return submit(eng, ASYNC_MPZ_ADD, a, b, 0, cb, arg);
+}
+
+struct async_op *async_mpz_mul (struct async_engine *eng, mpz_t a, mpz_t b,
+	async_cb_t cb, void *arg)
+{
+	return submit(eng, ASYNC_MPZ_MUL, a, b, 0, cb, arg);
+}
+
+struct async_op *async_mpz_div (struct async_engine *eng, mpz_t a, mpz_t b,
+	async_cb_t cb, void *arg)
+{
+	return submit(eng, ASYNC_MPZ_DIV, a, b, 0, cb, arg);
+}
+
+struct async_op *async_mpf_div (struct async_engine *eng, mpz_t a, mpz_t b,
+	int digits, async_cb_t cb, void *arg)
+{
+	if ( digits < 1 ) return NULL;
+
+	return submit(eng, ASYNC_MPF_DIV, a, b, digits, cb, arg);
+}
+
+struct async_op *async_pi (struct async_engine *eng, uint64_t digits,
+	async_cb_t cb, void *arg)
+{
+	if ( digits < 1 ) return NULL;
+
+	return submit(eng, ASYNC_PI, NULL, NULL, digits, cb, arg);
+}
+
+int async_wait (struct async_op *op)
+{
+	struct async_engine *eng= op->eng;
+	int i;
+
+	/* Short operations finish in less time than it takes to sleep. */
+
+	for (i= 0; i< 1000; ++i) {
+		if ( __atomic_load_n(&op->done, __ATOMIC_ACQUIRE) )
+			return op->status;
+		__asm__ __volatile__ ("pause");
+	}
+
+	pthread_mutex_lock(&eng->lock);
+	while ( ! op->done ) pthread_cond_wait(&eng->done, &eng->lock);
+	pthread_mutex_unlock(&eng->lock);
+
+	return op->status;
+}
+
+int async_get_mpz (struct async_op *op, mpz_t c)
+{
+	if ( op->status != ASYNC_DONE || op->req.out == NULL ) return 0;
+
+	return ( mpz_deserialize((mpz_t *) c, op->req.out) != -1 );
+}
+
+int async_get_mpf (struct async_op *op, mpf_t c, int digits)
+{
+	if ( op->status != ASYNC_DONE || op->req.out == NULL ) return 0;
+
+	return ( mpf_deserialize((mpf_t *) c, op->req.out, digits) != -1 );
+}
+
+void async_free (struct async_op *op)
+{
+	if ( op == NULL ) return;
+
+	str_free(op->str_a);
+	str_free(op->str_b);
+	free(op->req.out);
+	free(op);
+}
+
+static struct async_op *submit (struct async_engine *eng, uint32_t opcode,
+	mpz_t a, mpz_t b, uint64_t param, async_cb_t cb, void *arg)
+{
+	struct async_op *op;
+	uint64_t size= 0;
+
+	op= calloc(1, sizeof(struct async_op));
+	if ( op == NULL ) return NULL;
+
+	op->eng= eng;
+	op->cb= cb;
+	op->arg= arg;
+	op->req.op= opcode;
+	op->req.status= ASYNC_PENDING;
+	op->req.param= param;
+
+	if ( a != NULL ) {
+		op->str_a= mpz_serialize(a);
+		op->str_b= mpz_serialize(b);
+		if ( op->str_a == NULL || op->str_b == NULL ) {
+			async_free(op);
+			return NULL;
+		}
+
+		op->req.a= op->str_a;
+		op->req.len_a= strlen(op->str_a);
+		op->req.b= op->str_b;
+		op->req.len_b= strlen(op->str_b);
+	}
+
+	/*
+	 * Guess the size of the result from the operands, in base 62
+	 * digits. Floating point results have fewer base 62 digits than
+	 * decimal ones.
+	 */
+
+	switch (opcode) {
+	case ASYNC_MPZ_ADD:
+		size= ( op->req.len_a > op->req.len_b ) ?
+			op->req.len_a : op->req.len_b;
+		break;
+	case ASYNC_MPZ_MUL:
+		size= op->req.len_a+op->req.len_b;
+		break;
+	case ASYNC_MPZ_DIV:
+		size= op->req.len_a;
+		break;
+	case ASYNC_MPF_DIV:
+	case ASYNC_PI:
+		size= param;
+		break;
+	}
+
+	if ( opcode != ASYNC_NOP ) {
+		size+= RESULT_SLACK;
+		op->req.out= malloc(size+1);
+		if ( op->req.out == NULL ) {
+			async_free(op);
+			return NULL;
+		}
+		op->req.out_size= size;
+	}
+
+	/*
+	 * Never have more in flight than a ring holds, so that neither
+	 * the submission nor the completion ring can fill.
+	 */
+
+	while ( __atomic_add_fetch(&eng->inflight, 1, __ATOMIC_SEQ_CST) >
+		ASYNC_RING_SLOTS )
+	{
+		__atomic_sub_fetch(&eng->inflight, 1, __ATOMIC_SEQ_CST);
+		sched_yield();
+	}
+
+	push(eng, op);
+
+	return op;
+}
+
+/*
+ * Wake a sleeping worker, and the reaper if it is idle. They announce
+ * that they are going to sleep before they check for work one last
+ * time, so one side or the other always sees the new request.
+ */
+
+static void push (struct async_engine *eng, struct async_op *op)
+{
+	while ( ! async_enqueue(&eng->ring->sq, &op->req) ) sched_yield();
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if ( __atomic_load_n(&eng->sleeping, __ATOMIC_SEQ_CST) ||
+		__atomic_load_n(&eng->reaper_sleeping, __ATOMIC_SEQ_CST) )
+	{
+		pthread_mutex_lock(&eng->lock);
+		if ( eng->sleeping ) pthread_cond_signal(&eng->work);
+		if ( eng->reaper_sleeping ) pthread_cond_signal(&eng->pending);
+		pthread_mutex_unlock(&eng->lock);
+	}
+}
+
+static void *worker (void *arg)
+{
+	struct async_engine *eng= (struct async_engine *) arg;
+	struct backend *be= eng->be;
+	struct timespec nap= { 0, 1000000 };
+	sgx_status_t status;
+	int n;
+
+	while ( ! eng->stop ) {
+		status= be->e_async_worker(be->eid, &n, eng->ring, WORKER_SPIN);
+		if ( status == SGX_ERROR_OUT_OF_TCS ) {
+			nanosleep(&nap, NULL);
+			continue;
+		}
+		if ( status != SGX_SUCCESS || n < 0 ) {
+			fprintf(stderr, "ECALL e_async_worker: 0x%04x\n", status);
+			break;
+		}
+
+		pthread_mutex_lock(&eng->lock);
+		__atomic_add_fetch(&eng->sleeping, 1, __ATOMIC_SEQ_CST);
+		while ( ! eng->stop && async_queue_empty(&eng->ring->sq) )
+			pthread_cond_wait(&eng->work, &eng->lock);
+		__atomic_sub_fetch(&eng->sleeping, 1, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&eng->lock);
+	}
+
+	return NULL;
+}
+
+/*
+ * Collect completions. The enclave can't wake us without an OCALL, so
+ * while anything is in flight the reaper polls, spinning at first and
+ * then napping between polls. When nothing is in flight it sleeps
+ * until the next submission.
+ */
+
+static void *reaper (void *arg)
+{
+	struct async_engine *eng= (struct async_engine *) arg;
+	struct timespec nap= { 0, REAPER_NAP_NS };
+	unsigned long idle= 0;
+
+	for (;;) {
+		struct async_req *req= async_dequeue(&eng->ring->cq);
+
+		if ( req != NULL ) {
+			idle= 0;
+			complete(eng, (struct async_op *) req);
+			continue;
+		}
+
+		if ( __atomic_load_n(&eng->inflight, __ATOMIC_SEQ_CST) ) {
+			if ( ++idle < REAPER_SPIN ) __asm__ __volatile__ ("pause");
+			else nanosleep(&nap, NULL);
+			continue;
+		}
+
+		pthread_mutex_lock(&eng->lock);
+		__atomic_store_n(&eng->reaper_sleeping, 1, __ATOMIC_SEQ_CST);
+		while ( ! eng->stop &&
+			! __atomic_load_n(&eng->inflight, __ATOMIC_SEQ_CST) )
+		{
+			pthread_cond_wait(&eng->pending, &eng->lock);
+		}
+		__atomic_store_n(&eng->reaper_sleeping, 0, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&eng->lock);
+
+		if ( eng->stop && ! eng->inflight ) break;
+		idle= 0;
+	}
+
+	return NULL;
+}
+
+static void complete (struct async_engine *eng, struct async_op *op)
+{
+	int status= __atomic_load_n(&op->req.status, __ATOMIC_ACQUIRE);
+
+	/* Too small a guess: make room and send it round again. */
+
+	if ( status == ASYNC_ESPACE && op->req.out_len < SIZE_MAX ) {
+		char *out= realloc(op->req.out, op->req.out_len+1);
+
+		if ( out != NULL ) {
+			op->req.out= out;
+			op->req.out_size= op->req.out_len;
+			op->req.status= ASYNC_PENDING;
+			push(eng, op);
+			return;
+		}
+		status= ASYNC_EFAIL;
+	}
+
+	if ( status == ASYNC_DONE && op->req.out != NULL )
+		op->req.out[op->req.out_len]= '\0';
+	op->status= status;
+
+	if ( op->cb != NULL ) {
+		op->cb(op, op->arg);
+		async_free(op);
+	} else {
+		pthread_mutex_lock(&eng->lock);
+		__atomic_store_n(&op->done, 1, __ATOMIC_RELEASE);
+		pthread_cond_broadcast(&eng->done);
+		pthread_mutex_unlock(&eng->lock);
+	}
+
+	__atomic_sub_fetch(&eng->inflight, 1, __ATOMIC_SEQ_CST);
+}
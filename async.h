@@ -0,0 +1,126 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __ASYNC_H
+#define __ASYNC_H
+
+#include <gmp.h>
+#include <pthread.h>
+#include "async_ring.h"
+#include "backend.h"
+#include "workers.h"
+
+/*
+ * Asynchronous arithmetic. Starting an engine sends worker threads
+ * into the enclave, where they poll the submission ring (see
+ * async_ring.h); an operation is then a few stores to untrusted
+ * memory rather than an ECALL. Each call below submits one operation
+ * and returns at once with a handle.
+ *
+ * Without a callback, wait for the handle with async_wait(), read the
+ * result, and free it with async_free(). With a callback, the callback
+ * runs on the engine's completion thread once the operation is done,
+ * may read the result, and the engine frees the handle after it
+ * returns. Callbacks should be quick, since completions wait for them.
+ *
+ * Up to ASYNC_RING_SLOTS operations can be in flight; submitting more
+ * waits for room. Each worker uses a TCS for as long as the engine
+ * runs, and one TCS is left for ordinary ECALLs.
+ */
+
+#define ASYNC_MAX_WORKERS	(ENCLAVE_MAX_THREADS-1)
+
+struct async_engine;
+struct async_op;
+
+typedef void (*async_cb_t)(struct async_op *op, void *arg);
+
+struct async_op {
+	struct async_req req;		/* Must be first */
+	struct async_engine *eng;
+	async_cb_t cb;
+	void *arg;
+	char *str_a;
+	char *str_b;
+	volatile int done;
+	int status;
+};
+
+struct async_engine {
+	struct async_ring *ring;
+	struct backend *be;
+	int nworkers;
+	pthread_t workers[ASYNC_MAX_WORKERS];
+	pthread_t reaper;
+	pthread_mutex_t lock;
+	pthread_cond_t work;		/* Idle workers sleep here */
+	pthread_cond_t pending;		/* An idle reaper sleeps here */
+	pthread_cond_t done;		/* async_wait() sleeps here */
+	volatile int sleeping;
+	volatile int reaper_sleeping;
+	volatile int inflight;
+	volatile int stop;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct async_engine *async_start (struct backend *be, int workers);
+void async_stop (struct async_engine *eng);
+
+struct async_op *async_nop (struct async_engine *eng, async_cb_t cb,
+	void *arg);
+struct async_op *async_mpz_add (struct async_engine *eng, mpz_t a, mpz_t b,
+	async_cb_t cb, void *arg);
+struct async_op *async_mpz_mul (struct async_engine *eng, mpz_t a, mpz_t b,
+	async_cb_t cb, void *arg);
+struct async_op *async_mpz_div (struct async_engine *eng, mpz_t a, mpz_t b,
+	async_cb_t cb, void *arg);
+struct async_op *async_mpf_div (struct async_engine *eng, mpz_t a, mpz_t b,
+	int digits, async_cb_t cb, void *arg);
+struct async_op *async_pi (struct async_engine *eng, uint64_t digits,
+	async_cb_t cb, void *arg);
+
+/* Returns the final status: ASYNC_DONE or one of the ASYNC_E codes. */
+int async_wait (struct async_op *op);
+
+/* Deserialize a finished result. Return 0 on failure. */
+int async_get_mpz (struct async_op *op, mpz_t c);
+int async_get_mpf (struct async_op *op, mpf_t c, int digits);
+
+void async_free (struct async_op *op);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,189 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __ASYNC_RING__H
+#define __ASYNC_RING__H
+
+#include <stdint.h>
+
+/*
+ * Rings shared between host threads and enclave workers for
+ * asynchronous requests. The whole structure lives in untrusted
+ * memory. The host puts request pointers on the submission queue, and
+ * workers that stay inside the enclave in e_async_worker() take them
+ * off, run them, write the status and result back into the request,
+ * and put the pointer on the completion queue.
+ *
+ * Both queues are bounded multi-producer, multi-consumer queues after
+ * Dmitry Vyukov's design: each cell carries a sequence number that
+ * says whether it is ready to be written or read in the current lap,
+ * so producers and consumers only ever contend on a single CAS of the
+ * tail or head.
+ *
+ * The enclave treats everything here as hostile: it validates the
+ * ring, each request and each buffer with sgx_is_outside_enclave(),
+ * and copies the request and its operands in before using them. A
+ * host that scribbles on the ring can only hurt itself.
+ */
+
+#define ASYNC_RING_SLOTS	256	/* Must be a power of 2 */
+#define ASYNC_RING_MASK		(ASYNC_RING_SLOTS-1)
+
+/* Operations */
+
+#define ASYNC_NOP		0
+#define ASYNC_MPZ_ADD		1
+#define ASYNC_MPZ_MUL		2
+#define ASYNC_MPZ_DIV		3
+#define ASYNC_MPF_DIV		4	/* param is the digits */
+#define ASYNC_PI		5	/* param is the digits */
+#define ASYNC_NOPS		6
+
+/* Request status */
+
+#define ASYNC_PENDING		0
+#define ASYNC_DONE		1
+#define ASYNC_EINVAL		2	/* Bad operation, operands or buffer */
+#define ASYNC_ESPACE		3	/* Result needs out_len bytes */
+#define ASYNC_EFAIL		4	/* The computation failed */
+
+/*
+ * A request. The operands are serialized strings (see serialize.h)
+ * without the terminating NULL. The result is written to out, also
+ * without a NULL, if it fits in out_size bytes; either way, out_len
+ * is set to its length.
+ */
+
+struct async_req {
+	uint32_t op;
+	volatile int32_t status;
+	uint64_t param;
+	const char *a;
+	uint64_t len_a;
+	const char *b;
+	uint64_t len_b;
+	char *out;
+	uint64_t out_size;
+	uint64_t out_len;
+};
+
+struct async_cell {
+	volatile uint64_t seq;
+	struct async_req *req;
+};
+
+struct async_queue {
+	volatile uint64_t head __attribute__((aligned(64)));
+	volatile uint64_t tail __attribute__((aligned(64)));
+	struct async_cell cells[ASYNC_RING_SLOTS] __attribute__((aligned(64)));
+};
+
+struct async_ring {
+	struct async_queue sq;	/* Submissions, host to enclave */
+	struct async_queue cq;	/* Completions, enclave to host */
+	volatile int stop;	/* Tells the workers to leave */
+};
+
+static inline void async_queue_init (struct async_queue *q)
+{
+	uint64_t i;
+
+	q->head= q->tail= 0;
+	for (i= 0; i< ASYNC_RING_SLOTS; ++i) {
+		q->cells[i].seq= i;
+		q->cells[i].req= 0;
+	}
+}
+
+/* Returns 0 if the queue is full. */
+
+static inline int async_enqueue (struct async_queue *q,
+	struct async_req *req)
+{
+	uint64_t pos= __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+
+	for (;;) {
+		struct async_cell *c= &q->cells[pos&ASYNC_RING_MASK];
+		uint64_t seq= __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+		int64_t dif= (int64_t) (seq-pos);
+
+		if ( dif == 0 ) {
+			if ( __atomic_compare_exchange_n(&q->tail, &pos, pos+1, 1,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+			{
+				c->req= req;
+				__atomic_store_n(&c->seq, pos+1, __ATOMIC_RELEASE);
+				return 1;
+			}
+		} else if ( dif < 0 ) {
+			return 0;
+		} else {
+			pos= __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+/* Returns NULL if the queue is empty. */
+
+static inline struct async_req *async_dequeue (struct async_queue *q)
+{
+	uint64_t pos= __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+
+	for (;;) {
+		struct async_cell *c= &q->cells[pos&ASYNC_RING_MASK];
+		uint64_t seq= __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+		int64_t dif= (int64_t) (seq-(pos+1));
+
+		if ( dif == 0 ) {
+			if ( __atomic_compare_exchange_n(&q->head, &pos, pos+1, 1,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+			{
+				struct async_req *req= c->req;
+
+				__atomic_store_n(&c->seq, pos+ASYNC_RING_SLOTS,
+					__ATOMIC_RELEASE);
+				return req;
+			}
+		} else if ( dif < 0 ) {
+			return 0;
+		} else {
+			pos= __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+static inline int async_queue_empty (struct async_queue *q)
+{
+	return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) ==
+		__atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+}
+
+#endif
@@ -0,0 +1,651 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sgx_urts.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "EnclaveGmpTest_u.h"
+#include "backend.h"
+#include "create_enclave.h"
+#include "sgx_detect.h"
+
+#define ENCLAVE_NAME "EnclaveGmpTest.signed.so"
+
+#ifdef HAVE_NATIVE
+
+/*
+ * The enclave code as built for the host in libgmpnative.a, with the
+ * names given to it by native/native.h.
+ */
+
+void native_tgmp_init ();
+size_t native_e_mpz_add (char *str_a, char *str_b);
+size_t native_e_mpz_mul (char *str_a, char *str_b);
+size_t native_e_mpz_div (char *str_a, char *str_b);
+size_t native_e_mpf_div (char *str_a, char *str_b, int digits);
+int native_e_get_result (char *str_c, size_t len);
+size_t native_e_pi (uint64_t digits);
+void native_e_nop ();
+size_t native_e_bench_op (int op, char *str_a, char *str_b, int digits,
+	uint64_t *ns);
+int native_e_stats_enable (int level);
+size_t native_e_get_stats (int thread, unsigned char *buf, size_t len,
+	int reset);
+size_t native_e_heap_stats (unsigned char *buf, size_t len, int reset);
+size_t native_e_stack_probe (size_t depth, int op, char *str_a, char *str_b,
+	int digits, uint64_t *used);
+int native_e_async_worker (void *ring, uint64_t spin);
+int native_e_pi_begin (uint64_t digits);
+int native_e_pi_step (uint64_t terms);
+size_t native_e_pi_end ();
+size_t native_e_mpz_ops (unsigned char *ops, size_t nops, unsigned char *buf,
+	size_t len, unsigned char *out, size_t out_len);
+uint64_t native_e_memo_config (uint64_t max_bytes);
+size_t native_e_memo_stats (unsigned char *buf, size_t len, int reset);
+size_t native_e_pi_split (uint64_t digits, uint64_t part, uint64_t parts);
+size_t native_e_pi_merge (unsigned char *buf, size_t len, uint64_t digits,
+	int final);
+uint64_t native_e_spill_config (uint64_t min_bytes);
+size_t native_e_spill_stats (unsigned char *buf, size_t len, int reset);
+int native_e_worker ();
+size_t native_e_job_finish ();
+int native_e_prime_gen (uint32_t bits, uint32_t count, int reps);
+int native_e_rand_gen (unsigned char *buf, size_t len, uint32_t bits,
+	uint32_t count, int fast);
+int native_e_vec_sum (unsigned char *buf, size_t len);
+int native_e_vec_dot (unsigned char *buf_a, size_t len_a,
+	unsigned char *buf_b, size_t len_b);
+int native_e_mul_job (unsigned char *buf, size_t len, int ways);
+int native_e_linrec_job (unsigned char *buf, size_t len, uint64_t n);
+size_t native_e_multi_exp (unsigned char *buf, size_t len);
+size_t native_e_lucas (unsigned char *buf, size_t len, uint64_t n);
+size_t native_e_mpq_add (unsigned char *buf, size_t len, int canonical);
+size_t native_e_mpq_sub (unsigned char *buf, size_t len, int canonical);
+size_t native_e_mpq_mul (unsigned char *buf, size_t len, int canonical);
+size_t native_e_mpq_div (unsigned char *buf, size_t len, int canonical);
+size_t native_e_mpq_canonicalize (unsigned char *buf, size_t len);
+int native_e_mpq_cmp (unsigned char *buf, size_t len, int *cmp);
+int native_e_fixed_add (uint32_t bits, const unsigned char *a,
+	const unsigned char *b, unsigned char *c, size_t len);
+int native_e_fixed_sub (uint32_t bits, const unsigned char *a,
+	const unsigned char *b, unsigned char *c, size_t len);
+int native_e_fixed_mul (uint32_t bits, const unsigned char *a,
+	const unsigned char *b, size_t len, unsigned char *c, size_t clen);
+
+/*
+ * The wrappers mark the thread as inside the native code for the
+ * length of the call, so that the GMP memory hooks it installs count
+ * its allocations and not the host's (see native/native.c).
+ */
+
+void native_enter ();
+void native_leave ();
+
+static sgx_status_t n_tgmp_init (sgx_enclave_id_t eid)
+{
+	native_enter();
+	native_tgmp_init();
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_mpz_add (sgx_enclave_id_t eid, size_t *len,
+	char *str_a, char *str_b)
+{
+	native_enter();
+	*len= native_e_mpz_add(str_a, str_b);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_mpz_mul (sgx_enclave_id_t eid, size_t *len,
+	char *str_a, char *str_b)
+{
+	native_enter();
+	*len= native_e_mpz_mul(str_a, str_b);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_mpz_div (sgx_enclave_id_t eid, size_t *len,
+	char *str_a, char *str_b)
+{
+	native_enter();
+	*len= native_e_mpz_div(str_a, str_b);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_mpf_div (sgx_enclave_id_t eid, size_t *len,
+	char *str_a, char *str_b, int digits)
+{
+	native_enter();
+	*len= native_e_mpf_div(str_a, str_b, digits);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_get_result (sgx_enclave_id_t eid, int *rv,
+	char *str_c, size_t len)
+{
+	native_enter();
+	*rv= native_e_get_result(str_c, len);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_pi (sgx_enclave_id_t eid, size_t *len,
+	uint64_t digits)
+{
+	native_enter();
+	*len= native_e_pi(digits);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_nop (sgx_enclave_id_t eid)
+{
+	native_enter();
+	native_e_nop();
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_bench_op (sgx_enclave_id_t eid, size_t *len,
+	int op, char *str_a, char *str_b, int digits, uint64_t *ns)
+{
+	native_enter();
+	*len= native_e_bench_op(op, str_a, str_b, digits, ns);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_stats_enable (sgx_enclave_id_t eid, int *old,
+	int level)
+{
+	native_enter();
+	*old= native_e_stats_enable(level);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_get_stats (sgx_enclave_id_t eid, size_t *need,
+	int thread, unsigned char *buf, size_t len, int reset)
+{
+	native_enter();
+	*need= native_e_get_stats(thread, buf, len, reset);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_heap_stats (sgx_enclave_id_t eid, size_t *need,
+	unsigned char *buf, size_t len, int reset)
+{
+	native_enter();
+	*need= native_e_heap_stats(buf, len, reset);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_stack_probe (sgx_enclave_id_t eid, size_t *len,
+	size_t depth, int op, char *str_a, char *str_b, int digits,
+	uint64_t *used)
+{
+	native_enter();
+	*len= native_e_stack_probe(depth, op, str_a, str_b, digits, used);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_async_worker (sgx_enclave_id_t eid, int *n,
+	void *ring, uint64_t spin)
+{
+	native_enter();
+	*n= native_e_async_worker(ring, spin);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_pi_begin (sgx_enclave_id_t eid, int *ok,
+	uint64_t digits)
+{
+	native_enter();
+	*ok= native_e_pi_begin(digits);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_pi_step (sgx_enclave_id_t eid, int *more,
+	uint64_t terms)
+{
+	native_enter();
+	*more= native_e_pi_step(terms);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_pi_end (sgx_enclave_id_t eid, size_t *len)
+{
+	native_enter();
+	*len= native_e_pi_end();
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_mpz_ops (sgx_enclave_id_t eid, size_t *olen,
+	unsigned char *ops, size_t nops, unsigned char *buf, size_t len,
+	unsigned char *out, size_t out_len)
+{
+	native_enter();
+	*olen= native_e_mpz_ops(ops, nops, buf, len, out, out_len);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_memo_config (sgx_enclave_id_t eid, uint64_t *old,
+	uint64_t max_bytes)
+{
+	native_enter();
+	*old= native_e_memo_config(max_bytes);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_memo_stats (sgx_enclave_id_t eid, size_t *need,
+	unsigned char *buf, size_t len, int reset)
+{
+	native_enter();
+	*need= native_e_memo_stats(buf, len, reset);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_pi_split (sgx_enclave_id_t eid, size_t *len,
+	uint64_t digits, uint64_t part, uint64_t parts)
+{
+	native_enter();
+	*len= native_e_pi_split(digits, part, parts);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_pi_merge (sgx_enclave_id_t eid, size_t *olen,
+	unsigned char *buf, size_t len, uint64_t digits, int final)
+{
+	native_enter();
+	*olen= native_e_pi_merge(buf, len, digits, final);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_spill_config (sgx_enclave_id_t eid, uint64_t *old,
+	uint64_t min_bytes)
+{
+	native_enter();
+	*old= native_e_spill_config(min_bytes);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_spill_stats (sgx_enclave_id_t eid, size_t *need,
+	unsigned char *buf, size_t len, int reset)
+{
+	native_enter();
+	*need= native_e_spill_stats(buf, len, reset);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_worker (sgx_enclave_id_t eid, int *rv)
+{
+	native_enter();
+	*rv= native_e_worker();
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_job_finish (sgx_enclave_id_t eid, size_t *len)
+{
+	native_enter();
+	*len= native_e_job_finish();
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_prime_gen (sgx_enclave_id_t eid, int *rv,
+	uint32_t bits, uint32_t count, int reps)
+{
+	native_enter();
+	*rv= native_e_prime_gen(bits, count, reps);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_rand_gen (sgx_enclave_id_t eid, int *rv,
+	unsigned char *buf, size_t len, uint32_t bits, uint32_t count,
+	int fast)
+{
+	native_enter();
+	*rv= native_e_rand_gen(buf, len, bits, count, fast);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_vec_sum (sgx_enclave_id_t eid, int *rv,
+	unsigned char *buf, size_t len)
+{
+	native_enter();
+	*rv= native_e_vec_sum(buf, len);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_vec_dot (sgx_enclave_id_t eid, int *rv,
+	unsigned char *buf_a, size_t len_a, unsigned char *buf_b,
+	size_t len_b)
+{
+	native_enter();
+	*rv= native_e_vec_dot(buf_a, len_a, buf_b, len_b);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_mul_job (sgx_enclave_id_t eid, int *rv,
+	unsigned char *buf, size_t len, int ways)
+{
+	native_enter();
+	*rv= native_e_mul_job(buf, len, ways);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_linrec_job (sgx_enclave_id_t eid, int *rv,
+	unsigned char *buf, size_t len, uint64_t n)
+{
+	native_enter();
+	*rv= native_e_linrec_job(buf, len, n);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_multi_exp (sgx_enclave_id_t eid, size_t *olen,
+	unsigned char *buf, size_t len)
+{
+	native_enter();
+	*olen= native_e_multi_exp(buf, len);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_lucas (sgx_enclave_id_t eid, size_t *olen,
+	unsigned char *buf, size_t len, uint64_t n)
+{
+	native_enter();
+	*olen= native_e_lucas(buf, len, n);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_mpq_add (sgx_enclave_id_t eid, size_t *olen,
+	unsigned char *buf, size_t len, int canonical)
+{
+	native_enter();
+	*olen= native_e_mpq_add(buf, len, canonical);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_mpq_sub (sgx_enclave_id_t eid, size_t *olen,
+	unsigned char *buf, size_t len, int canonical)
+{
+	native_enter();
+	*olen= native_e_mpq_sub(buf, len, canonical);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_mpq_mul (sgx_enclave_id_t eid, size_t *olen,
+	unsigned char *buf, size_t len, int canonical)
+{
+	native_enter();
+	*olen= native_e_mpq_mul(buf, len, canonical);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_mpq_div (sgx_enclave_id_t eid, size_t *olen,
+	unsigned char *buf, size_t len, int canonical)
+{
+	native_enter();
+	*olen= native_e_mpq_div(buf, len, canonical);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_mpq_canonicalize (sgx_enclave_id_t eid, size_t *olen,
+	unsigned char *buf, size_t len)
+{
+	native_enter();
+	*olen= native_e_mpq_canonicalize(buf, len);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_mpq_cmp (sgx_enclave_id_t eid, int *rv,
+	unsigned char *buf, size_t len, int *cmp)
+{
+	native_enter();
+	*rv= native_e_mpq_cmp(buf, len, cmp);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_fixed_add (sgx_enclave_id_t eid, int *rv,
+	uint32_t bits, const unsigned char *a, const unsigned char *b,
+	unsigned char *c, size_t len)
+{
+	native_enter();
+	*rv= native_e_fixed_add(bits, a, b, c, len);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_fixed_sub (sgx_enclave_id_t eid, int *rv,
+	uint32_t bits, const unsigned char *a, const unsigned char *b,
+	unsigned char *c, size_t len)
+{
+	native_enter();
+	*rv= native_e_fixed_sub(bits, a, b, c, len);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+static sgx_status_t n_e_fixed_mul (sgx_enclave_id_t eid, int *rv,
+	uint32_t bits, const unsigned char *a, const unsigned char *b,
+	size_t len, unsigned char *c, size_t clen)
+{
+	native_enter();
+	*rv= native_e_fixed_mul(bits, a, b, len, c, clen);
+	native_leave();
+	return SGX_SUCCESS;
+}
+
+/* OCALLs from the native code go straight to the host versions. */
+
+sgx_status_t native_ocall_clock_ns (uint64_t *ns)
+{
+	ocall_clock_ns(ns);
+	return SGX_SUCCESS;
+}
+
+sgx_status_t native_ocall_spill_alloc (uint64_t *handle, size_t len)
+{
+	*handle= ocall_spill_alloc(len);
+	return SGX_SUCCESS;
+}
+
+sgx_status_t native_ocall_spill_map (void **buf, uint64_t handle)
+{
+	*buf= ocall_spill_map(handle);
+	return SGX_SUCCESS;
+}
+
+sgx_status_t native_ocall_spill_unmap (uint64_t handle)
+{
+	ocall_spill_unmap(handle);
+	return SGX_SUCCESS;
+}
+
+sgx_status_t native_ocall_spill_free (uint64_t handle)
+{
+	ocall_spill_free(handle);
+	return SGX_SUCCESS;
+}
+
+static const struct backend native_backend= {
+	"native", 0,
+	n_tgmp_init, n_e_mpz_add, n_e_mpz_mul, n_e_mpz_div, n_e_mpf_div,
+	n_e_get_result, n_e_pi, n_e_nop, n_e_bench_op, n_e_stats_enable,
+	n_e_get_stats, n_e_heap_stats, n_e_stack_probe, n_e_async_worker,
+	n_e_pi_begin, n_e_pi_step, n_e_pi_end, n_e_mpz_ops, n_e_memo_config,
+	n_e_memo_stats, n_e_pi_split, n_e_pi_merge, n_e_spill_config,
+	n_e_spill_stats,
+	n_e_worker, n_e_job_finish, n_e_prime_gen, n_e_rand_gen, n_e_vec_sum,
+	n_e_vec_dot, n_e_mul_job, n_e_linrec_job, n_e_multi_exp, n_e_lucas,
+	n_e_mpq_add, n_e_mpq_sub, n_e_mpq_mul, n_e_mpq_div,
+	n_e_mpq_canonicalize, n_e_mpq_cmp, n_e_fixed_add, n_e_fixed_sub,
+	n_e_fixed_mul
+};
+
+#endif
+
+static int open_enclave (struct backend *be);
+
+static const struct backend enclave_backend= {
+	"sgx", 0,
+	tgmp_init, e_mpz_add, e_mpz_mul, e_mpz_div, e_mpf_div, e_get_result,
+	e_pi, e_nop, e_bench_op, e_stats_enable, e_get_stats, e_heap_stats,
+	e_stack_probe, e_async_worker, e_pi_begin, e_pi_step, e_pi_end,
+	e_mpz_ops, e_memo_config, e_memo_stats, e_pi_split, e_pi_merge,
+	e_spill_config, e_spill_stats,
+	e_worker, e_job_finish, e_prime_gen, e_rand_gen, e_vec_sum, e_vec_dot,
+	e_mul_job, e_linrec_job, e_multi_exp, e_lucas, e_mpq_add, e_mpq_sub,
+	e_mpq_mul, e_mpq_div, e_mpq_canonicalize, e_mpq_cmp, e_fixed_add,
+	e_fixed_sub, e_fixed_mul
+};
+
+int backend_open (struct backend *be, const char *name)
+{
+	if ( name == NULL ) name= getenv(BACKEND_ENV);
+	if ( name == NULL ) name= "sgx";
+
+	if ( strcmp(name, "native") == 0 ) {
+#ifdef HAVE_NATIVE
+		*be= native_backend;
+		be->tgmp_init(be->eid);
+
+		fprintf(stderr, "Using the native backend\n");
+
+		return 1;
+#else
+		fprintf(stderr, "%s: not built (configure --enable-native)\n",
+			name);
+		return 0;
+#endif
+	}
+
+	if ( strcmp(name, "sgx") != 0 ) {
+		fprintf(stderr, "%s: unknown backend\n", name);
+		return 0;
+	}
+
+#ifndef SGX_HW_SIM
+	{
+		uint64_t start= startup_clock();
+		unsigned long support= get_sgx_support();
+
+		startup_add(STARTUP_DETECT, start);
+
+		if ( ! SGX_OK(support) ) {
+			sgx_support_perror(support);
+			return 0;
+		}
+	}
+#endif
+
+	return open_enclave(be);
+}
+
+static int open_enclave (struct backend *be)
+{
+	sgx_launch_token_t token= { 0 };
+	sgx_status_t status;
+	uint64_t start;
+	int updated= 0;
+
+	*be= enclave_backend;
+
+	status= sgx_create_enclave_search(ENCLAVE_NAME, SGX_DEBUG_FLAG,
+		 &token, &updated, &be->eid, 0);
+	if ( status != SGX_SUCCESS ) {
+		if ( status == SGX_ERROR_ENCLAVE_FILE_ACCESS ) {
+			fprintf(stderr, "sgx_create_enclave: %s: file not found\n",
+				ENCLAVE_NAME);
+			fprintf(stderr, "Did you forget to set LD_LIBRARY_PATH?\n");
+		} else {
+			fprintf(stderr, "%s: 0x%04x\n", ENCLAVE_NAME, status);
+		}
+		return 0;
+	}
+
+	fprintf(stderr, "Enclave launched\n");
+
+	start= startup_clock();
+	status= be->tgmp_init(be->eid);
+	startup_add(STARTUP_INIT, start);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL tgmp_init: 0x%04x\n", status);
+		sgx_destroy_enclave(be->eid);
+		return 0;
+	}
+
+	fprintf(stderr, "libtgmp initialized\n");
+
+	startup_report();
+
+	return 1;
+}
+
+void backend_close (struct backend *be)
+{
+	if ( strcmp(be->name, "sgx") == 0 ) sgx_destroy_enclave(be->eid);
+}
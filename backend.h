@@ -0,0 +1,158 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __BACKEND_H
+#define __BACKEND_H
+
+#include <sgx_urts.h>
+#include <stdint.h>
+
+/*
+ * The arithmetic ECALLs, behind a table so that the same calls can go
+ * to the enclave or to a native build of the enclave code that runs
+ * directly on the host. Comparing the two shows what the enclave
+ * costs. The function signatures are those of the untrusted proxies
+ * generated by edger8r, so the enclave table is just those proxies.
+ *
+ * The backend is chosen by name, "sgx" or "native". If no name is
+ * given it comes from the environment, and defaults to sgx. Native
+ * code runs in the clear, so it is never chosen unless asked for, and
+ * is only there if configure was run with --enable-native.
+ */
+
+#define BACKEND_ENV "SGXGMP_BACKEND"
+
+struct backend {
+	const char *name;
+	sgx_enclave_id_t eid;
+
+	sgx_status_t (*tgmp_init)(sgx_enclave_id_t eid);
+	sgx_status_t (*e_mpz_add)(sgx_enclave_id_t eid, size_t *len,
+		char *str_a, char *str_b);
+	sgx_status_t (*e_mpz_mul)(sgx_enclave_id_t eid, size_t *len,
+		char *str_a, char *str_b);
+	sgx_status_t (*e_mpz_div)(sgx_enclave_id_t eid, size_t *len,
+		char *str_a, char *str_b);
+	sgx_status_t (*e_mpf_div)(sgx_enclave_id_t eid, size_t *len,
+		char *str_a, char *str_b, int digits);
+	sgx_status_t (*e_get_result)(sgx_enclave_id_t eid, int *rv,
+		char *str_c, size_t len);
+	sgx_status_t (*e_pi)(sgx_enclave_id_t eid, size_t *len,
+		uint64_t digits);
+	sgx_status_t (*e_nop)(sgx_enclave_id_t eid);
+	sgx_status_t (*e_bench_op)(sgx_enclave_id_t eid, size_t *len, int op,
+		char *str_a, char *str_b, int digits, uint64_t *ns);
+	sgx_status_t (*e_stats_enable)(sgx_enclave_id_t eid, int *old,
+		int level);
+	sgx_status_t (*e_get_stats)(sgx_enclave_id_t eid, size_t *need,
+		int thread, unsigned char *buf, size_t len, int reset);
+	sgx_status_t (*e_heap_stats)(sgx_enclave_id_t eid, size_t *need,
+		unsigned char *buf, size_t len, int reset);
+	sgx_status_t (*e_stack_probe)(sgx_enclave_id_t eid, size_t *len,
+		size_t depth, int op, char *str_a, char *str_b, int digits,
+		uint64_t *used);
+	sgx_status_t (*e_async_worker)(sgx_enclave_id_t eid, int *n,
+		void *ring, uint64_t spin);
+	sgx_status_t (*e_pi_begin)(sgx_enclave_id_t eid, int *ok,
+		uint64_t digits);
+	sgx_status_t (*e_pi_step)(sgx_enclave_id_t eid, int *more,
+		uint64_t terms);
+	sgx_status_t (*e_pi_end)(sgx_enclave_id_t eid, size_t *len);
+	sgx_status_t (*e_mpz_ops)(sgx_enclave_id_t eid, size_t *olen,
+		unsigned char *ops, size_t nops, unsigned char *buf, size_t len,
+		unsigned char *out, size_t out_len);
+	sgx_status_t (*e_memo_config)(sgx_enclave_id_t eid, uint64_t *old,
+		uint64_t max_bytes);
+	sgx_status_t (*e_memo_stats)(sgx_enclave_id_t eid, size_t *need,
+		unsigned char *buf, size_t len, int reset);
+	sgx_status_t (*e_pi_split)(sgx_enclave_id_t eid, size_t *len,
+		uint64_t digits, uint64_t part, uint64_t parts);
+	sgx_status_t (*e_pi_merge)(sgx_enclave_id_t eid, size_t *olen,
+		unsigned char *buf, size_t len, uint64_t digits, int final);
+	sgx_status_t (*e_spill_config)(sgx_enclave_id_t eid, uint64_t *old,
+		uint64_t min_bytes);
+	sgx_status_t (*e_spill_stats)(sgx_enclave_id_t eid, size_t *need,
+		unsigned char *buf, size_t len, int reset);
+	sgx_status_t (*e_worker)(sgx_enclave_id_t eid, int *rv);
+	sgx_status_t (*e_job_finish)(sgx_enclave_id_t eid, size_t *len);
+	sgx_status_t (*e_prime_gen)(sgx_enclave_id_t eid, int *rv,
+		uint32_t bits, uint32_t count, int reps);
+	sgx_status_t (*e_rand_gen)(sgx_enclave_id_t eid, int *rv,
+		unsigned char *buf, size_t len, uint32_t bits, uint32_t count,
+		int fast);
+	sgx_status_t (*e_vec_sum)(sgx_enclave_id_t eid, int *rv,
+		unsigned char *buf, size_t len);
+	sgx_status_t (*e_vec_dot)(sgx_enclave_id_t eid, int *rv,
+		unsigned char *buf_a, size_t len_a, unsigned char *buf_b,
+		size_t len_b);
+	sgx_status_t (*e_mul_job)(sgx_enclave_id_t eid, int *rv,
+		unsigned char *buf, size_t len, int ways);
+	sgx_status_t (*e_linrec_job)(sgx_enclave_id_t eid, int *rv,
+		unsigned char *buf, size_t len, uint64_t n);
+	sgx_status_t (*e_multi_exp)(sgx_enclave_id_t eid, size_t *olen,
+		unsigned char *buf, size_t len);
+	sgx_status_t (*e_lucas)(sgx_enclave_id_t eid, size_t *olen,
+		unsigned char *buf, size_t len, uint64_t n);
+	sgx_status_t (*e_mpq_add)(sgx_enclave_id_t eid, size_t *olen,
+		unsigned char *buf, size_t len, int canonical);
+	sgx_status_t (*e_mpq_sub)(sgx_enclave_id_t eid, size_t *olen,
+		unsigned char *buf, size_t len, int canonical);
+	sgx_status_t (*e_mpq_mul)(sgx_enclave_id_t eid, size_t *olen,
+		unsigned char *buf, size_t len, int canonical);
+	sgx_status_t (*e_mpq_div)(sgx_enclave_id_t eid, size_t *olen,
+		unsigned char *buf, size_t len, int canonical);
+	sgx_status_t (*e_mpq_canonicalize)(sgx_enclave_id_t eid, size_t *olen,
+		unsigned char *buf, size_t len);
+	sgx_status_t (*e_mpq_cmp)(sgx_enclave_id_t eid, int *rv,
+		unsigned char *buf, size_t len, int *cmp);
+	sgx_status_t (*e_fixed_add)(sgx_enclave_id_t eid, int *rv,
+		uint32_t bits, const unsigned char *a, const unsigned char *b,
+		unsigned char *c, size_t len);
+	sgx_status_t (*e_fixed_sub)(sgx_enclave_id_t eid, int *rv,
+		uint32_t bits, const unsigned char *a, const unsigned char *b,
+		unsigned char *c, size_t len);
+	sgx_status_t (*e_fixed_mul)(sgx_enclave_id_t eid, int *rv,
+		uint32_t bits, const unsigned char *a, const unsigned char *b,
+		size_t len, unsigned char *c, size_t clen);
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int backend_open (struct backend *be, const char *name);
+void backend_close (struct backend *be);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
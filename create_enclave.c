@@ -33,12 +33,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "create_enclave.h"
 #include "sgx_stub.h"
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdio.h>
 #include <sgx_urts.h>
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #define MAX_LEN 80
 
@@ -48,44 +52,146 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define DEF_LIB_SEARCHPATH "/lib:/usr/lib"
 #endif
 
+#define FNV_OFFSET	0xcbf29ce484222325ULL
+#define FNV_PRIME	0x100000001b3ULL
+
+static const char *phase_names[STARTUP_NPHASES]= {
+	"detection", "dlopen", "search", "creation", "tgmp_init"
+};
+
+static uint64_t phase_ns[STARTUP_NPHASES];
+static const char *token_source= NULL;
+static const char *path_source= NULL;
+
 int file_in_searchpath (const char *file, char *search, char *fullpath,
 	size_t len);
 
+static const char *resolve_path (const char *filename, char *epath,
+	size_t len);
+static const char *cache_dir ();
+static uint64_t fnv1a (uint64_t h, const void *buf, size_t len);
+static uint64_t fnv1a_str (uint64_t h, const char *str);
+static int enclave_key (const char *path, int debug, uint64_t *key);
+static int cache_read (const char *name, void *buf, size_t len);
+static void cache_write (const char *name, const void *buf, size_t len);
+
 /*
  * Search for the enclave file and then try and load it.
+ *
+ * If the caller passes an empty launch token, use the one saved from
+ * the last run, and save it again if sgx_create_enclave updates it. A
+ * stale token costs nothing more than an empty one: the loader just
+ * gets a new one.
  */
 
 sgx_status_t sgx_create_enclave_search (const char *filename, const int debug,
 	sgx_launch_token_t *token, int *updated, sgx_enclave_id_t *eid,
 	sgx_misc_attribute_t *attr)
 {
-	struct stat sb;
 	char epath[PATH_MAX];	/* includes NULL */
+	char tname[32];
+	const char *path;
+	sgx_launch_token_t empty;
+	sgx_status_t status;
+	uint64_t start, key;
+	int cached= 0, keyed;
+
+	start= startup_clock();
+	path= resolve_path(filename, epath, PATH_MAX);
+	startup_add(STARTUP_SEARCH, start);
+
+	start= startup_clock();
+
+	memset(empty, 0, sizeof(empty));
+	keyed= enclave_key(path, debug, &key);
+	if ( keyed ) {
+		snprintf(tname, sizeof(tname), "%016llx.token",
+			(unsigned long long) key);
+
+		if ( memcmp(*token, empty, sizeof(empty)) == 0 )
+			cached= cache_read(tname, *token, sizeof(sgx_launch_token_t));
+	}
+
+	status= sgx_create_enclave(path, debug, token, updated, eid, attr);
+
+	/* A bad token should only cost us a new one, but just in case. */
+
+	if ( status == SGX_ERROR_INVALID_LAUNCH_TOKEN && cached ) {
+		memset(*token, 0, sizeof(sgx_launch_token_t));
+		cached= 0;
+		status= sgx_create_enclave(path, debug, token, updated, eid,
+			attr);
+	}
+
+	if ( status == SGX_SUCCESS && keyed && *updated )
+		cache_write(tname, *token, sizeof(sgx_launch_token_t));
+
+	startup_add(STARTUP_CREATE, start);
+
+	token_source= ( ! cached ) ? "new" : ( *updated ) ? "cached, stale" :
+		"cached";
+
+	return status;
+}
+
+/*
+ * Find the enclave file. A search of the library paths is saved in the
+ * cache, keyed by the file name and the search paths, and used for as
+ * long as the file it names is still there.
+ */
+
+static const char *resolve_path (const char *filename, char *epath,
+	size_t len)
+{
+	struct stat sb;
+	char pname[32];
+	uint64_t key;
+	ssize_t n;
+
+	path_source= "given";
 
 	/* Is filename an absolute path? */
 
-	if ( filename[0] == '/' ) 
-		return sgx_create_enclave(filename, debug, token, updated, eid, attr);
+	if ( filename[0] == '/' ) return filename;
 
 	/* Is the enclave in the current working directory? */
 
-	if ( stat(filename, &sb) == 0 )
-		return sgx_create_enclave(filename, debug, token, updated, eid, attr);
+	if ( stat(filename, &sb) == 0 ) return filename;
+
+	/* Have we searched for it before? */
+
+	key= fnv1a_str(FNV_OFFSET, filename);
+	key= fnv1a_str(key, getenv("LD_LIBRARY_PATH"));
+	key= fnv1a_str(key, getenv("DT_RUNPATH"));
+	snprintf(pname, sizeof(pname), "%016llx.path", (unsigned long long) key);
+
+	n= cache_read(pname, epath, len-1);
+	if ( n > 0 ) {
+		epath[n]= '\0';
+		if ( epath[0] == '/' && stat(epath, &sb) == 0 &&
+			S_ISREG(sb.st_mode) )
+		{
+			path_source= "cached";
+			return epath;
+		}
+	}
+
+	path_source= "searched";
 
 	/* Search the paths in LD_LBRARY_PATH */
 
-	if ( file_in_searchpath(filename, getenv("LD_LIBRARY_PATH"), epath, PATH_MAX) )
-		return sgx_create_enclave(epath, debug, token, updated, eid, attr);
-		
+	if ( file_in_searchpath(filename, getenv("LD_LIBRARY_PATH"), epath, len) )
+		goto found;
+
 	/* Search the paths in DT_RUNPATH */
 
-	if ( file_in_searchpath(filename, getenv("DT_RUNPATH"), epath, PATH_MAX) )
-		return sgx_create_enclave(epath, debug, token, updated, eid, attr);
+	if ( file_in_searchpath(filename, getenv("DT_RUNPATH"), epath, len) )
+		goto found;
 
 	/* Standard system library paths */
 
-	if ( file_in_searchpath(filename, DEF_LIB_SEARCHPATH, epath, PATH_MAX) )
-		return sgx_create_enclave(epath, debug, token, updated, eid, attr);
+	if ( file_in_searchpath(filename, DEF_LIB_SEARCHPATH, epath, len) )
+		goto found;
 
 	/*
 	 * If we've made it this far then we don't know where else to look.
@@ -95,7 +201,14 @@ sgx_status_t sgx_create_enclave_search (const char *filename, const int debug,
 	 * get reported to the calling function.
 	 */
 
-	return sgx_create_enclave(filename, debug, token, updated, eid, attr);
+	return filename;
+
+found:
+	/* Only absolute paths are worth keeping. */
+
+	if ( epath[0] == '/' ) cache_write(pname, epath, strlen(epath));
+
+	return epath;
 }
 
 int file_in_searchpath (const char *file, char *search, char *fullpath, 
@@ -139,3 +252,188 @@ int file_in_searchpath (const char *file, char *search, char *fullpath,
 	return 0;
 }
 
+
+/*
+ * The launch token belongs to the enclave's measurement. Rather than
+ * read the whole file on every launch, the cache key is a hash of what
+ * stat() says about it, which changes whenever the file is rebuilt or
+ * replaced, and of the debug flag, which is one of its attributes. If
+ * the file were rewritten in place without any of these changing, the
+ * stale token would only cost a new one (see above).
+ */
+
+static int enclave_key (const char *path, int debug, uint64_t *key)
+{
+	struct stat sb;
+	uint64_t h= FNV_OFFSET;
+
+	if ( cache_dir() == NULL ) return 0;
+
+	if ( stat(path, &sb) == -1 ) return 0;
+
+	h= fnv1a(h, &sb.st_dev, sizeof(sb.st_dev));
+	h= fnv1a(h, &sb.st_ino, sizeof(sb.st_ino));
+	h= fnv1a(h, &sb.st_size, sizeof(sb.st_size));
+	h= fnv1a(h, &sb.st_mtim, sizeof(sb.st_mtim));
+	*key= fnv1a(h, &debug, sizeof(debug));
+
+	return 1;
+}
+
+static uint64_t fnv1a (uint64_t h, const void *buf, size_t len)
+{
+	const unsigned char *p= buf;
+	size_t i;
+
+	for (i= 0; i< len; ++i) {
+		h^= p[i];
+		h*= FNV_PRIME;
+	}
+
+	return h;
+}
+
+/* NULL is hashed differently from an empty string. */
+
+static uint64_t fnv1a_str (uint64_t h, const char *str)
+{
+	if ( str == NULL ) return fnv1a(h, "", 1);
+
+	return fnv1a(h, str, strlen(str)+1);
+}
+
+/*
+ * Find the cache directory, creating it if need be, or NULL if there
+ * isn't one. This is only worked out once.
+ */
+
+static const char *cache_dir ()
+{
+	static char path[PATH_MAX];
+	static int found= -1;
+	const char *env;
+	int n;
+
+	if ( found != -1 ) return ( found ) ? path : NULL;
+
+	found= 0;
+
+	env= getenv(CACHE_ENV);
+	if ( env != NULL ) {
+		if ( env[0] == '\0' ) return NULL;
+		n= snprintf(path, sizeof(path), "%s", env);
+	} else if ( (env= getenv("XDG_CACHE_HOME")) != NULL && env[0] ) {
+		n= snprintf(path, sizeof(path), "%s/sgxgmp", env);
+	} else if ( (env= getenv("HOME")) != NULL && env[0] ) {
+		if ( (size_t) snprintf(path, sizeof(path), "%s/.cache", env) <
+			sizeof(path) )
+		{
+			mkdir(path, 0700);
+		}
+		n= snprintf(path, sizeof(path), "%s/.cache/sgxgmp", env);
+	} else {
+		return NULL;
+	}
+
+	if ( n < 0 || (size_t) n >= sizeof(path) ) return NULL;
+
+	if ( mkdir(path, 0700) == -1 && errno != EEXIST ) return NULL;
+
+	found= 1;
+
+	return path;
+}
+
+/* Returns the number of bytes read, or 0 if there's no entry. */
+
+static int cache_read (const char *name, void *buf, size_t len)
+{
+	char path[PATH_MAX];
+	const char *dir;
+	ssize_t n;
+	int fd;
+
+	if ( (dir= cache_dir()) == NULL ) return 0;
+
+	if ( (size_t) snprintf(path, sizeof(path), "%s/%s", dir, name) >=
+		sizeof(path) )
+	{
+		return 0;
+	}
+
+	fd= open(path, O_RDONLY);
+	if ( fd == -1 ) return 0;
+
+	n= read(fd, buf, len);
+	close(fd);
+
+	return ( n < 0 ) ? 0 : (int) n;
+}
+
+/*
+ * Write a new file and rename it into place, so that a reader never
+ * sees half an entry. Failures just leave the cache as it was.
+ */
+
+static void cache_write (const char *name, const void *buf, size_t len)
+{
+	char path[PATH_MAX], tmp[PATH_MAX];
+	const char *dir;
+	int fd, ok;
+
+	if ( (dir= cache_dir()) == NULL ) return;
+
+	if ( (size_t) snprintf(path, sizeof(path), "%s/%s", dir, name) >=
+		sizeof(path) )
+	{
+		return;
+	}
+	if ( (size_t) snprintf(tmp, sizeof(tmp), "%s.%ld", path,
+		(long) getpid()) >= sizeof(tmp) )
+	{
+		return;
+	}
+
+	fd= open(tmp, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+	if ( fd == -1 ) return;
+
+	ok= ( write(fd, buf, len) == (ssize_t) len );
+	if ( close(fd) == -1 ) ok= 0;
+
+	if ( ! ok || rename(tmp, path) == -1 ) unlink(tmp);
+}
+
+uint64_t startup_clock ()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+void startup_add (int phase, uint64_t start)
+{
+	phase_ns[phase]+= startup_clock()-start;
+}
+
+void startup_report ()
+{
+	int i;
+
+	if ( getenv(STARTUP_TIMES_ENV) != NULL ) {
+		fprintf(stderr, "Startup:");
+		for (i= 0; i< STARTUP_NPHASES; ++i) {
+			fprintf(stderr, " %s %.3f ms%s", phase_names[i],
+				(double) phase_ns[i]/1e6,
+				( i == STARTUP_NPHASES-1 ) ? "\n" : ",");
+		}
+		if ( path_source != NULL ) {
+			fprintf(stderr, "Startup: enclave path %s, launch token %s\n",
+				path_source, token_source);
+		}
+	}
+
+	memset(phase_ns, 0, sizeof(phase_ns));
+	path_source= token_source= NULL;
+}
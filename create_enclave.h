@@ -35,6 +35,33 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define __CREATE_ENCLAVE_H
 
 #include <sgx_urts.h>
+#include <stdint.h>
+
+/*
+ * sgx_create_enclave_search keeps a cache, so that a short-lived
+ * program doesn't redo work that a previous run has done: the path
+ * that the search found, and the launch token for each enclave. The
+ * directory is $SGXGMP_CACHE, or sgxgmp in $XDG_CACHE_HOME or
+ * $HOME/.cache. An empty SGXGMP_CACHE turns the cache off.
+ */
+
+#define CACHE_ENV	"SGXGMP_CACHE"
+
+/*
+ * Time spent starting up, by phase. The phases are added up as they
+ * happen, and startup_report prints them to stderr and starts over
+ * if STARTUP_TIMES_ENV is set. dlopen happens during detection, so it
+ * is counted in both.
+ */
+
+#define STARTUP_TIMES_ENV	"SGXGMP_STARTUP_TIMES"
+
+#define STARTUP_DETECT	0
+#define STARTUP_DLOPEN	1
+#define STARTUP_SEARCH	2
+#define STARTUP_CREATE	3
+#define STARTUP_INIT	4
+#define STARTUP_NPHASES	5
 
 #ifdef __cplusplus
 extern "C" {
@@ -49,6 +76,10 @@ sgx_status_t sgx_create_enclave_search (
 	sgx_misc_attribute_t *attr
 );
 
+uint64_t startup_clock ();
+void startup_add (int phase, uint64_t start);
+void startup_report ();
+
 #ifdef __cplusplus
 };
 #endif
@@ -0,0 +1,245 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sgx_urts.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "backend.h"
+#include "ecall_stats.h"
+
+static const char *ecall_names[STATS_NECALLS]= {
+	"e_mpz_add",
+	"e_mpz_mul",
+	"e_mpz_div",
+	"e_mpf_div",
+	"e_pi",
+	"e_get_result",
+	"e_job_finish",
+	"e_multi_exp",
+	"e_mpq_add",
+	"e_mpq_sub",
+	"e_mpq_mul",
+	"e_mpq_div",
+	"e_mpq_canonicalize",
+	"e_mpq_cmp",
+	"e_fixed_add",
+	"e_fixed_sub",
+	"e_fixed_mul",
+	"e_mpz_ops",
+	"e_lucas"
+};
+
+const char *ecall_stats_name (int ecall)
+{
+	if ( ecall < 0 || ecall >= STATS_NECALLS ) return NULL;
+
+	return ecall_names[ecall];
+}
+
+/*
+ * The p'th percentile (0-100) of a log2 histogram. The histogram only
+ * knows which power of two a value fell under, so this returns the
+ * upper bound of that bucket: the true value is at most this, and more
+ * than half of it.
+ */
+
+uint64_t ecall_stats_percentile (const uint64_t *hist, int nbuckets,
+	double p)
+{
+	uint64_t total= 0, want, seen= 0;
+	int i;
+
+	for (i= 0; i< nbuckets; ++i) total+= hist[i];
+	if ( total == 0 ) return 0;
+
+	want= (uint64_t) (p*(double) total/100.0);
+	if ( want < 1 ) want= 1;
+	if ( want > total ) want= total;
+
+	for (i= 0; i< nbuckets; ++i) {
+		seen+= hist[i];
+		if ( seen >= want ) break;
+	}
+
+	if ( i == 0 ) return 0;
+	if ( i >= 64 ) return UINT64_MAX;
+
+	return (uint64_t) 1 << i;
+}
+
+/* Print a table of the ECALLs that were called, to stderr. */
+
+void ecall_stats_print (const struct ecall_stats *stats)
+{
+	int i, j;
+
+	fprintf(stderr, "%-20s %10s %12s %12s %12s %12s %12s %12s\n",
+		"ecall", "calls", "mean_ns", "p50_ns", "p90_ns", "p99_ns",
+		"bytes_in", "bytes_out");
+
+	for (i= 0; i< STATS_NECALLS; ++i) {
+		const struct ecall_stats *s= &stats[i];
+		uint64_t timed= 0;
+
+		if ( s->calls == 0 ) continue;
+
+		/* Calls made while timing was off aren't in the histogram. */
+
+		for (j= 0; j< STATS_LAT_BUCKETS; ++j) timed+= s->lat_hist[j];
+
+		fprintf(stderr, "%-20s %10llu %12llu %12llu %12llu %12llu %12llu "
+			"%12llu\n", ecall_names[i],
+			(unsigned long long) s->calls,
+			(unsigned long long) (( timed ) ? s->ns/timed : 0),
+			(unsigned long long) ecall_stats_percentile(s->lat_hist,
+				STATS_LAT_BUCKETS, 50),
+			(unsigned long long) ecall_stats_percentile(s->lat_hist,
+				STATS_LAT_BUCKETS, 90),
+			(unsigned long long) ecall_stats_percentile(s->lat_hist,
+				STATS_LAT_BUCKETS, 99),
+			(unsigned long long) s->bytes_in,
+			(unsigned long long) s->bytes_out);
+	}
+}
+
+/*
+ * Fetch the enclave's heap counters, zeroing them first if reset is
+ * set. Returns 0 after printing why if the ECALL fails.
+ */
+
+int heap_snapshot (struct backend *be, struct heap_stats *hs, int reset)
+{
+	sgx_status_t status;
+	size_t need;
+
+	status= be->e_heap_stats(be->eid, &need, (unsigned char *) hs,
+		sizeof(*hs), reset);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_heap_stats: 0x%04x\n", status);
+		return 0;
+	}
+	if ( need != sizeof(*hs) ) {
+		fprintf(stderr, "e_heap_stats: size mismatch\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Summarize heap use between two snapshots, to stderr. The first
+ * should have been taken with a reset, so that the counters and peak
+ * in the second cover just what happened in between. Whatever is still
+ * live in the second that wasn't in the first is reported as leaked,
+ * so take the second after fetching the result.
+ */
+
+void heap_stats_print (const struct heap_stats *before,
+	const struct heap_stats *after)
+{
+	int64_t leaked, leaked_blocks;
+	int i;
+
+	fprintf(stderr, "heap: peak %llu bytes, live %llu bytes in %llu blocks\n",
+		(unsigned long long) after->peak_bytes,
+		(unsigned long long) after->live_bytes,
+		(unsigned long long) after->live_blocks);
+	fprintf(stderr, "heap: %llu allocs, %llu reallocs, %llu frees, "
+		"%llu failures\n",
+		(unsigned long long) after->allocs,
+		(unsigned long long) after->reallocs,
+		(unsigned long long) after->frees,
+		(unsigned long long) after->failures);
+
+	for (i= 0; i< HEAP_SIZE_CLASSES; ++i) {
+		uint64_t n= after->size_class[i];
+
+		if ( n == 0 ) continue;
+
+		if ( i == HEAP_SIZE_CLASSES-1 ) {
+			fprintf(stderr, "heap: %12llu of %llu+ bytes\n",
+				(unsigned long long) n, 1ULL<<(i-1));
+		} else {
+			fprintf(stderr, "heap: %12llu of %llu-%llu bytes\n",
+				(unsigned long long) n,
+				( i ) ? 1ULL<<(i-1) : 0ULL, ( 1ULL<<i )-1);
+		}
+	}
+
+	if ( after->kept_bytes ) {
+		fprintf(stderr, "heap: %llu bytes in %llu blocks kept for reuse\n",
+			(unsigned long long) after->kept_bytes,
+			(unsigned long long) after->kept_blocks);
+	}
+
+	/* Growth in the scratch pools or the result cache isn't a leak. */
+
+	leaked= (int64_t) (after->live_bytes-before->live_bytes)-
+		(int64_t) (after->kept_bytes-before->kept_bytes);
+	leaked_blocks= (int64_t) (after->live_blocks-before->live_blocks)-
+		(int64_t) (after->kept_blocks-before->kept_blocks);
+
+	if ( leaked > 0 || leaked_blocks > 0 ) {
+		fprintf(stderr, "heap: leaked %lld bytes in %lld blocks\n",
+			(long long) leaked, (long long) leaked_blocks);
+	}
+}
+
+/* Summarize the result cache, to stderr. */
+
+void memo_stats_print (const struct memo_stats *ms)
+{
+	uint64_t lookups= ms->hits+ms->misses;
+
+	fprintf(stderr, "cache: %llu hits, %llu misses (%.1f%% hit), "
+		"%llu inserts, %llu evictions\n",
+		(unsigned long long) ms->hits, (unsigned long long) ms->misses,
+		( lookups ) ? 100.0*(double) ms->hits/(double) lookups : 0.0,
+		(unsigned long long) ms->inserts,
+		(unsigned long long) ms->evictions);
+	fprintf(stderr, "cache: %llu entries, %llu of %llu bytes\n",
+		(unsigned long long) ms->entries, (unsigned long long) ms->bytes,
+		(unsigned long long) ms->max_bytes);
+}
+
+void spill_stats_print (const struct spill_stats *ss)
+{
+	fprintf(stderr, "spill: %llu spilled (%llu bytes), %llu reloaded "
+		"(%llu bytes), %llu failed\n",
+		(unsigned long long) ss->spills,
+		(unsigned long long) ss->spill_bytes,
+		(unsigned long long) ss->reloads,
+		(unsigned long long) ss->reload_bytes,
+		(unsigned long long) ss->failures);
+	fprintf(stderr, "spill: peak %llu bytes outside, %llu now\n",
+		(unsigned long long) ss->peak_bytes,
+		(unsigned long long) ss->live_bytes);
+}
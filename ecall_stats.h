@@ -0,0 +1,177 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __ECALL_STATS__H
+#define __ECALL_STATS__H
+
+#include <stdint.h>
+
+/*
+ * Per-ECALL counters kept inside the enclave and fetched with
+ * e_get_stats(). The result is an array of STATS_NECALLS records,
+ * indexed by the ids below.
+ *
+ * Histogram bucket i counts values v with 2^(i-1) <= v < 2^i (bucket 0
+ * is v == 0), and the last bucket also takes anything larger. Latency
+ * is in nanoseconds and operand size is the bytes passed in.
+ */
+
+enum {
+	STATS_MPZ_ADD= 0,
+	STATS_MPZ_MUL,
+	STATS_MPZ_DIV,
+	STATS_MPF_DIV,
+	STATS_PI,
+	STATS_GET_RESULT,
+	STATS_JOB_FINISH,
+	STATS_MULTI_EXP,
+	STATS_MPQ_ADD,
+	STATS_MPQ_SUB,
+	STATS_MPQ_MUL,
+	STATS_MPQ_DIV,
+	STATS_MPQ_CANONICALIZE,
+	STATS_MPQ_CMP,
+	STATS_FIXED_ADD,
+	STATS_FIXED_SUB,
+	STATS_FIXED_MUL,
+	STATS_MPZ_OPS,
+	STATS_LUCAS,
+	STATS_NECALLS
+};
+
+/*
+ * Counter levels for e_stats_enable(). Timing costs an OCALL to the
+ * host clock at each end of a call, which dwarfs the cheapest ECALLs,
+ * so it can be left off while still counting calls and bytes.
+ */
+
+#define STATS_OFF	0
+#define STATS_COUNT	1
+#define STATS_TIME	2
+
+/* Passed as the thread to e_get_stats() for the total of all threads */
+
+#define STATS_ALL_THREADS	-1
+
+#define STATS_LAT_BUCKETS	48
+#define STATS_SIZE_BUCKETS	40
+
+struct ecall_stats {
+	uint64_t calls;
+	uint64_t ns;
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	uint64_t lat_hist[STATS_LAT_BUCKETS];
+	uint64_t size_hist[STATS_SIZE_BUCKETS];
+};
+
+/*
+ * Enclave heap use, from the GMP memory hooks, fetched with
+ * e_heap_stats(). Only memory allocated through GMP is counted, which
+ * includes serialized results but not the buffers edger8r allocates
+ * for ECALL parameters. Size class i counts allocations (and
+ * reallocations) of 2^(i-1) to 2^i-1 bytes, as in the histograms
+ * above.
+ *
+ * Memory kept for reuse, by the scratch pools and the result cache, is
+ * counted as live, and also in kept_bytes and kept_blocks, so that it
+ * can be told apart from a leak.
+ *
+ * Resetting zeroes the counters and sets the peak to the current live
+ * size. Live bytes and blocks are never reset, since they describe
+ * memory that is still allocated.
+ */
+
+#define HEAP_SIZE_CLASSES	32
+
+struct heap_stats {
+	uint64_t live_bytes;
+	uint64_t live_blocks;
+	uint64_t peak_bytes;
+	uint64_t allocs;
+	uint64_t reallocs;
+	uint64_t frees;
+	uint64_t failures;
+	uint64_t kept_bytes;
+	uint64_t kept_blocks;
+	uint64_t size_class[HEAP_SIZE_CLASSES];
+};
+
+/*
+ * The result cache, fetched with e_memo_stats(). bytes counts the
+ * entries' keys and results, which must fit in max_bytes; max_bytes
+ * of 0 means the cache is off. Resetting zeroes the four counters.
+ */
+
+struct memo_stats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t inserts;
+	uint64_t evictions;
+	uint64_t entries;
+	uint64_t bytes;
+	uint64_t max_bytes;
+};
+
+/*
+ * Spilling to untrusted memory, fetched with e_spill_stats(). Integers
+ * of at least min_bytes are spilled; min_bytes of 0 means spilling is
+ * off. The byte counts are of ciphertext, which is the size of the
+ * integer. failures counts values that couldn't be reloaded. Resetting
+ * zeroes everything but the live bytes, and sets the peak to them.
+ */
+
+struct spill_stats {
+	uint64_t spills;
+	uint64_t reloads;
+	uint64_t spill_bytes;
+	uint64_t reload_bytes;
+	uint64_t failures;
+	uint64_t live_bytes;
+	uint64_t peak_bytes;
+	uint64_t min_bytes;
+};
+
+/* Host-side helpers, in ecall_stats.c */
+
+const char *ecall_stats_name (int ecall);
+uint64_t ecall_stats_percentile (const uint64_t *hist, int nbuckets,
+	double p);
+void ecall_stats_print (const struct ecall_stats *stats);
+struct backend;
+
+int heap_snapshot (struct backend *be, struct heap_stats *hs, int reset);
+void heap_stats_print (const struct heap_stats *before,
+	const struct heap_stats *after);
+void memo_stats_print (const struct memo_stats *ms);
+void spill_stats_print (const struct spill_stats *ss);
+
+#endif
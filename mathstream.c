@@ -0,0 +1,856 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <gmp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "mathstream.h"
+#include "serialize.h"
+#include "workers.h"
+
+/*
+ * The stages of a batch, in order. A slot is either free, or holds a
+ * batch that is in a stage or waiting for the next one.
+ */
+
+#define SLOT_FREE	0
+#define SLOT_PARSING	1
+#define SLOT_PARSED	2
+#define SLOT_COMPUTING	3
+#define SLOT_COMPUTED	4
+#define SLOT_FORMATTING	5
+#define SLOT_READY	6
+
+/* How each operation in a batch fared */
+
+#define REC_OK		0
+#define REC_SKIP	1	/* A blank line or a comment */
+#define REC_BAD		2
+#define REC_ZERO	3
+
+#define OUT_BUFSIZE	(1024*1024)
+
+/* A batch, and the buffers that every batch in this slot reuses */
+
+struct slot {
+	int state;
+	uint64_t seq;
+	const unsigned char *start, *end;
+	mpz_t *vals;
+	size_t nvals;
+	unsigned char *recs;	/* REC_ for each operation */
+	size_t recs_size, nrecs;
+	unsigned char *ops;	/* MPZ_OP_ for each one sent */
+	size_t ops_size, k;
+	unsigned char *in, *res;
+	size_t in_size, res_size;
+	size_t in_len, bound, res_len;
+	char *tok;
+	size_t tok_size;
+	char *out;
+	size_t out_size, out_len;
+	unsigned long long nops, nerrors;
+};
+
+struct stream {
+	struct backend *be;
+	const unsigned char *cursor, *end;
+	const unsigned char *bad;	/* Where binary input went wrong */
+	int binary;
+	size_t batch;
+	struct slot *slots;
+	int nslots;
+	uint64_t next_seq;	/* Batches claimed so far */
+	uint64_t computed;	/* ... and through each later stage */
+	uint64_t formatted;
+	int claimed_all;
+	int failed;
+	uint64_t ecall_ns;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;	/* Any slot changed state */
+};
+
+struct stage {
+	struct stream *st;
+	void *(*run)(void *);
+	pthread_t thread;
+};
+
+static const char *op_names[MPZ_NOPS]= { "add", "sub", "mul", "div" };
+
+static void *worker (void *arg);
+static void *parser (void *arg);
+static void *enclave (void *arg);
+static void *formatter (void *arg);
+static struct slot *claim (struct stream *st);
+static struct slot *take (struct stream *st, int from, uint64_t *passed);
+static void finish (struct stream *st, struct slot *s, int ok, int to,
+	uint64_t *passed);
+static const unsigned char *scan_text (struct stream *st);
+static const unsigned char *scan_binary (struct stream *st);
+static int parse (struct stream *st, struct slot *s);
+static int parse_text (struct slot *s);
+static int parse_line (struct slot *s, const unsigned char *p,
+	const unsigned char *eol);
+static int parse_binary (struct slot *s);
+static int compute (struct stream *st, struct slot *s);
+static int format (struct stream *st, struct slot *s);
+static int format_text (struct slot *s);
+static int format_binary (struct slot *s);
+static void slot_free (struct slot *s);
+static int append (struct slot *s, const void *buf, size_t len);
+static int grow (void *pp, size_t *size, size_t need);
+static int grow_vals (struct slot *s, size_t n);
+static void put32 (unsigned char *p, uint32_t v);
+static uint32_t get32 (const unsigned char *p);
+static uint64_t now_ns ();
+
+int mathstream_run (struct backend *be, const char *input,
+	const char *output, int threads, size_t batch, int pipeline)
+{
+	struct stream st;
+	struct stage *stages= NULL;
+	struct stat sb;
+	unsigned char *data= NULL;
+	unsigned long long nops= 0, nerrors= 0;
+	uint64_t seq, start;
+	FILE *out= NULL;
+	double secs;
+	int fd, i, nstages= 0, started= 0, rv= 1;
+
+	memset(&st, 0, sizeof(st));
+	st.be= be;
+	st.batch= ( batch ) ? batch : MATHSTREAM_BATCH;
+	pthread_mutex_init(&st.lock, NULL);
+	pthread_cond_init(&st.changed, NULL);
+
+	fd= open(input, O_RDONLY);
+	if ( fd == -1 || fstat(fd, &sb) == -1 ) {
+		perror(input);
+		goto cleanup;
+	}
+
+	if ( sb.st_size > 0 ) {
+		data= mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if ( data == MAP_FAILED ) {
+			data= NULL;
+			perror("mmap");
+			goto cleanup;
+		}
+		madvise(data, sb.st_size, MADV_SEQUENTIAL);
+	}
+
+	st.cursor= data;
+	st.end= data+sb.st_size;
+
+	if ( sb.st_size >= MATHSTREAM_MAGIC_LEN &&
+		memcmp(data, MATHSTREAM_MAGIC_IN, MATHSTREAM_MAGIC_LEN) == 0 )
+	{
+		st.binary= 1;
+		st.cursor+= MATHSTREAM_MAGIC_LEN;
+	}
+
+	st.claimed_all= ( st.cursor >= st.end );
+
+	out= ( output == NULL ) ? stdout : fopen(output, "w");
+	if ( out == NULL ) {
+		perror(output);
+		goto cleanup;
+	}
+	setvbuf(out, NULL, _IOFBF, OUT_BUFSIZE);
+
+	if ( st.binary &&
+		fwrite(MATHSTREAM_MAGIC_OUT, MATHSTREAM_MAGIC_LEN, 1, out) != 1 )
+	{
+		perror(( output == NULL ) ? "stdout" : output);
+		goto cleanup;
+	}
+
+	/*
+	 * Two slots for each thread, so that each can have a batch queued
+	 * behind the one it's working on.
+	 */
+
+	threads= enclave_threads(threads);
+	nstages= ( pipeline ) ? 2*threads+1 : threads;
+	st.nslots= 2*nstages;
+	st.slots= calloc(st.nslots, sizeof(struct slot));
+	stages= calloc(nstages, sizeof(struct stage));
+	if ( st.slots == NULL || stages == NULL ) {
+		perror("calloc");
+		goto cleanup;
+	}
+
+	for (i= 0; i< nstages; ++i) {
+		stages[i].st= &st;
+		if ( ! pipeline ) stages[i].run= worker;
+		else if ( i == 0 ) stages[i].run= enclave;
+		else stages[i].run= ( i%2 ) ? parser : formatter;
+	}
+
+	start= now_ns();
+
+	for (i= 0; i< nstages; ++i) {
+		if ( pthread_create(&stages[i].thread, NULL, stages[i].run,
+			&stages[i]) )
+		{
+			break;
+		}
+		++started;
+	}
+	/* Each pipeline stage needs its thread; workers can manage with fewer. */
+
+	if ( started == 0 || ( pipeline && started < nstages ) ) {
+		fprintf(stderr, "could not start a thread\n");
+		pthread_mutex_lock(&st.lock);
+		st.failed= 1;
+		pthread_cond_broadcast(&st.changed);
+		pthread_mutex_unlock(&st.lock);
+	}
+
+	/* Write the batches out in order as they finish. */
+
+	pthread_mutex_lock(&st.lock);
+	for (seq= 0; ; ++seq) {
+		struct slot *s= &st.slots[seq%st.nslots];
+		size_t n;
+
+		while ( ! st.failed && ! ( s->state == SLOT_READY && s->seq == seq ) &&
+			! ( st.claimed_all && seq == st.next_seq ) )
+		{
+			pthread_cond_wait(&st.changed, &st.lock);
+		}
+		if ( st.failed || s->state != SLOT_READY || s->seq != seq ) break;
+
+		pthread_mutex_unlock(&st.lock);
+		n= fwrite(s->out, 1, s->out_len, out);
+		pthread_mutex_lock(&st.lock);
+
+		if ( n != s->out_len ) {
+			perror(( output == NULL ) ? "stdout" : output);
+			st.failed= 1;
+		}
+
+		nops+= s->nops;
+		nerrors+= s->nerrors;
+
+		s->state= SLOT_FREE;
+		pthread_cond_broadcast(&st.changed);
+	}
+	pthread_mutex_unlock(&st.lock);
+
+	for (i= 0; i< started; ++i) pthread_join(stages[i].thread, NULL);
+
+	if ( fflush(out) == EOF ) {
+		perror(( output == NULL ) ? "stdout" : output);
+		st.failed= 1;
+	}
+
+	secs= (double) (now_ns()-start)/1e9;
+
+	fprintf(stderr, "%llu operations, %llu errors, %.3f s, %.0f operations/s\n",
+		nops, nerrors, secs, ( secs > 0 ) ? (double) nops/secs : 0.0);
+
+	/* With one thread making every ECALL, this shows how well it's fed. */
+
+	if ( pipeline && secs > 0 ) {
+		fprintf(stderr, "enclave busy %.1f%% of the time\n",
+			100.0*(double) st.ecall_ns/1e9/secs);
+	}
+
+	if ( st.bad != NULL ) {
+		fprintf(stderr, "%s: bad record at offset %lld\n", input,
+			(long long) (st.bad-data));
+	}
+
+	rv= ( st.failed || st.bad != NULL ) ? 1 : 0;
+
+cleanup:
+	free(stages);
+	if ( st.slots != NULL ) {
+		for (i= 0; i< st.nslots; ++i) slot_free(&st.slots[i]);
+		free(st.slots);
+	}
+	if ( out != NULL && out != stdout && fclose(out) == EOF ) {
+		perror(output);
+		rv= 1;
+	}
+	if ( data != NULL ) munmap(data, sb.st_size);
+	if ( fd != -1 ) close(fd);
+
+	pthread_mutex_destroy(&st.lock);
+	pthread_cond_destroy(&st.changed);
+
+	return rv;
+}
+
+/* Take each batch through every stage. */
+
+static void *worker (void *arg)
+{
+	struct stream *st= ((struct stage *) arg)->st;
+	struct slot *s;
+	int ok;
+
+	while ( (s= claim(st)) != NULL ) {
+		ok= parse(st, s) && compute(st, s) && format(st, s);
+		finish(st, s, ok, SLOT_READY, NULL);
+	}
+
+	return NULL;
+}
+
+/* The pipeline stages */
+
+static void *parser (void *arg)
+{
+	struct stream *st= ((struct stage *) arg)->st;
+	struct slot *s;
+
+	while ( (s= claim(st)) != NULL )
+		finish(st, s, parse(st, s), SLOT_PARSED, NULL);
+
+	return NULL;
+}
+
+static void *enclave (void *arg)
+{
+	struct stream *st= ((struct stage *) arg)->st;
+	struct slot *s;
+
+	while ( (s= take(st, SLOT_PARSED, &st->computed)) != NULL )
+		finish(st, s, compute(st, s), SLOT_COMPUTED, &st->computed);
+
+	return NULL;
+}
+
+static void *formatter (void *arg)
+{
+	struct stream *st= ((struct stage *) arg)->st;
+	struct slot *s;
+
+	while ( (s= take(st, SLOT_COMPUTED, &st->formatted)) != NULL )
+		finish(st, s, format(st, s), SLOT_READY, &st->formatted);
+
+	return NULL;
+}
+
+/*
+ * Take the next batch of input. Batches are numbered as they are
+ * claimed, and batch n goes in slot n%nslots, so a parser that gets
+ * ahead of the writer waits for that slot to be written out.
+ */
+
+static struct slot *claim (struct stream *st)
+{
+	struct slot *s= NULL;
+
+	pthread_mutex_lock(&st->lock);
+
+	while ( ! st->failed && ! st->claimed_all ) {
+		s= &st->slots[st->next_seq%st->nslots];
+		if ( s->state == SLOT_FREE ) break;
+		pthread_cond_wait(&st->changed, &st->lock);
+	}
+
+	if ( st->failed || st->claimed_all ) {
+		pthread_mutex_unlock(&st->lock);
+		return NULL;
+	}
+
+	s->start= st->cursor;
+	st->cursor= ( st->binary ) ? scan_binary(st) : scan_text(st);
+	s->end= st->cursor;
+	s->seq= st->next_seq++;
+	s->state= SLOT_PARSING;
+
+	if ( st->cursor >= st->end ) {
+		st->claimed_all= 1;
+		pthread_cond_broadcast(&st->changed);
+	}
+
+	pthread_mutex_unlock(&st->lock);
+
+	return s;
+}
+
+/*
+ * Wait for the oldest batch that has finished the stage before, and
+ * move it into this one. Returns NULL once every batch has been
+ * through this stage, counted by passed, or something has failed.
+ */
+
+static struct slot *take (struct stream *st, int from, uint64_t *passed)
+{
+	struct slot *s;
+	int i;
+
+	pthread_mutex_lock(&st->lock);
+
+	for (;;) {
+		s= NULL;
+		if ( st->failed ) break;
+
+		for (i= 0; i< st->nslots; ++i) {
+			struct slot *c= &st->slots[i];
+
+			if ( c->state == from && ( s == NULL || c->seq < s->seq ) )
+				s= c;
+		}
+		if ( s != NULL ) {
+			s->state= from+1;
+			break;
+		}
+
+		if ( st->claimed_all && *passed == st->next_seq ) break;
+
+		pthread_cond_wait(&st->changed, &st->lock);
+	}
+
+	pthread_mutex_unlock(&st->lock);
+
+	return s;
+}
+
+static void finish (struct stream *st, struct slot *s, int ok, int to,
+	uint64_t *passed)
+{
+	pthread_mutex_lock(&st->lock);
+	if ( ok ) {
+		s->state= to;
+		if ( passed != NULL ) ++(*passed);
+	} else {
+		st->failed= 1;
+	}
+	pthread_cond_broadcast(&st->changed);
+	pthread_mutex_unlock(&st->lock);
+}
+
+/* Find the end of the next batch, without parsing anything. */
+
+static const unsigned char *scan_text (struct stream *st)
+{
+	const unsigned char *p= st->cursor, *eol;
+	size_t i;
+
+	for (i= 0; i< st->batch && p < st->end; ++i) {
+		eol= memchr(p, '\n', st->end-p);
+		p= ( eol == NULL ) ? st->end : eol+1;
+	}
+
+	return p;
+}
+
+/*
+ * Binary records have to be walked to be found, and a bad length
+ * leaves no way to find the next one, so the input ends there.
+ */
+
+static const unsigned char *scan_binary (struct stream *st)
+{
+	const unsigned char *p= st->cursor, *q;
+	size_t i;
+	int j;
+
+	for (i= 0; i< st->batch && p < st->end; ++i) {
+		if ( (size_t) (st->end-p) < 4 ) goto bad;
+		q= p+4;
+
+		for (j= 0; j< 2; ++j) {
+			size_t nbytes;
+
+			if ( (size_t) (st->end-q) < BATCH_REC_LEN ) goto bad;
+			nbytes= get32(q);
+			q+= BATCH_REC_LEN;
+			if ( (size_t) (st->end-q) < nbytes ) goto bad;
+			q+= nbytes;
+		}
+
+		p= q;
+	}
+
+	return p;
+
+bad:
+	st->bad= p;
+	st->end= p;
+
+	return p;
+}
+
+/*
+ * Parse a batch into the operations to send, ops and in, with the
+ * most room their results can need in bound.
+ */
+
+static int parse (struct stream *st, struct slot *s)
+{
+	s->nrecs= s->k= 0;
+	s->nops= s->nerrors= 0;
+	s->bound= BATCH_HDR_LEN;
+	s->out_len= 0;
+
+	return ( st->binary ) ? parse_binary(s) : parse_text(s);
+}
+
+static int parse_text (struct slot *s)
+{
+	const unsigned char *p= s->start, *eol;
+
+	while ( p < s->end ) {
+		eol= memchr(p, '\n', s->end-p);
+		if ( eol == NULL ) eol= s->end;
+
+		if ( ! grow(&s->recs, &s->recs_size, s->nrecs+1) ||
+			! grow(&s->ops, &s->ops_size, s->k+1) ||
+			! grow_vals(s, 2*(s->k+1)) )
+		{
+			return 0;
+		}
+
+		s->recs[s->nrecs]= parse_line(s, p, eol);
+		if ( s->recs[s->nrecs] == REC_OK ) ++s->k;
+		++s->nrecs;
+
+		p= ( eol == s->end ) ? s->end : eol+1;
+	}
+
+	if ( ! grow(&s->in, &s->in_size, mpz_batch_size(s->vals, 2*s->k)) )
+		return 0;
+	s->in_len= mpz_batch_write(s->in, s->in_size, s->vals, 2*s->k);
+
+	return ( s->in_len != 0 );
+}
+
+/* Parse "op a b" into operation k. */
+
+static int parse_line (struct slot *s, const unsigned char *p,
+	const unsigned char *eol)
+{
+	const unsigned char *f[4];
+	size_t flen[4], k= s->k;
+	int nf, op, j;
+
+	for (nf= 0; nf< 4; ++nf) {
+		while ( p < eol && ( *p == ' ' || *p == '\t' || *p == '\r' ) ) ++p;
+		if ( p == eol ) break;
+
+		f[nf]= p;
+		while ( p < eol && *p != ' ' && *p != '\t' && *p != '\r' ) ++p;
+		flen[nf]= p-f[nf];
+	}
+
+	if ( nf == 0 || *f[0] == '#' ) return REC_SKIP;
+
+	++s->nops;
+
+	if ( nf != 3 ) goto bad;
+
+	for (op= 0; op< MPZ_NOPS; ++op) {
+		if ( flen[0] == strlen(op_names[op]) &&
+			memcmp(f[0], op_names[op], flen[0]) == 0 )
+		{
+			break;
+		}
+	}
+	if ( op == MPZ_NOPS ) goto bad;
+
+	for (j= 1; j< 3; ++j) {
+		if ( ! grow(&s->tok, &s->tok_size, flen[j]+1) ) goto bad;
+		memcpy(s->tok, f[j], flen[j]);
+		s->tok[flen[j]]= '\0';
+
+		if ( mpz_set_str(s->vals[2*k+j-1], s->tok, 10) == -1 ) goto bad;
+	}
+
+	if ( op == MPZ_OP_DIV && mpz_sgn(s->vals[2*k+1]) == 0 ) {
+		++s->nerrors;
+		return REC_ZERO;
+	}
+
+	s->ops[k]= op;
+	s->bound+= BATCH_REC_LEN+1+(mpz_sizeinbase(s->vals[2*k], 2)+7)/8+
+		(mpz_sizeinbase(s->vals[2*k+1], 2)+7)/8;
+
+	return REC_OK;
+
+bad:
+	++s->nerrors;
+	return REC_BAD;
+}
+
+/* Binary operands are already in batch form, so they are just copied. */
+
+static int parse_binary (struct slot *s)
+{
+	const unsigned char *p= s->start;
+
+	s->in_len= BATCH_HDR_LEN;
+	if ( ! grow(&s->in, &s->in_size, BATCH_HDR_LEN) ) return 0;
+
+	while ( p < s->end ) {
+		uint32_t op= get32(p);
+		const unsigned char *a= p+4, *b, *next;
+		size_t na, nb, j;
+		int rec= REC_OK;
+
+		na= get32(a);
+		b= a+BATCH_REC_LEN+na;
+		nb= get32(b);
+		next= b+BATCH_REC_LEN+nb;
+
+		if ( ! grow(&s->recs, &s->recs_size, s->nrecs+1) ||
+			! grow(&s->ops, &s->ops_size, s->k+1) ||
+			! grow(&s->in, &s->in_size, s->in_len+(next-a)) )
+		{
+			return 0;
+		}
+
+		++s->nops;
+
+		if ( op >= MPZ_NOPS ) {
+			rec= REC_BAD;
+		} else if ( op == MPZ_OP_DIV ) {
+			for (j= 0; j< nb && b[BATCH_REC_LEN+j] == 0; ++j);
+			if ( j == nb ) rec= REC_ZERO;
+		}
+
+		if ( rec == REC_OK ) {
+			s->ops[s->k++]= (unsigned char) op;
+			memcpy(s->in+s->in_len, a, next-a);
+			s->in_len+= next-a;
+			s->bound+= BATCH_REC_LEN+1+na+nb;
+		} else {
+			++s->nerrors;
+		}
+
+		s->recs[s->nrecs++]= rec;
+		p= next;
+	}
+
+	put32(s->in, (uint32_t) (2*s->k));
+
+	return 1;
+}
+
+static int compute (struct stream *st, struct slot *s)
+{
+	struct backend *be= st->be;
+	sgx_status_t status;
+	uint64_t start;
+
+	s->res_len= 0;
+	if ( s->k == 0 ) return 1;
+
+	if ( ! grow(&s->res, &s->res_size, s->bound) ) return 0;
+
+	start= now_ns();
+	status= be->e_mpz_ops(be->eid, &s->res_len, s->ops, s->k, s->in,
+		s->in_len, s->res, s->bound);
+	__sync_fetch_and_add(&st->ecall_ns, now_ns()-start);
+
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_mpz_ops: 0x%04x\n", status);
+		return 0;
+	}
+	if ( s->res_len == 0 ) {
+		fprintf(stderr, "e_mpz_ops: batch failed\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+static int format (struct stream *st, struct slot *s)
+{
+	return ( st->binary ) ? format_binary(s) : format_text(s);
+}
+
+static int format_text (struct slot *s)
+{
+	size_t i, k= 0;
+
+	if ( s->k && mpz_batch_deserialize(s->vals, s->k, s->res,
+		s->res_len) == -1 )
+	{
+		fprintf(stderr, "e_mpz_ops: bad result\n");
+		return 0;
+	}
+
+	for (i= 0; i< s->nrecs; ++i) {
+		size_t len;
+
+		switch (s->recs[i]) {
+		case REC_SKIP:
+			continue;
+		case REC_BAD:
+			if ( ! append(s, "error: bad operation\n", 21) ) return 0;
+			continue;
+		case REC_ZERO:
+			if ( ! append(s, "error: division by zero\n", 24) ) return 0;
+			continue;
+		}
+
+		/* Room for the sign, the digits and a newline */
+
+		len= mpz_sizeinbase(s->vals[k], 10)+2;
+		if ( ! grow(&s->out, &s->out_size, s->out_len+len+1) ) return 0;
+		mpz_get_str(s->out+s->out_len, 10, s->vals[k]);
+		s->out_len+= strlen(s->out+s->out_len);
+		s->out[s->out_len++]= '\n';
+		++k;
+	}
+
+	return 1;
+}
+
+static int format_binary (struct slot *s)
+{
+	const unsigned char *r= s->res+BATCH_HDR_LEN;
+	unsigned char err[BATCH_REC_LEN];
+	size_t i;
+
+	put32(err, 0);
+	put32(err+4, MATHSTREAM_ERROR);
+
+	for (i= 0; i< s->nrecs; ++i) {
+		size_t len;
+
+		if ( s->recs[i] != REC_OK ) {
+			if ( ! append(s, err, BATCH_REC_LEN) ) return 0;
+			continue;
+		}
+
+		len= BATCH_REC_LEN+get32(r);
+		if ( ! append(s, r, len) ) return 0;
+		r+= len;
+	}
+
+	return 1;
+}
+
+static void slot_free (struct slot *s)
+{
+	size_t i;
+
+	for (i= 0; i< s->nvals; ++i) mpz_clear(s->vals[i]);
+	free(s->vals);
+	free(s->recs);
+	free(s->ops);
+	free(s->in);
+	free(s->res);
+	free(s->tok);
+	free(s->out);
+}
+
+static int append (struct slot *s, const void *buf, size_t len)
+{
+	if ( ! grow(&s->out, &s->out_size, s->out_len+len) ) return 0;
+
+	memcpy(s->out+s->out_len, buf, len);
+	s->out_len+= len;
+
+	return 1;
+}
+
+/* Make *pp at least need bytes, at least doubling it. */
+
+static int grow (void *pp, size_t *size, size_t need)
+{
+	void *p;
+
+	if ( need <= *size ) return 1;
+	if ( need < 2*(*size) ) need= 2*(*size);
+
+	p= realloc(*(void **) pp, need);
+	if ( p == NULL ) {
+		perror("realloc");
+		return 0;
+	}
+
+	*(void **) pp= p;
+	*size= need;
+
+	return 1;
+}
+
+static int grow_vals (struct slot *s, size_t n)
+{
+	mpz_t *vals;
+	size_t i;
+
+	if ( n <= s->nvals ) return 1;
+	if ( n < 2*s->nvals ) n= 2*s->nvals;
+
+	vals= realloc(s->vals, n*sizeof(mpz_t));
+	if ( vals == NULL ) {
+		perror("realloc");
+		return 0;
+	}
+
+	for (i= s->nvals; i< n; ++i) mpz_init(vals[i]);
+
+	s->vals= vals;
+	s->nvals= n;
+
+	return 1;
+}
+
+static void put32 (unsigned char *p, uint32_t v)
+{
+	p[0]= v&0xff;
+	p[1]= (v>>8)&0xff;
+	p[2]= (v>>16)&0xff;
+	p[3]= (v>>24)&0xff;
+}
+
+static uint32_t get32 (const unsigned char *p)
+{
+	return (uint32_t) p[0] | ((uint32_t) p[1]<<8) | ((uint32_t) p[2]<<16) |
+		((uint32_t) p[3]<<24);
+}
+
+static uint64_t now_ns ()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
@@ -0,0 +1,94 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __MATHSTREAM_H
+#define __MATHSTREAM_H
+
+#include <stddef.h>
+#include "backend.h"
+
+/*
+ * Streaming mode for sgxgmpmath: a file of integer operations in, a
+ * file of results out, one result per operation and in the same order.
+ *
+ * Text input has one operation per line, an operator (add, sub, mul
+ * or div) and two base 10 integers separated by blanks. Blank lines
+ * and lines starting with '#' are skipped. Each result is a line with
+ * the base 10 result, or "error: " and the reason.
+ *
+ * Binary input starts with MATHSTREAM_MAGIC_IN. Each operation is a
+ * little-endian uint32 MPZ_OP_ code followed by its operands as two
+ * batch records (see serialize.h). The output starts with
+ * MATHSTREAM_MAGIC_OUT and has a batch record for each result, with
+ * MATHSTREAM_ERROR set in the flags and no magnitude if the operation
+ * failed.
+ *
+ * The input is mapped rather than read, and goes through in batches.
+ * Each batch is parsed, sent through e_mpz_ops, formatted, and written
+ * out in order by the calling thread. The batches live in a small pool
+ * of slots, each with its own buffers, which are reused from batch to
+ * batch instead of being allocated per call.
+ *
+ * By default, worker threads each take a batch through every stage
+ * themselves, so batches overlap with each other. With pipeline set,
+ * each stage has its own threads instead: one thread makes all of the
+ * ECALLs, one after the other, while the others parse the batches
+ * after it and format the ones before it. That hides the host's work
+ * behind the enclave's, which matters most when ECALLs can't run side
+ * by side.
+ */
+
+#define MATHSTREAM_MAGIC_IN	"SGXGMPOP"
+#define MATHSTREAM_MAGIC_OUT	"SGXGMPRS"
+#define MATHSTREAM_MAGIC_LEN	8
+
+#define MATHSTREAM_ERROR	0x2
+
+#define MATHSTREAM_BATCH	4096
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * output NULL means stdout. threads 0 means one per CPU, and with
+ * pipeline set is the number of threads parsing and the number
+ * formatting. batch 0 means MATHSTREAM_BATCH. Returns 0 on success.
+ */
+
+int mathstream_run (struct backend *be, const char *input,
+	const char *output, int threads, size_t batch, int pipeline);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,167 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdio.h>
+#ifdef HAVE_LIBCRYPTO
+#include <openssl/evp.h>
+#endif
+#include "sgx_trts.h"
+#include "sgx_tcrypto.h"
+
+/*
+ * The enclave code's GMP memory hooks are the whole process's here, so
+ * they only do their accounting for threads inside a native ECALL. The
+ * wrappers in backend.c keep the count; the host's own GMP use goes
+ * straight to the allocator it had.
+ */
+
+__thread int native_depth= 0;
+
+void native_enter ()
+{
+	++native_depth;
+}
+
+void native_leave ()
+{
+	--native_depth;
+}
+
+int sgx_is_within_enclave (const void *addr, size_t size)
+{
+	return 1;
+}
+
+int sgx_is_outside_enclave (const void *addr, size_t size)
+{
+	return 1;
+}
+
+sgx_status_t sgx_read_rand (unsigned char *rand, size_t length_in_bytes)
+{
+	FILE *fp;
+	size_t n;
+
+	if ( rand == NULL ) return SGX_ERROR_INVALID_PARAMETER;
+
+	fp= fopen("/dev/urandom", "r");
+	if ( fp == NULL ) return SGX_ERROR_UNEXPECTED;
+
+	n= fread(rand, 1, length_in_bytes, fp);
+	fclose(fp);
+
+	return ( n == length_in_bytes ) ? SGX_SUCCESS : SGX_ERROR_UNEXPECTED;
+}
+
+/*
+ * AES-GCM with OpenSSL, with the SDK's interface: a 128-bit key and
+ * tag, and in-place operation allowed. Decryption fails with
+ * SGX_ERROR_MAC_MISMATCH if the tag doesn't match. If configure didn't
+ * find libcrypto, both directions fail, and nothing is spilled.
+ */
+
+#ifndef HAVE_LIBCRYPTO
+
+static sgx_status_t aes_gcm (int enc, const sgx_aes_gcm_128bit_key_t *key,
+	const uint8_t *src, uint32_t len, uint8_t *dst, const uint8_t *iv,
+	uint32_t iv_len, const uint8_t *aad, uint32_t aad_len, uint8_t *mac)
+{
+	return SGX_ERROR_UNEXPECTED;
+}
+
+#else
+
+static sgx_status_t aes_gcm (int enc, const sgx_aes_gcm_128bit_key_t *key,
+	const uint8_t *src, uint32_t len, uint8_t *dst, const uint8_t *iv,
+	uint32_t iv_len, const uint8_t *aad, uint32_t aad_len, uint8_t *mac)
+{
+	EVP_CIPHER_CTX *ctx;
+	sgx_status_t status= SGX_ERROR_UNEXPECTED;
+	int n;
+
+	if ( key == NULL || iv == NULL || iv_len == 0 || mac == NULL ||
+		(len && (src == NULL || dst == NULL)) ||
+		(aad_len && aad == NULL) ) return SGX_ERROR_INVALID_PARAMETER;
+
+	ctx= EVP_CIPHER_CTX_new();
+	if ( ctx == NULL ) return SGX_ERROR_OUT_OF_MEMORY;
+
+	if ( ! EVP_CipherInit_ex(ctx, EVP_aes_128_gcm(), NULL, NULL, NULL,
+		enc) ) goto done;
+	if ( ! EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv_len, NULL) )
+		goto done;
+	if ( ! EVP_CipherInit_ex(ctx, NULL, NULL, *key, iv, enc) ) goto done;
+	if ( aad_len && ! EVP_CipherUpdate(ctx, NULL, &n, aad, aad_len) )
+		goto done;
+	if ( len && ! EVP_CipherUpdate(ctx, dst, &n, src, len) ) goto done;
+
+	if ( enc ) {
+		if ( ! EVP_CipherFinal_ex(ctx, dst+len, &n) ) goto done;
+		if ( ! EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG,
+			SGX_AESGCM_MAC_SIZE, mac) ) goto done;
+	} else {
+		if ( ! EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG,
+			SGX_AESGCM_MAC_SIZE, mac) ) goto done;
+		if ( ! EVP_CipherFinal_ex(ctx, dst+len, &n) ) {
+			status= SGX_ERROR_MAC_MISMATCH;
+			goto done;
+		}
+	}
+
+	status= SGX_SUCCESS;
+
+done:
+	EVP_CIPHER_CTX_free(ctx);
+
+	return status;
+}
+
+#endif
+
+sgx_status_t sgx_rijndael128GCM_encrypt (
+	const sgx_aes_gcm_128bit_key_t *p_key, const uint8_t *p_src,
+	uint32_t src_len, uint8_t *p_dst, const uint8_t *p_iv, uint32_t iv_len,
+	const uint8_t *p_aad, uint32_t aad_len,
+	sgx_aes_gcm_128bit_tag_t *p_out_mac)
+{
+	return aes_gcm(1, p_key, p_src, src_len, p_dst, p_iv, iv_len, p_aad,
+		aad_len, (uint8_t *) p_out_mac);
+}
+
+sgx_status_t sgx_rijndael128GCM_decrypt (
+	const sgx_aes_gcm_128bit_key_t *p_key, const uint8_t *p_src,
+	uint32_t src_len, uint8_t *p_dst, const uint8_t *p_iv, uint32_t iv_len,
+	const uint8_t *p_aad, uint32_t aad_len,
+	const sgx_aes_gcm_128bit_tag_t *p_in_mac)
+{
+	return aes_gcm(0, p_key, p_src, src_len, p_dst, p_iv, iv_len, p_aad,
+		aad_len, (uint8_t *) p_in_mac);
+}
@@ -0,0 +1,103 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Force-included when the enclave sources are compiled for the host
+ * (see libgmpnative.a in Makefile.am). The enclave's entry points are
+ * renamed so they can be linked alongside the untrusted proxies that
+ * edger8r generates under the same names. Every trusted and untrusted
+ * function in EnclaveGmpTest.edl must be listed here.
+ */
+
+#ifndef __NATIVE__H
+#define __NATIVE__H
+
+/* ECALLs */
+
+#define tgmp_init		native_tgmp_init
+#define e_mpz_add		native_e_mpz_add
+#define e_mpz_mul		native_e_mpz_mul
+#define e_mpz_div		native_e_mpz_div
+#define e_mpf_div		native_e_mpf_div
+#define e_get_result		native_e_get_result
+#define e_pi			native_e_pi
+#define e_nop			native_e_nop
+#define e_bench_op		native_e_bench_op
+#define e_stack_probe		native_e_stack_probe
+#define e_async_worker		native_e_async_worker
+#define e_pi_begin		native_e_pi_begin
+#define e_pi_step		native_e_pi_step
+#define e_pi_end		native_e_pi_end
+#define e_pi_split		native_e_pi_split
+#define e_pi_merge		native_e_pi_merge
+#define e_mpz_ops		native_e_mpz_ops
+#define e_worker		native_e_worker
+#define e_job_finish		native_e_job_finish
+#define e_prime_gen		native_e_prime_gen
+#define e_rand_gen		native_e_rand_gen
+#define e_vec_sum		native_e_vec_sum
+#define e_vec_dot		native_e_vec_dot
+#define e_mul_job		native_e_mul_job
+#define e_linrec_job		native_e_linrec_job
+#define e_multi_exp		native_e_multi_exp
+#define e_lucas			native_e_lucas
+#define e_mpq_add		native_e_mpq_add
+#define e_mpq_sub		native_e_mpq_sub
+#define e_mpq_mul		native_e_mpq_mul
+#define e_mpq_div		native_e_mpq_div
+#define e_mpq_canonicalize	native_e_mpq_canonicalize
+#define e_mpq_cmp		native_e_mpq_cmp
+#define e_fixed_add		native_e_fixed_add
+#define e_fixed_sub		native_e_fixed_sub
+#define e_fixed_mul		native_e_fixed_mul
+#define e_stats_enable		native_e_stats_enable
+#define e_get_stats		native_e_get_stats
+#define e_heap_stats		native_e_heap_stats
+#define e_memo_config		native_e_memo_config
+#define e_memo_stats		native_e_memo_stats
+#define e_spill_config		native_e_spill_config
+#define e_spill_stats		native_e_spill_stats
+
+/* Whether this thread is running the enclave code (see native.c) */
+
+extern __thread int native_depth;
+
+#define in_enclave()		( native_depth > 0 )
+
+/* OCALLs. The bridges back to the host versions are in backend.c. */
+
+#define ocall_clock_ns		native_ocall_clock_ns
+#define ocall_spill_alloc	native_ocall_spill_alloc
+#define ocall_spill_map		native_ocall_spill_map
+#define ocall_spill_unmap	native_ocall_spill_unmap
+#define ocall_spill_free	native_ocall_spill_free
+
+#endif
@@ -0,0 +1,70 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Stand-in for the trusted crypto header in native builds, with just
+ * the AES-GCM calls that the enclave code uses. native.c implements
+ * them with OpenSSL.
+ */
+
+#ifndef __NATIVE_SGX_TCRYPTO_H
+#define __NATIVE_SGX_TCRYPTO_H
+
+#include <stdint.h>
+#include <sgx_error.h>
+
+#define SGX_AESGCM_IV_SIZE	12
+#define SGX_AESGCM_KEY_SIZE	16
+#define SGX_AESGCM_MAC_SIZE	16
+
+typedef uint8_t sgx_aes_gcm_128bit_key_t[SGX_AESGCM_KEY_SIZE];
+typedef uint8_t sgx_aes_gcm_128bit_tag_t[SGX_AESGCM_MAC_SIZE];
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+sgx_status_t sgx_rijndael128GCM_encrypt (
+	const sgx_aes_gcm_128bit_key_t *p_key, const uint8_t *p_src,
+	uint32_t src_len, uint8_t *p_dst, const uint8_t *p_iv, uint32_t iv_len,
+	const uint8_t *p_aad, uint32_t aad_len,
+	sgx_aes_gcm_128bit_tag_t *p_out_mac);
+sgx_status_t sgx_rijndael128GCM_decrypt (
+	const sgx_aes_gcm_128bit_key_t *p_key, const uint8_t *p_src,
+	uint32_t src_len, uint8_t *p_dst, const uint8_t *p_iv, uint32_t iv_len,
+	const uint8_t *p_aad, uint32_t aad_len,
+	const sgx_aes_gcm_128bit_tag_t *p_in_mac);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,217 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "EnclaveGmpTest_u.h"
+
+/* Host services for the enclave */
+
+void ocall_clock_ns (uint64_t *ns)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	*ns= (uint64_t) ts.tv_sec*1000000000ULL+(uint64_t) ts.tv_nsec;
+}
+
+/*
+ * Storage for integers spilled by the enclave (see spill.c in the
+ * enclave). The blobs are already encrypted and authenticated, so we
+ * only have to keep them. Each is in memory while the enclave has it
+ * mapped. If SPILL_DIR_ENV names a directory, unmapped blobs are
+ * written to a file there and dropped from memory until they are
+ * mapped again; otherwise they stay in memory.
+ *
+ * Handles are indices into the blob table, plus one so that 0 can
+ * mean failure.
+ */
+
+#define SPILL_DIR_ENV	"SGXGMP_SPILL_DIR"
+
+struct spill_blob {
+	void *mem;
+	size_t len;
+	int used;
+	int on_disk;
+};
+
+static struct spill_blob *blobs= NULL;
+static size_t nblobs= 0;
+static pthread_mutex_t blob_lock= PTHREAD_MUTEX_INITIALIZER;
+
+static struct spill_blob *blob_get (uint64_t handle);
+static void blob_path (char *path, size_t size, uint64_t handle);
+
+uint64_t ocall_spill_alloc (size_t len)
+{
+	struct spill_blob *nb;
+	size_t i;
+	uint64_t handle= 0;
+
+	pthread_mutex_lock(&blob_lock);
+
+	for (i= 0; i< nblobs && blobs[i].used; ++i);
+
+	/* All in use, so grow the table; slot i is the first new one. */
+
+	if ( i == nblobs ) {
+		size_t n= ( nblobs ) ? 2*nblobs : 16;
+
+		nb= realloc(blobs, n*sizeof(*blobs));
+		if ( nb == NULL ) goto done;
+		blobs= nb;
+		for (; nblobs< n; ++nblobs) blobs[nblobs].used= 0;
+	}
+
+	blobs[i].mem= malloc(len ? len : 1);
+	if ( blobs[i].mem == NULL ) goto done;
+	blobs[i].len= len;
+	blobs[i].used= 1;
+	blobs[i].on_disk= 0;
+	handle= i+1;
+
+done:
+	pthread_mutex_unlock(&blob_lock);
+
+	return handle;
+}
+
+void *ocall_spill_map (uint64_t handle)
+{
+	struct spill_blob *b;
+	char path[4096];
+	FILE *fp;
+	void *mem= NULL;
+
+	pthread_mutex_lock(&blob_lock);
+
+	b= blob_get(handle);
+	if ( b == NULL ) goto done;
+
+	if ( b->on_disk ) {
+		blob_path(path, sizeof(path), handle);
+		b->mem= malloc(b->len ? b->len : 1);
+		if ( b->mem == NULL ) goto done;
+
+		fp= fopen(path, "rb");
+		if ( fp == NULL || fread(b->mem, 1, b->len, fp) != b->len ) {
+			if ( fp != NULL ) fclose(fp);
+			free(b->mem);
+			b->mem= NULL;
+			goto done;
+		}
+		fclose(fp);
+		unlink(path);
+		b->on_disk= 0;
+	}
+
+	mem= b->mem;
+
+done:
+	pthread_mutex_unlock(&blob_lock);
+
+	return mem;
+}
+
+void ocall_spill_unmap (uint64_t handle)
+{
+	struct spill_blob *b;
+	char path[4096];
+	FILE *fp;
+	size_t n;
+
+	if ( getenv(SPILL_DIR_ENV) == NULL ) return;
+
+	pthread_mutex_lock(&blob_lock);
+
+	b= blob_get(handle);
+	if ( b == NULL || b->on_disk ) goto done;
+
+	/* If it can't be written out, it just stays in memory. */
+
+	blob_path(path, sizeof(path), handle);
+	fp= fopen(path, "wb");
+	if ( fp == NULL ) goto done;
+	n= fwrite(b->mem, 1, b->len, fp);
+	if ( fclose(fp) == EOF || n != b->len ) {
+		unlink(path);
+		goto done;
+	}
+
+	free(b->mem);
+	b->mem= NULL;
+	b->on_disk= 1;
+
+done:
+	pthread_mutex_unlock(&blob_lock);
+}
+
+void ocall_spill_free (uint64_t handle)
+{
+	struct spill_blob *b;
+	char path[4096];
+
+	pthread_mutex_lock(&blob_lock);
+
+	b= blob_get(handle);
+	if ( b != NULL ) {
+		if ( b->on_disk ) {
+			blob_path(path, sizeof(path), handle);
+			unlink(path);
+		}
+		free(b->mem);
+		b->mem= NULL;
+		b->used= 0;
+	}
+
+	pthread_mutex_unlock(&blob_lock);
+}
+
+/* Call these with blob_lock held */
+
+static struct spill_blob *blob_get (uint64_t handle)
+{
+	if ( handle == 0 || handle > nblobs || ! blobs[handle-1].used )
+		return NULL;
+
+	return &blobs[handle-1];
+}
+
+static void blob_path (char *path, size_t size, uint64_t handle)
+{
+	snprintf(path, size, "%s/sgxgmp-spill.%ld.%llu", getenv(SPILL_DIR_ENV),
+		(long) getpid(), (unsigned long long) handle);
+}
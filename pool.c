@@ -0,0 +1,303 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pool.h"
+
+int pool_open (struct enclave_pool *pool, int n, const char *backend)
+{
+	int i;
+
+	memset(pool, 0, sizeof(struct enclave_pool));
+	pthread_mutex_init(&pool->lock, NULL);
+
+	pool->members= calloc(n, sizeof(struct pool_member));
+	if ( pool->members == NULL ) {
+		perror("calloc");
+		return 0;
+	}
+
+	/*
+	 * The native backend's state is global to the process, so there
+	 * can only be one of those.
+	 */
+
+	for (i= 0; i< n; ++i) {
+		struct pool_member *m= &pool->members[i];
+
+		if ( ! backend_open(&m->be, backend) ) {
+			while ( i-- ) backend_close(&pool->members[i].be);
+			free(pool->members);
+			return 0;
+		}
+		pthread_cond_init(&m->idle, NULL);
+		pool->n= i+1;
+
+		if ( strcmp(m->be.name, "native") == 0 && n > 1 ) {
+			fprintf(stderr, "The native backend has only one instance\n");
+			break;
+		}
+	}
+
+	return 1;
+}
+
+/* Wait for calls in progress, and refuse new ones. */
+
+void pool_close (struct enclave_pool *pool)
+{
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->closing= 1;
+	for (i= 0; i< pool->n; ++i) {
+		struct pool_member *m= &pool->members[i];
+
+		pthread_cond_broadcast(&m->idle);
+		while ( m->busy || m->waiting || m->held || m->sharing )
+			pthread_cond_wait(&m->idle, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i= 0; i< pool->n; ++i) {
+		backend_close(&pool->members[i].be);
+		pthread_cond_destroy(&pool->members[i].idle);
+	}
+
+	free(pool->members);
+	pool->members= NULL;
+	pool->n= 0;
+}
+
+/* The last members are the reserved ones. */
+
+int pool_reserve (struct enclave_pool *pool, int n)
+{
+	int i;
+
+	if ( n > pool->n-1 ) n= pool->n-1;
+	if ( n < 0 ) n= 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (i= 0; i< pool->n; ++i)
+		pool->members[i].reserved= ( i >= pool->n-n );
+	pthread_mutex_unlock(&pool->lock);
+
+	return n;
+}
+
+/*
+ * A large call waits until the member is free of small callers as
+ * well as idle, and doesn't take a member that another large call is
+ * holding.
+ */
+
+static int pool_must_wait (struct pool_member *m, int lane)
+{
+	if ( m->busy ) return 1;
+	if ( lane == POOL_SMALL ) return 0;
+
+	return ( m->waiting_small || m->held );
+}
+
+/* The member with the least work, or the one asked for. Call locked. */
+
+static struct pool_member *pool_pick (struct enclave_pool *pool,
+	int member, int lane)
+{
+	struct pool_member *m;
+	int i;
+
+	if ( member != POOL_ANY ) return &pool->members[member%pool->n];
+
+	m= NULL;
+	for (i= 0; i< pool->n; ++i) {
+		struct pool_member *c= &pool->members[(pool->next+i)%pool->n];
+
+		if ( lane == POOL_LARGE && c->reserved ) continue;
+
+		if ( m == NULL || c->work < m->work ||
+			( c->work == m->work && c->waiting+c->busy <
+			m->waiting+m->busy ) )
+		{
+			m= c;
+		}
+	}
+	pool->next= (pool->next+1)%pool->n;
+
+	return m;
+}
+
+struct pool_member *pool_get (struct enclave_pool *pool, int member,
+	int lane, uint64_t cost)
+{
+	struct pool_member *m;
+
+	pthread_mutex_lock(&pool->lock);
+
+	if ( pool->closing ) {
+		pthread_mutex_unlock(&pool->lock);
+		return NULL;
+	}
+
+	m= pool_pick(pool, member, lane);
+
+	m->work+= cost;
+	++m->waiting;
+	if ( lane == POOL_SMALL ) ++m->waiting_small;
+	while ( pool_must_wait(m, lane) && ! pool->closing )
+		pthread_cond_wait(&m->idle, &pool->lock);
+	--m->waiting;
+	if ( lane == POOL_SMALL ) --m->waiting_small;
+
+	if ( pool->closing ) {
+		m->work-= cost;
+		pthread_cond_broadcast(&m->idle);
+		pthread_mutex_unlock(&pool->lock);
+		return NULL;
+	}
+
+	m->busy= 1;
+	pthread_mutex_unlock(&pool->lock);
+
+	return m;
+}
+
+void pool_put (struct enclave_pool *pool, struct pool_member *m,
+	uint64_t cost)
+{
+	pthread_mutex_lock(&pool->lock);
+	m->busy= 0;
+	m->work-= cost;
+	++m->served;
+	pthread_cond_broadcast(&m->idle);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * A shared call only waits when the member is busy and all of its
+ * spare threads are taken. A yielded large call isn't busy, so the
+ * small calls it let through get the member to themselves.
+ */
+
+struct pool_member *pool_share (struct enclave_pool *pool, int member,
+	uint64_t cost, int *shared)
+{
+	struct pool_member *m;
+
+	pthread_mutex_lock(&pool->lock);
+
+	if ( pool->closing ) {
+		pthread_mutex_unlock(&pool->lock);
+		return NULL;
+	}
+
+	m= pool_pick(pool, member, POOL_SMALL);
+
+	m->work+= cost;
+	++m->waiting;
+	++m->waiting_small;
+	while ( m->busy && m->sharing >= POOL_MAX_SHARED && ! pool->closing )
+		pthread_cond_wait(&m->idle, &pool->lock);
+	--m->waiting;
+	--m->waiting_small;
+
+	if ( pool->closing ) {
+		m->work-= cost;
+		pthread_cond_broadcast(&m->idle);
+		pthread_mutex_unlock(&pool->lock);
+		return NULL;
+	}
+
+	*shared= m->busy;
+	if ( *shared ) ++m->sharing;
+	else m->busy= 1;
+	pthread_mutex_unlock(&pool->lock);
+
+	return m;
+}
+
+void pool_unshare (struct enclave_pool *pool, struct pool_member *m,
+	uint64_t cost)
+{
+	pthread_mutex_lock(&pool->lock);
+	--m->sharing;
+	m->work-= cost;
+	++m->served;
+	pthread_cond_broadcast(&m->idle);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+int pool_yield_wanted (struct enclave_pool *pool, struct pool_member *m)
+{
+	int wanted;
+
+	pthread_mutex_lock(&pool->lock);
+	wanted= ( m->waiting_small != 0 );
+	pthread_mutex_unlock(&pool->lock);
+
+	return wanted;
+}
+
+/*
+ * Let through the small calls waiting on the member, and take it back
+ * once they have run. Small calls that arrive meanwhile can keep a
+ * large one waiting no longer than the ones it yielded to, so a steady
+ * stream of them slows it down but doesn't stop it.
+ */
+
+void pool_yield (struct enclave_pool *pool, struct pool_member *m)
+{
+	unsigned long until;
+
+	pthread_mutex_lock(&pool->lock);
+
+	if ( m->waiting_small == 0 ) {
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+
+	until= m->served+m->waiting_small;
+
+	m->held= 1;
+	m->busy= 0;
+	pthread_cond_broadcast(&m->idle);
+
+	while ( m->busy || ( m->waiting_small && m->served < until ) )
+		pthread_cond_wait(&m->idle, &pool->lock);
+
+	m->held= 0;
+	m->busy= 1;
+	pthread_mutex_unlock(&pool->lock);
+}
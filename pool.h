@@ -0,0 +1,125 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __POOL_H
+#define __POOL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "backend.h"
+#include "workers.h"
+
+/*
+ * A pool of enclave instances, each created and initialized on its
+ * own, so each has its own heap and its own tgmp_init state.
+ *
+ * An enclave keeps one pending result between an operation and its
+ * e_get_result, so a member serves one caller at a time. Callers
+ * queue on a member rather than on the pool: pool_get picks the
+ * member with the least outstanding work, counting both the caller
+ * it is serving and those waiting for it, by the cost estimate that
+ * each caller gives. A caller that needs state kept in one enclave
+ * across calls asks for that member by number instead.
+ *
+ * Calls come in two lanes. Small calls go ahead of large ones queued
+ * on the same member, and members set aside with pool_reserve never
+ * take large calls from POOL_ANY. A large caller that works in steps
+ * can check pool_yield_wanted between them and, if small calls are
+ * waiting, let them through with pool_yield while it keeps its place
+ * on the member.
+ *
+ * A call that leaves nothing behind in the enclave, because its result
+ * goes straight to the caller's buffer, doesn't need a member to itself,
+ * only a thread in it. pool_share gives it the member if the member is
+ * idle, as pool_get would, and otherwise lets it in alongside the call
+ * that holds it, up to POOL_MAX_SHARED of them, instead of waiting.
+ */
+
+struct pool_member {
+	struct backend be;
+	pthread_cond_t idle;
+	int busy;
+	int reserved;		/* Small calls only, unless asked for */
+	int held;		/* A large call has yielded, and will be back */
+	int sharing;		/* Calls running alongside the one it serves */
+	unsigned long waiting;	/* Callers queued for this member */
+	unsigned long waiting_small;
+	uint64_t work;		/* Cost of the current and queued calls */
+	unsigned long served;
+};
+
+struct enclave_pool {
+	struct pool_member *members;
+	int n;
+	int next;		/* Where to start looking, to break ties */
+	int closing;
+	pthread_mutex_t lock;
+};
+
+#define POOL_ANY	-1
+
+#define POOL_SMALL	0
+#define POOL_LARGE	1
+
+/* The enclave threads left when the member's own caller has one */
+
+#define POOL_MAX_SHARED	(ENCLAVE_MAX_THREADS-1)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int pool_open (struct enclave_pool *pool, int n, const char *backend);
+void pool_close (struct enclave_pool *pool);
+
+/* Returns the number reserved, which leaves at least one for large calls. */
+int pool_reserve (struct enclave_pool *pool, int n);
+
+/* Returns NULL once the pool is closing. */
+struct pool_member *pool_get (struct enclave_pool *pool, int member,
+	int lane, uint64_t cost);
+void pool_put (struct enclave_pool *pool, struct pool_member *m,
+	uint64_t cost);
+
+/* Small calls only. Sets *shared if the call is one alongside another. */
+struct pool_member *pool_share (struct enclave_pool *pool, int member,
+	uint64_t cost, int *shared);
+void pool_unshare (struct enclave_pool *pool, struct pool_member *m,
+	uint64_t cost);
+
+int pool_yield_wanted (struct enclave_pool *pool, struct pool_member *m);
+void pool_yield (struct enclave_pool *pool, struct pool_member *m);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
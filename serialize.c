@@ -36,6 +36,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #endif
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <math.h>
 #include "serialize.h"
 
@@ -50,6 +51,21 @@ char *mpz_serialize (mpz_t val)
 	return mpz_get_str(NULL, S_BASE, val);
 }
 
+/*
+ * Free a string from mpz_serialize() or mpf_serialize(). They belong to
+ * GMP's allocator, which need not be malloc().
+ */
+
+void str_free (char *s)
+{
+	void (*gmp_free)(void *, size_t);
+
+	if ( s == NULL ) return;
+
+	mp_get_memory_functions(NULL, NULL, &gmp_free);
+	gmp_free(s, strlen(s)+1);
+}
+
 char *mpf_serialize (mpf_t val, int digits)
 {
 	mp_exp_t mpe= 0;
@@ -68,16 +84,23 @@ char *mpf_serialize (mpf_t val, int digits)
 	mpz_init_set_si(e, mpe);
 
 	se= mpz_get_str(NULL, S_BASE, e);
+	mpz_clear(e);
 	if ( se == NULL ) {
-		gmp_free_func(smant, 0);
+		gmp_free_func(smant, strlen(smant)+1);
 		return NULL;
 	}
 
+	/*
+	 * Strings from the get_str functions are exactly strlen()+1 bytes,
+	 * and the free function is told so, since the enclave's GMP hooks
+	 * account for every byte.
+	 */
+
 	len= strlen(smant)+strlen(se)+3;
 	s= gmp_alloc_func(len); /* .M@N + NULL */
 	if ( s == NULL ) {
-		gmp_free_func(smant, 0);
-		gmp_free_func(se, 0);
+		gmp_free_func(smant, strlen(smant)+1);
+		gmp_free_func(se, strlen(se)+1);
 		return NULL;
 	}
 	
@@ -87,7 +110,7 @@ char *mpf_serialize (mpf_t val, int digits)
 	 */
 
 	if ( smant[0] == '-' ) {
-		strncpy(s, "-.", 2);
+		strncpy(s, "-.", 3);
 		strncat(s, &smant[1], strlen(smant)-1);
 	} else {
 		strncpy(s, ".", 2);
@@ -95,9 +118,9 @@ char *mpf_serialize (mpf_t val, int digits)
 	}
 	strncat(s, "@", 1);
 	strncat(s, se, strlen(se));
-	s[len]= '\0';
-	gmp_free_func(smant, 0);
-	gmp_free_func(se, 0);
+	s[len-1]= '\0';
+	gmp_free_func(smant, strlen(smant)+1);
+	gmp_free_func(se, strlen(se)+1);
 
 	return s;
 }
@@ -115,3 +138,224 @@ int mpf_deserialize(mpf_t *val, char *s, int digits)
 
 	return mpf_set_str(*val, s, S_BASE);
 }
+
+static void put32 (unsigned char *p, uint32_t v)
+{
+	p[0]= v&0xff;
+	p[1]= (v>>8)&0xff;
+	p[2]= (v>>16)&0xff;
+	p[3]= (v>>24)&0xff;
+}
+
+static uint32_t get32 (const unsigned char *p)
+{
+	return (uint32_t) p[0] | ((uint32_t) p[1]<<8) | ((uint32_t) p[2]<<16) |
+		((uint32_t) p[3]<<24);
+}
+
+static size_t rec_len (mpz_srcptr v)
+{
+	return BATCH_REC_LEN+(mpz_sizeinbase(v, 2)+7)/8;
+}
+
+static unsigned char *put_rec (unsigned char *p, mpz_srcptr v)
+{
+	size_t nbytes= 0;
+
+	mpz_export(p+BATCH_REC_LEN, &nbytes, 1, 1, 1, 0, v);
+	put32(p, (uint32_t) nbytes);
+	put32(p+4, (mpz_sgn(v) < 0) ? BATCH_NEGATIVE : 0);
+
+	return p+BATCH_REC_LEN+nbytes;
+}
+
+static const unsigned char *get_rec (const unsigned char *p, mpz_ptr v)
+{
+	size_t nbytes= get32(p);
+
+	mpz_import(v, nbytes, 1, 1, 1, 0, p+BATCH_REC_LEN);
+	if ( get32(p+4) & BATCH_NEGATIVE ) mpz_neg(v, v);
+
+	return p+BATCH_REC_LEN+nbytes;
+}
+
+static unsigned char *batch_alloc (size_t blen, size_t n)
+{
+	unsigned char *buf;
+
+	if ( gmp_free_func == NULL || gmp_alloc_func == NULL )
+		mp_get_memory_functions(&gmp_alloc_func, NULL, &gmp_free_func);
+
+	if ( n > UINT32_MAX ) return NULL;
+
+	buf= gmp_alloc_func(blen);
+	if ( buf == NULL ) return NULL;
+
+	put32(buf, (uint32_t) n);
+
+	return buf;
+}
+
+unsigned char *mpz_batch_serialize (mpz_t *vals, size_t n, size_t *len)
+{
+	unsigned char *buf, *p;
+	size_t i, blen;
+
+	/* Size the buffer first so we only allocate once. */
+
+	blen= BATCH_HDR_LEN;
+	for (i= 0; i< n; ++i) blen+= rec_len(vals[i]);
+
+	buf= batch_alloc(blen, n);
+	if ( buf == NULL ) return NULL;
+
+	p= buf+BATCH_HDR_LEN;
+	for (i= 0; i< n; ++i) p= put_rec(p, vals[i]);
+
+	*len= (size_t) (p-buf);
+
+	return buf;
+}
+
+/*
+ * The same, into a buffer that the caller provides. mpz_batch_size
+ * says how big it must be. Returns the length of the batch, or 0 if it
+ * doesn't fit.
+ */
+
+size_t mpz_batch_size (mpz_t *vals, size_t n)
+{
+	size_t i, blen= BATCH_HDR_LEN;
+
+	for (i= 0; i< n; ++i) blen+= rec_len(vals[i]);
+
+	return blen;
+}
+
+size_t mpz_batch_write (unsigned char *buf, size_t size, mpz_t *vals,
+	size_t n)
+{
+	unsigned char *p;
+	size_t i;
+
+	if ( n > UINT32_MAX || mpz_batch_size(vals, n) > size ) return 0;
+
+	put32(buf, (uint32_t) n);
+
+	p= buf+BATCH_HDR_LEN;
+	for (i= 0; i< n; ++i) p= put_rec(p, vals[i]);
+
+	return (size_t) (p-buf);
+}
+
+/*
+ * Return the number of records in a batch, or (size_t) -1 if the
+ * buffer is too short to hold them all.
+ */
+
+size_t mpz_batch_count (const unsigned char *buf, size_t len)
+{
+	const unsigned char *p, *end;
+	size_t i, n;
+
+	if ( buf == NULL || len < BATCH_HDR_LEN ) return (size_t) -1;
+
+	n= get32(buf);
+	p= buf+BATCH_HDR_LEN;
+	end= buf+len;
+
+	for (i= 0; i< n; ++i) {
+		size_t nbytes;
+
+		if ( (size_t) (end-p) < BATCH_REC_LEN ) return (size_t) -1;
+		nbytes= get32(p);
+		p+= BATCH_REC_LEN;
+		if ( (size_t) (end-p) < nbytes ) return (size_t) -1;
+		p+= nbytes;
+	}
+
+	return n;
+}
+
+/* The vals array must hold n initialized integers. */
+
+int mpz_batch_deserialize (mpz_t *vals, size_t n, const unsigned char *buf,
+	size_t len)
+{
+	const unsigned char *p;
+	size_t i;
+
+	if ( mpz_batch_count(buf, len) != n ) return -1;
+
+	p= buf+BATCH_HDR_LEN;
+	for (i= 0; i< n; ++i) p= get_rec(p, vals[i]);
+
+	return 0;
+}
+
+/*
+ * Rationals are sent as numerator, denominator pairs, so a batch of n
+ * rationals holds 2n records. They are not canonicalized in either
+ * direction, since the receiver may want to defer that.
+ */
+
+unsigned char *mpq_batch_serialize (mpq_t *vals, size_t n, size_t *len)
+{
+	unsigned char *buf, *p;
+	size_t i, blen;
+
+	blen= BATCH_HDR_LEN;
+	for (i= 0; i< n; ++i)
+		blen+= rec_len(mpq_numref(vals[i]))+rec_len(mpq_denref(vals[i]));
+
+	buf= batch_alloc(blen, 2*n);
+	if ( buf == NULL ) return NULL;
+
+	p= buf+BATCH_HDR_LEN;
+	for (i= 0; i< n; ++i) {
+		p= put_rec(p, mpq_numref(vals[i]));
+		p= put_rec(p, mpq_denref(vals[i]));
+	}
+
+	*len= (size_t) (p-buf);
+
+	return buf;
+}
+
+size_t mpq_batch_count (const unsigned char *buf, size_t len)
+{
+	size_t n= mpz_batch_count(buf, len);
+
+	if ( n == (size_t) -1 || n%2 ) return (size_t) -1;
+
+	return n/2;
+}
+
+/*
+ * The vals array must hold n initialized rationals. A zero denominator
+ * is an error, and negative denominators have their sign moved to the
+ * numerator.
+ */
+
+int mpq_batch_deserialize (mpq_t *vals, size_t n, const unsigned char *buf,
+	size_t len)
+{
+	const unsigned char *p;
+	size_t i;
+
+	if ( mpq_batch_count(buf, len) != n ) return -1;
+
+	p= buf+BATCH_HDR_LEN;
+	for (i= 0; i< n; ++i) {
+		p= get_rec(p, mpq_numref(vals[i]));
+		p= get_rec(p, mpq_denref(vals[i]));
+
+		if ( mpz_sgn(mpq_denref(vals[i])) == 0 ) return -1;
+		if ( mpz_sgn(mpq_denref(vals[i])) < 0 ) {
+			mpz_neg(mpq_numref(vals[i]), mpq_numref(vals[i]));
+			mpz_neg(mpq_denref(vals[i]), mpq_denref(vals[i]));
+		}
+	}
+
+	return 0;
+}
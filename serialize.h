@@ -38,11 +38,88 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <gmp.h>
 #endif
 
+/*
+ * libsgxgmpclient is linked into other programs, so its copy of these
+ * is renamed to stay out of GMP's mpz_ and mpf_ namespace.
+ */
+
+#ifdef SGXGMP_CLIENT
+#define mpz_serialize		sgxgmp_mpz_serialize
+#define mpf_serialize		sgxgmp_mpf_serialize
+#define str_free		sgxgmp_str_free
+#define mpz_deserialize		sgxgmp_mpz_deserialize
+#define mpf_deserialize		sgxgmp_mpf_deserialize
+#define mpz_batch_serialize	sgxgmp_mpz_batch_serialize
+#define mpz_batch_size		sgxgmp_mpz_batch_size
+#define mpz_batch_write		sgxgmp_mpz_batch_write
+#define mpz_batch_count		sgxgmp_mpz_batch_count
+#define mpz_batch_deserialize	sgxgmp_mpz_batch_deserialize
+#define mpq_batch_serialize	sgxgmp_mpq_batch_serialize
+#define mpq_batch_count		sgxgmp_mpq_batch_count
+#define mpq_batch_deserialize	sgxgmp_mpq_batch_deserialize
+#endif
+
 char *mpz_serialize (mpz_t val);
 char *mpf_serialize (mpf_t val, int digits);
+void str_free (char *s);
 
 int mpz_deserialize(mpz_t *val, char *s);
 int mpf_deserialize(mpf_t *val, char *s, int digits);
 
+/*
+ * Batch wire format, for moving many integers across the enclave
+ * boundary in one call:
+ *
+ *   uint32 count
+ *   count x { uint32 nbytes, uint32 flags, nbytes of magnitude }
+ *
+ * All header words are little-endian. The magnitude is big-endian
+ * (most significant byte first) and flags bit 0 is the sign.
+ */
+
+#define BATCH_HDR_LEN	4
+#define BATCH_REC_LEN	8
+#define BATCH_NEGATIVE	0x1
+
+unsigned char *mpz_batch_serialize (mpz_t *vals, size_t n, size_t *len);
+size_t mpz_batch_size (mpz_t *vals, size_t n);
+size_t mpz_batch_write (unsigned char *buf, size_t size, mpz_t *vals,
+	size_t n);
+size_t mpz_batch_count (const unsigned char *buf, size_t len);
+int mpz_batch_deserialize (mpz_t *vals, size_t n, const unsigned char *buf,
+	size_t len);
+
+/*
+ * Integer operation streams for e_mpz_ops: one op code per operation,
+ * each applied to the next pair of integers in a batch.
+ */
+
+#define MPZ_OP_ADD	0
+#define MPZ_OP_SUB	1
+#define MPZ_OP_MUL	2
+#define MPZ_OP_DIV	3	/* Rounded down, like e_mpz_div */
+#define MPZ_NOPS	4
+
+/*
+ * A partial pi sum from e_pi_split, or several merged by e_pi_merge, is
+ * a batch of PI_PART_LEN integers: the digits asked for, the range of
+ * terms [a, b) it covers, and the binary splitting products P, Q and T
+ * over that range. Partials for consecutive ranges can be merged in any
+ * grouping, and a partial covering every term gives pi.
+ */
+
+#define PI_PART_DIGITS	0
+#define PI_PART_A	1
+#define PI_PART_B	2
+#define PI_PART_P	3
+#define PI_PART_Q	4
+#define PI_PART_T	5
+#define PI_PART_LEN	6
+
+unsigned char *mpq_batch_serialize (mpq_t *vals, size_t n, size_t *len);
+size_t mpq_batch_count (const unsigned char *buf, size_t len);
+int mpq_batch_deserialize (mpq_t *vals, size_t n, const unsigned char *buf,
+	size_t len);
+
 #endif
 
@@ -36,6 +36,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdio.h>
 #include "sgx_stub.h"
 #include "sgx_detect.h"
+#include "create_enclave.h"
 #include <sgx_edger8r.h>
 #include <sgx_uae_service.h>
 #include <sgx_urts.h>
@@ -135,8 +136,11 @@ static void *_load_symbol(void *handle, const char *symbol, int *status)
 static void *_load_libsgx_uae_service()
 {
 	if ( l_libsgx_uae_service == 0 ) {
+		uint64_t start= startup_clock();
+
 		dlerror();
 		h_libsgx_uae_service= dlopen(UAE_SERVICE_LIB, RTLD_GLOBAL|RTLD_NOW);
+		startup_add(STARTUP_DLOPEN, start);
 		if ( h_libsgx_uae_service == NULL ) {
 			fprintf(stderr, "%s: %s\n", UAE_SERVICE_LIB, dlerror());
 			l_libsgx_uae_service= -1;
@@ -149,7 +153,10 @@ static void *_load_libsgx_uae_service()
 static void *_load_libsgx_urts()
 {
 	if ( l_libsgx_urts == 0 ) {
+		uint64_t start= startup_clock();
+
 		h_libsgx_urts= dlopen(URTS_LIB, RTLD_GLOBAL|RTLD_NOW);
+		startup_add(STARTUP_DLOPEN, start);
 		if ( h_libsgx_urts == NULL ) {
 			fprintf(stderr, "%s: %s\n", URTS_LIB, dlerror());
 			l_libsgx_urts= -1;
@@ -0,0 +1,979 @@
+/*
+
+Copyright 2018 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <sgx_urts.h>
+#include <gmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "backend.h"
+#include "ecall_stats.h"
+#include "serialize.h"
+#include "workers.h"
+
+#define DEFAULT_PRIME_REPS 25
+
+struct command {
+	const char *name;
+	const char *args;
+	int (*run)(struct backend *be, int argc, char *argv[]);
+};
+
+typedef sgx_status_t (*fixed_ecall_t)(sgx_enclave_id_t eid, int *rv,
+	uint32_t bits, const unsigned char *a, const unsigned char *b,
+	unsigned char *c, size_t len);
+typedef sgx_status_t (*qfold_ecall_t)(sgx_enclave_id_t eid, size_t *len,
+	unsigned char *buf, size_t blen, int canonical);
+
+static int nthreads= 0;
+static int canonical= 1;
+static int stats= STATS_OFF;
+static int heap= 0;
+
+void usage ();
+
+static unsigned char *fetch_result (struct backend *be, size_t len);
+static int print_batch (unsigned char *buf, size_t len);
+static unsigned char *pack_args (int argc, char *argv[], int *order,
+	size_t *len);
+static void free_packed (unsigned char *buf, size_t len);
+static int run_job (struct backend *be, const char *name);
+static int print_stats (struct backend *be);
+static int to_fixed (const char *s, unsigned char *buf, size_t len);
+static int fixed (struct backend *be, int argc, char *argv[],
+	fixed_ecall_t ecall, const char *name);
+static unsigned char *pack_rationals (int argc, char *argv[], size_t *len);
+static int print_qbatch (unsigned char *buf, size_t len);
+static int qfold (struct backend *be, int argc, char *argv[],
+	qfold_ecall_t ecall, const char *name);
+
+static int rand_gen (struct backend *be, unsigned char *buf, size_t len,
+	unsigned long bits, int argc, char *argv[]);
+
+static int cmd_prime (struct backend *be, int argc, char *argv[]);
+static int cmd_rand (struct backend *be, int argc, char *argv[]);
+static int cmd_randbelow (struct backend *be, int argc, char *argv[]);
+static int cmd_multiexp (struct backend *be, int argc, char *argv[]);
+static int cmd_qadd (struct backend *be, int argc, char *argv[]);
+static int cmd_qsub (struct backend *be, int argc, char *argv[]);
+static int cmd_qmul (struct backend *be, int argc, char *argv[]);
+static int cmd_qdiv (struct backend *be, int argc, char *argv[]);
+static int cmd_qcanon (struct backend *be, int argc, char *argv[]);
+static int cmd_qcmp (struct backend *be, int argc, char *argv[]);
+static int cmd_sum (struct backend *be, int argc, char *argv[]);
+static int cmd_dot (struct backend *be, int argc, char *argv[]);
+static int cmd_mul (struct backend *be, int argc, char *argv[]);
+static int cmd_lucas (struct backend *be, int argc, char *argv[]);
+static int cmd_linrec (struct backend *be, int argc, char *argv[]);
+static int cmd_fadd (struct backend *be, int argc, char *argv[]);
+static int cmd_fsub (struct backend *be, int argc, char *argv[]);
+static int cmd_fmul (struct backend *be, int argc, char *argv[]);
+
+static struct command commands[]= {
+	{ "prime", "bits count [reps]", cmd_prime },
+	{ "rand", "bits count [fast]", cmd_rand },
+	{ "randbelow", "bound count [fast]", cmd_randbelow },
+	{ "multiexp", "modulus base1 exp1 [base2 exp2 ...]", cmd_multiexp },
+	{ "qadd", "q1 q2 [q3 ...]", cmd_qadd },
+	{ "qsub", "q1 q2 [q3 ...]", cmd_qsub },
+	{ "qmul", "q1 q2 [q3 ...]", cmd_qmul },
+	{ "qdiv", "q1 q2 [q3 ...]", cmd_qdiv },
+	{ "qcanon", "q1 [q2 ...]", cmd_qcanon },
+	{ "qcmp", "q1 q2", cmd_qcmp },
+	{ "sum", "x1 [x2 ...]", cmd_sum },
+	{ "dot", "x1 ... xn y1 ... yn", cmd_dot },
+	{ "mul", "a b", cmd_mul },
+	{ "lucas", "n P Q [modulus]", cmd_lucas },
+	{ "linrec", "n modulus c0 ... cd-1 x0 ... xd-1", cmd_linrec },
+	{ "fadd", "bits a b", cmd_fadd },
+	{ "fsub", "bits a b", cmd_fsub },
+	{ "fmul", "bits a b", cmd_fmul },
+	{ NULL, NULL, NULL }
+};
+
+void usage () {
+	struct command *cmd;
+
+	fprintf(stderr, "usage: sgxgmpbatch [-b backend] [-m] [-u] [-s|-S] "
+		"[-t threads] command args ...\n");
+	fprintf(stderr, "  -b  sgx or native (default: $%s, or sgx)\n",
+		BACKEND_ENV);
+	fprintf(stderr, "  -m  report enclave heap use and leaks to stderr\n");
+	fprintf(stderr, "  -u  leave rational results unreduced\n");
+	fprintf(stderr, "  -s  print ECALL counters to stderr when done\n");
+	fprintf(stderr, "  -S  the same, with latencies\n");
+	fprintf(stderr, "commands:\n");
+	for (cmd= commands; cmd->name != NULL; ++cmd)
+		fprintf(stderr, "  %s %s\n", cmd->name, cmd->args);
+	exit(1);
+}
+
+int main (int argc, char *argv[])
+{
+	struct backend be;
+	sgx_status_t status;
+	struct command *cmd;
+	struct heap_stats before, after;
+	char *backend= NULL;
+	int opt, rv;
+
+	while ( (opt= getopt(argc, argv, "b:hmSst:u")) != -1 ) {
+		switch (opt) {
+		case 'b':
+			backend= optarg;
+			break;
+		case 'm':
+			heap= 1;
+			break;
+		case 'S':
+			stats= STATS_TIME;
+			break;
+		case 's':
+			stats= STATS_COUNT;
+			break;
+		case 't':
+			nthreads= atoi(optarg);
+			break;
+		case 'u':
+			canonical= 0;
+			break;
+		case 'h':
+		default:
+			usage();
+		}
+	}
+
+	argc-= optind;
+	argv+= optind;
+
+	if ( argc < 1 ) usage();
+
+	for (cmd= commands; cmd->name != NULL; ++cmd)
+		if ( strcmp(cmd->name, argv[0]) == 0 ) break;
+
+	if ( cmd->name == NULL ) usage();
+
+	if ( ! backend_open(&be, backend) ) return 1;
+
+	if ( stats != STATS_OFF ) {
+		status= be.e_stats_enable(be.eid, &rv, stats);
+		if ( status != SGX_SUCCESS ) {
+			fprintf(stderr, "ECALL e_stats_enable: 0x%04x\n", status);
+			return 1;
+		}
+	}
+
+	if ( heap && ! heap_snapshot(&be, &before, 1) ) return 1;
+
+	rv= cmd->run(&be, argc-1, &argv[1]);
+
+	if ( stats != STATS_OFF && print_stats(&be) != 0 ) return 1;
+
+	/*
+	 * Commands fetch their results, so anything still allocated after
+	 * one runs is a leak (or a cache, like the small primes table).
+	 */
+
+	if ( heap ) {
+		if ( ! heap_snapshot(&be, &after, 0) ) return 1;
+		heap_stats_print(&before, &after);
+	}
+
+	return rv;
+}
+
+static int print_stats (struct backend *be)
+{
+	struct ecall_stats s[STATS_NECALLS];
+	sgx_status_t status;
+	size_t need;
+
+	status= be->e_get_stats(be->eid, &need, STATS_ALL_THREADS,
+		(unsigned char *) s, sizeof(s), 0);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_get_stats: 0x%04x\n", status);
+		return 1;
+	}
+	if ( need != sizeof(s) ) {
+		fprintf(stderr, "e_get_stats: enclave has %lu bytes of counters, "
+			"expected %lu\n", (unsigned long) need,
+			(unsigned long) sizeof(s));
+		return 1;
+	}
+
+	ecall_stats_print(s);
+
+	return 0;
+}
+
+static unsigned char *fetch_result (struct backend *be, size_t len)
+{
+	sgx_status_t status;
+	unsigned char *buf;
+	int rv;
+
+	buf= malloc(len+1);
+	if ( buf == NULL ) {
+		perror("malloc");
+		return NULL;
+	}
+
+	status= be->e_get_result(be->eid, &rv, (char *) buf, len);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_get_result: 0x%04x\n", status);
+		free(buf);
+		return NULL;
+	}
+	if ( rv == 0 ) {
+		fprintf(stderr, "e_get_result: bad parameters\n");
+		free(buf);
+		return NULL;
+	}
+
+	return buf;
+}
+
+/* Print each integer in a batch result on its own line. */
+
+static int print_batch (unsigned char *buf, size_t len)
+{
+	mpz_t *vals;
+	size_t i, n;
+
+	n= mpz_batch_count(buf, len);
+	if ( n == (size_t) -1 ) {
+		fprintf(stderr, "mpz_batch_count: bad batch\n");
+		return 1;
+	}
+
+	vals= malloc(n*sizeof(mpz_t));
+	if ( vals == NULL && n ) {
+		perror("malloc");
+		return 1;
+	}
+
+	for (i= 0; i< n; ++i) mpz_init(vals[i]);
+
+	if ( mpz_batch_deserialize(vals, n, buf, len) == -1 ) {
+		fprintf(stderr, "mpz_batch_deserialize: bad batch\n");
+		return 1;
+	}
+
+	for (i= 0; i< n; ++i) {
+		gmp_printf("%Zd\n", vals[i]);
+		mpz_clear(vals[i]);
+	}
+
+	free(vals);
+
+	return 0;
+}
+
+/*
+ * Convert base 10 arguments to the batch format. If order is not NULL,
+ * the value from argv[order[i]] goes in position i.
+ */
+
+static unsigned char *pack_args (int argc, char *argv[], int *order,
+	size_t *len)
+{
+	unsigned char *buf= NULL;
+	mpz_t *vals;
+	int i, bad= 0;
+
+	vals= malloc(argc*sizeof(mpz_t));
+	if ( vals == NULL ) {
+		perror("malloc");
+		return NULL;
+	}
+
+	for (i= 0; i< argc; ++i) {
+		char *arg= argv[(order == NULL) ? i : order[i]];
+
+		if ( mpz_init_set_str(vals[i], arg, 10) == -1 ) {
+			fprintf(stderr, "%s: not a base 10 integer\n", arg);
+			bad= 1;
+		}
+	}
+
+	if ( ! bad ) {
+		buf= mpz_batch_serialize(vals, argc, len);
+		if ( buf == NULL ) fprintf(stderr, "mpz_batch_serialize: failed\n");
+	}
+
+	for (i= 0; i< argc; ++i) mpz_clear(vals[i]);
+	free(vals);
+
+	return buf;
+}
+
+/* Rationals are given as num/den, or just num. */
+
+static unsigned char *pack_rationals (int argc, char *argv[], size_t *len)
+{
+	unsigned char *buf= NULL;
+	mpq_t *vals;
+	int i, bad= 0;
+
+	vals= malloc(argc*sizeof(mpq_t));
+	if ( vals == NULL ) {
+		perror("malloc");
+		return NULL;
+	}
+
+	for (i= 0; i< argc; ++i) {
+		mpq_init(vals[i]);
+		if ( mpq_set_str(vals[i], argv[i], 10) == -1 ||
+			mpz_sgn(mpq_denref(vals[i])) == 0 ) {
+
+			fprintf(stderr, "%s: not a base 10 rational\n", argv[i]);
+			bad= 1;
+		}
+	}
+
+	if ( ! bad ) {
+		buf= mpq_batch_serialize(vals, argc, len);
+		if ( buf == NULL ) fprintf(stderr, "mpq_batch_serialize: failed\n");
+	}
+
+	for (i= 0; i< argc; ++i) mpq_clear(vals[i]);
+	free(vals);
+
+	return buf;
+}
+
+static int print_qbatch (unsigned char *buf, size_t len)
+{
+	mpq_t *vals;
+	size_t i, n;
+
+	n= mpq_batch_count(buf, len);
+	if ( n == (size_t) -1 ) {
+		fprintf(stderr, "mpq_batch_count: bad batch\n");
+		return 1;
+	}
+
+	vals= malloc(n*sizeof(mpq_t));
+	if ( vals == NULL && n ) {
+		perror("malloc");
+		return 1;
+	}
+
+	for (i= 0; i< n; ++i) mpq_init(vals[i]);
+
+	if ( mpq_batch_deserialize(vals, n, buf, len) == -1 ) {
+		fprintf(stderr, "mpq_batch_deserialize: bad batch\n");
+		return 1;
+	}
+
+	for (i= 0; i< n; ++i) {
+		gmp_printf("%Qd\n", vals[i]);
+		mpq_clear(vals[i]);
+	}
+
+	free(vals);
+
+	return 0;
+}
+
+static void free_packed (unsigned char *buf, size_t len)
+{
+	void (*gmp_free)(void *, size_t);
+
+	mp_get_memory_functions(NULL, NULL, &gmp_free);
+	gmp_free(buf, len);
+}
+
+/*
+ * Run the job that was just posted in the enclave and print the
+ * batch it produces.
+ */
+
+static int run_job (struct backend *be, const char *name)
+{
+	sgx_status_t status;
+	unsigned char *buf;
+	size_t len;
+	int rv;
+
+	status= enclave_run_job(be, nthreads, &len);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_worker: 0x%04x\n", status);
+		return 1;
+	}
+	if ( len == 0 ) {
+		fprintf(stderr, "%s: no result\n", name);
+		return 1;
+	}
+
+	buf= fetch_result(be, len);
+	if ( buf == NULL ) return 1;
+
+	rv= print_batch(buf, len);
+	free(buf);
+
+	return rv;
+}
+
+static int cmd_prime (struct backend *be, int argc, char *argv[])
+{
+	sgx_status_t status;
+	unsigned long bits, count;
+	int reps= DEFAULT_PRIME_REPS;
+	int rv;
+
+	if ( argc < 2 || argc > 3 ) usage();
+
+	bits= strtoul(argv[0], NULL, 10);
+	count= strtoul(argv[1], NULL, 10);
+	if ( argc == 3 ) reps= atoi(argv[2]);
+
+	status= be->e_prime_gen(be->eid, &rv, (uint32_t) bits,
+		(uint32_t) count, reps);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_prime_gen: 0x%04x\n", status);
+		return 1;
+	}
+	if ( rv == 0 ) {
+		fprintf(stderr, "e_prime_gen: invalid parameters\n");
+		return 1;
+	}
+
+	return run_job(be, "e_prime_gen");
+}
+
+static int cmd_rand (struct backend *be, int argc, char *argv[])
+{
+	if ( argc < 2 || argc > 3 ) usage();
+
+	return rand_gen(be, NULL, 0, strtoul(argv[0], NULL, 10), argc-1,
+		&argv[1]);
+}
+
+static int cmd_randbelow (struct backend *be, int argc, char *argv[])
+{
+	unsigned char *buf;
+	size_t len;
+	int rv;
+
+	if ( argc < 2 || argc > 3 ) usage();
+
+	buf= pack_args(1, argv, NULL, &len);
+	if ( buf == NULL ) return 1;
+
+	rv= rand_gen(be, buf, len, 0, argc-1, &argv[1]);
+	free_packed(buf, len);
+
+	return rv;
+}
+
+/* argv is the count and, optionally, the word "fast" */
+
+static int rand_gen (struct backend *be, unsigned char *buf, size_t len,
+	unsigned long bits, int argc, char *argv[])
+{
+	sgx_status_t status;
+	unsigned long count;
+	int fast= 0;
+	int rv;
+
+	count= strtoul(argv[0], NULL, 10);
+	if ( argc == 2 ) {
+		if ( strcmp(argv[1], "fast") ) usage();
+		fast= 1;
+	}
+
+	status= be->e_rand_gen(be->eid, &rv, buf, len, (uint32_t) bits,
+		(uint32_t) count, fast);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_rand_gen: 0x%04x\n", status);
+		return 1;
+	}
+	if ( rv == 0 ) {
+		fprintf(stderr, "e_rand_gen: invalid parameters\n");
+		return 1;
+	}
+
+	return run_job(be, "e_rand_gen");
+}
+
+static int cmd_multiexp (struct backend *be, int argc, char *argv[])
+{
+	sgx_status_t status;
+	unsigned char *buf;
+	int *order;
+	int i, n, rv;
+	size_t len, rlen;
+
+	if ( argc < 3 || argc%2 != 1 ) usage();
+
+	/* The enclave wants modulus, bases, exponents. */
+
+	n= (argc-1)/2;
+	order= malloc(argc*sizeof(int));
+	if ( order == NULL ) {
+		perror("malloc");
+		return 1;
+	}
+
+	order[0]= 0;
+	for (i= 0; i< n; ++i) {
+		order[1+i]= 1+2*i;
+		order[1+n+i]= 2+2*i;
+	}
+
+	buf= pack_args(argc, argv, order, &len);
+	free(order);
+	if ( buf == NULL ) return 1;
+
+	status= be->e_multi_exp(be->eid, &rlen, buf, len);
+	free_packed(buf, len);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_multi_exp: 0x%04x\n", status);
+		return 1;
+	}
+	if ( rlen == 0 ) {
+		fprintf(stderr, "e_multi_exp: invalid result\n");
+		return 1;
+	}
+
+	buf= fetch_result(be, rlen);
+	if ( buf == NULL ) return 1;
+
+	rv= print_batch(buf, rlen);
+	free(buf);
+
+	return rv;
+}
+
+static int qfold (struct backend *be, int argc, char *argv[],
+	qfold_ecall_t ecall, const char *name)
+{
+	sgx_status_t status;
+	unsigned char *buf;
+	size_t len, rlen;
+	int rv;
+
+	if ( argc < 2 ) usage();
+
+	buf= pack_rationals(argc, argv, &len);
+	if ( buf == NULL ) return 1;
+
+	status= ecall(be->eid, &rlen, buf, len, canonical);
+	free_packed(buf, len);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL %s: 0x%04x\n", name, status);
+		return 1;
+	}
+	if ( rlen == 0 ) {
+		fprintf(stderr, "%s: invalid result\n", name);
+		return 1;
+	}
+
+	buf= fetch_result(be, rlen);
+	if ( buf == NULL ) return 1;
+
+	rv= print_qbatch(buf, rlen);
+	free(buf);
+
+	return rv;
+}
+
+static int cmd_qadd (struct backend *be, int argc, char *argv[])
+{
+	return qfold(be, argc, argv, be->e_mpq_add, "e_mpq_add");
+}
+
+static int cmd_qsub (struct backend *be, int argc, char *argv[])
+{
+	return qfold(be, argc, argv, be->e_mpq_sub, "e_mpq_sub");
+}
+
+static int cmd_qmul (struct backend *be, int argc, char *argv[])
+{
+	return qfold(be, argc, argv, be->e_mpq_mul, "e_mpq_mul");
+}
+
+static int cmd_qdiv (struct backend *be, int argc, char *argv[])
+{
+	return qfold(be, argc, argv, be->e_mpq_div, "e_mpq_div");
+}
+
+static int cmd_qcanon (struct backend *be, int argc, char *argv[])
+{
+	sgx_status_t status;
+	unsigned char *buf;
+	size_t len, rlen;
+	int rv;
+
+	if ( argc < 1 ) usage();
+
+	buf= pack_rationals(argc, argv, &len);
+	if ( buf == NULL ) return 1;
+
+	status= be->e_mpq_canonicalize(be->eid, &rlen, buf, len);
+	free_packed(buf, len);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_mpq_canonicalize: 0x%04x\n", status);
+		return 1;
+	}
+	if ( rlen == 0 ) {
+		fprintf(stderr, "e_mpq_canonicalize: invalid result\n");
+		return 1;
+	}
+
+	buf= fetch_result(be, rlen);
+	if ( buf == NULL ) return 1;
+
+	rv= print_qbatch(buf, rlen);
+	free(buf);
+
+	return rv;
+}
+
+static int cmd_qcmp (struct backend *be, int argc, char *argv[])
+{
+	sgx_status_t status;
+	unsigned char *buf;
+	size_t len;
+	int rv, cmp;
+
+	if ( argc != 2 ) usage();
+
+	buf= pack_rationals(argc, argv, &len);
+	if ( buf == NULL ) return 1;
+
+	status= be->e_mpq_cmp(be->eid, &rv, buf, len, &cmp);
+	free_packed(buf, len);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_mpq_cmp: 0x%04x\n", status);
+		return 1;
+	}
+	if ( rv == 0 ) {
+		fprintf(stderr, "e_mpq_cmp: bad parameters\n");
+		return 1;
+	}
+
+	printf("%d\n", cmp);
+
+	return 0;
+}
+
+static int cmd_sum (struct backend *be, int argc, char *argv[])
+{
+	sgx_status_t status;
+	unsigned char *buf;
+	size_t len;
+	int rv;
+
+	if ( argc < 1 ) usage();
+
+	buf= pack_args(argc, argv, NULL, &len);
+	if ( buf == NULL ) return 1;
+
+	status= be->e_vec_sum(be->eid, &rv, buf, len);
+	free_packed(buf, len);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_vec_sum: 0x%04x\n", status);
+		return 1;
+	}
+	if ( rv == 0 ) {
+		fprintf(stderr, "e_vec_sum: invalid parameters\n");
+		return 1;
+	}
+
+	return run_job(be, "e_vec_sum");
+}
+
+static int cmd_dot (struct backend *be, int argc, char *argv[])
+{
+	sgx_status_t status;
+	unsigned char *buf_a, *buf_b;
+	size_t len_a, len_b;
+	int n, rv;
+
+	if ( argc < 2 || argc%2 ) usage();
+
+	n= argc/2;
+
+	buf_a= pack_args(n, argv, NULL, &len_a);
+	if ( buf_a == NULL ) return 1;
+
+	buf_b= pack_args(n, &argv[n], NULL, &len_b);
+	if ( buf_b == NULL ) {
+		free_packed(buf_a, len_a);
+		return 1;
+	}
+
+	status= be->e_vec_dot(be->eid, &rv, buf_a, len_a, buf_b, len_b);
+	free_packed(buf_a, len_a);
+	free_packed(buf_b, len_b);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_vec_dot: 0x%04x\n", status);
+		return 1;
+	}
+	if ( rv == 0 ) {
+		fprintf(stderr, "e_vec_dot: invalid parameters\n");
+		return 1;
+	}
+
+	return run_job(be, "e_vec_dot");
+}
+
+static int cmd_mul (struct backend *be, int argc, char *argv[])
+{
+	sgx_status_t status;
+	unsigned char *buf;
+	size_t len;
+	int rv;
+
+	if ( argc != 2 ) usage();
+
+	buf= pack_args(argc, argv, NULL, &len);
+	if ( buf == NULL ) return 1;
+
+	status= be->e_mul_job(be->eid, &rv, buf, len,
+		enclave_threads(nthreads));
+	free_packed(buf, len);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_mul_job: 0x%04x\n", status);
+		return 1;
+	}
+	if ( rv == 0 ) {
+		fprintf(stderr, "e_mul_job: invalid parameters\n");
+		return 1;
+	}
+
+	return run_job(be, "e_mul_job");
+}
+
+static int cmd_lucas (struct backend *be, int argc, char *argv[])
+{
+	sgx_status_t status;
+	unsigned char *buf;
+	char *zero= "0";
+	char *args[3];
+	size_t len, rlen;
+	uint64_t n;
+	int rv;
+
+	if ( argc < 3 || argc > 4 ) usage();
+
+	n= strtoull(argv[0], NULL, 10);
+
+	args[0]= argv[1];
+	args[1]= argv[2];
+	args[2]= ( argc == 4 ) ? argv[3] : zero;
+
+	buf= pack_args(3, args, NULL, &len);
+	if ( buf == NULL ) return 1;
+
+	status= be->e_lucas(be->eid, &rlen, buf, len, n);
+	free_packed(buf, len);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_lucas: 0x%04x\n", status);
+		return 1;
+	}
+	if ( rlen == 0 ) {
+		fprintf(stderr, "e_lucas: invalid parameters\n");
+		return 1;
+	}
+
+	buf= fetch_result(be, rlen);
+	if ( buf == NULL ) return 1;
+
+	rv= print_batch(buf, rlen);
+	free(buf);
+
+	return rv;
+}
+
+static int cmd_linrec (struct backend *be, int argc, char *argv[])
+{
+	sgx_status_t status;
+	unsigned char *buf;
+	size_t len;
+	uint64_t n;
+	int rv;
+
+	if ( argc < 4 || argc%2 ) usage();
+
+	n= strtoull(argv[0], NULL, 10);
+
+	buf= pack_args(argc-1, &argv[1], NULL, &len);
+	if ( buf == NULL ) return 1;
+
+	status= be->e_linrec_job(be->eid, &rv, buf, len, n);
+	free_packed(buf, len);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_linrec_job: 0x%04x\n", status);
+		return 1;
+	}
+	if ( rv == 0 ) {
+		fprintf(stderr, "e_linrec_job: invalid parameters\n");
+		return 1;
+	}
+
+	return run_job(be, "e_linrec_job");
+}
+
+/* Convert a base 10 string to a little-endian, fixed-width operand. */
+
+static int to_fixed (const char *s, unsigned char *buf, size_t len)
+{
+	mpz_t x;
+	size_t count= 0;
+
+	if ( mpz_init_set_str(x, s, 10) == -1 || mpz_sgn(x) < 0 ||
+		mpz_sizeinbase(x, 256) > len ) {
+
+		fprintf(stderr, "%s: not a %lu-bit unsigned integer\n", s,
+			(unsigned long) len*8);
+		mpz_clear(x);
+		return 0;
+	}
+
+	memset(buf, 0, len);
+	mpz_export(buf, &count, -1, 1, 0, 0, x);
+	mpz_clear(x);
+
+	return 1;
+}
+
+static int fixed (struct backend *be, int argc, char *argv[],
+	fixed_ecall_t ecall, const char *name)
+{
+	sgx_status_t status;
+	unsigned char *a, *b, *c;
+	unsigned long bits;
+	size_t len;
+	mpz_t x;
+	int rv;
+
+	if ( argc != 3 ) usage();
+
+	bits= strtoul(argv[0], NULL, 10);
+	len= bits/8;
+
+	a= malloc(len);
+	b= malloc(len);
+	c= malloc(len);
+	if ( a == NULL || b == NULL || c == NULL ) {
+		perror("malloc");
+		return 1;
+	}
+
+	if ( ! to_fixed(argv[1], a, len) || ! to_fixed(argv[2], b, len) )
+		return 1;
+
+	status= ecall(be->eid, &rv, (uint32_t) bits, a, b, c, len);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL %s: 0x%04x\n", name, status);
+		return 1;
+	}
+	if ( rv == -1 ) {
+		fprintf(stderr, "%s: unsupported width\n", name);
+		return 1;
+	}
+
+	mpz_init(x);
+	mpz_import(x, len, -1, 1, 0, 0, c);
+	gmp_printf("%Zd\n", x);
+	if ( rv ) printf("carry\n");
+
+	mpz_clear(x);
+	free(a);
+	free(b);
+	free(c);
+
+	return 0;
+}
+
+static int cmd_fadd (struct backend *be, int argc, char *argv[])
+{
+	return fixed(be, argc, argv, be->e_fixed_add, "e_fixed_add");
+}
+
+static int cmd_fsub (struct backend *be, int argc, char *argv[])
+{
+	return fixed(be, argc, argv, be->e_fixed_sub, "e_fixed_sub");
+}
+
+static int cmd_fmul (struct backend *be, int argc, char *argv[])
+{
+	sgx_status_t status;
+	unsigned char *a, *b, *c;
+	unsigned long bits;
+	size_t len;
+	mpz_t x;
+	int rv;
+
+	if ( argc != 3 ) usage();
+
+	bits= strtoul(argv[0], NULL, 10);
+	len= bits/8;
+
+	a= malloc(len);
+	b= malloc(len);
+	c= malloc(2*len);
+	if ( a == NULL || b == NULL || c == NULL ) {
+		perror("malloc");
+		return 1;
+	}
+
+	if ( ! to_fixed(argv[1], a, len) || ! to_fixed(argv[2], b, len) )
+		return 1;
+
+	status= be->e_fixed_mul(be->eid, &rv, (uint32_t) bits, a, b, len,
+		c, 2*len);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_fixed_mul: 0x%04x\n", status);
+		return 1;
+	}
+	if ( rv == -1 ) {
+		fprintf(stderr, "e_fixed_mul: unsupported width\n");
+		return 1;
+	}
+
+	mpz_init(x);
+	mpz_import(x, 2*len, -1, 1, 0, 0, c);
+	gmp_printf("%Zd\n", x);
+
+	mpz_clear(x);
+	free(a);
+	free(b);
+	free(c);
+
+	return 0;
+}
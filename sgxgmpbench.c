@@ -0,0 +1,607 @@
+/*
+
+Copyright 2018 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <sgx_urts.h>
+#include <gmp.h>
+#include <limits.h>
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "EnclaveGmpTest_u.h"
+#include "async.h"
+#include "backend.h"
+#include "bench_ops.h"
+#include "serialize.h"
+
+#define IS_FDIV(op)	( (op) == BENCH_FDIV || (op) >= BENCH_FDIV_FLOAT )
+
+#define DEFAULT_MIN_BITS	64
+#define DEFAULT_MAX_BYTES	(64UL*1024*1024)
+#define DEFAULT_MAX_PI_DIGITS	100000
+#define DEFAULT_MIN_TIME	0.1
+#define MAX_REPS		1000000
+#define MAX_DIGIT_COUNTS	16
+
+#ifdef SGX_HW_SIM
+#define BENCH_MODE "sim"
+#else
+#define BENCH_MODE "hw"
+#endif
+
+static const char *op_names[BENCH_NOPS]= {
+	"add", "mul", "div", "fdiv", "pi", "fdiv_float", "fdiv_fixed"
+};
+
+/*
+ * Totals for one operation at one size. Everything is in nanoseconds
+ * and averaged over reps when printed.
+ *
+ *   host_marshal  serializing the operands on the host
+ *   ecall         the whole ECALL, as seen from the host
+ *   unmarshal     deserializing the operands in the enclave
+ *   compute       the arithmetic itself
+ *   marshal       serializing the result in the enclave
+ *   fetch         e_get_result plus deserializing on the host
+ */
+
+struct sample {
+	const char *op;
+	unsigned long bits;
+	unsigned long digits;
+	unsigned long reps;
+	double host_marshal;
+	double ecall;
+	double unmarshal;
+	double compute;
+	double marshal;
+	double fetch;
+	int ok;
+};
+
+static const char *mode= BENCH_MODE;
+static int json= 0;
+static int nrows= 0;
+static double min_time= DEFAULT_MIN_TIME;
+
+void usage ();
+
+static uint64_t now_ns ();
+static void emit (struct sample *s);
+static void bench_nop (struct backend *be);
+static void bench_async (struct backend *be, int workers,
+	unsigned long bits, gmp_randstate_t rs);
+static void async_count (struct async_op *op, void *arg);
+static int bench_op (struct backend *be, int op, unsigned long bits,
+	unsigned long digits, gmp_randstate_t rs);
+static int bench_mul_job (struct backend *be, int ways, unsigned long bits,
+	gmp_randstate_t rs);
+
+void usage () {
+	fprintf(stderr, "usage: sgxgmpbench [-j] [-b backend] [-o op,...] [-s min_bits]\n");
+	fprintf(stderr, "          [-m max_bytes] [-f factor] [-p max_pi_digits]\n");
+	fprintf(stderr, "          [-t min_seconds] [-A async_workers] "
+		"[-d digits,...]\n");
+	fprintf(stderr, "          [-J ways]\n");
+	fprintf(stderr, "  -A  also time nop and add through the async engine\n");
+	fprintf(stderr, "  -b  sgx or native (default: $%s, or sgx)\n",
+		BACKEND_ENV);
+	fprintf(stderr, "  -j  write JSON instead of CSV\n");
+	fprintf(stderr, "  -J  also time mul as an e_mul_job cut for this many "
+		"threads\n");
+	fprintf(stderr, "  -d  digits for the fdiv operations (default: to match "
+		"the operands)\n");
+	fprintf(stderr, "  -o  operations: add,mul,div,fdiv,pi,fdiv_float,fdiv_fixed "
+		"(default: all)\n");
+	fprintf(stderr, "  -s  smallest operand, in bits (default: %d)\n",
+		DEFAULT_MIN_BITS);
+	fprintf(stderr, "  -m  largest operand, in bytes (default: %lu)\n",
+		DEFAULT_MAX_BYTES);
+	fprintf(stderr, "  -f  size multiplier between steps (default: 4)\n");
+	fprintf(stderr, "  -p  largest pi computation, in digits (default: %d)\n",
+		DEFAULT_MAX_PI_DIGITS);
+	fprintf(stderr, "  -t  minimum time to spend on each size (default: %.1f)\n",
+		DEFAULT_MIN_TIME);
+	exit(1);
+}
+
+int main (int argc, char *argv[])
+{
+	struct backend be;
+	const char *backend= NULL;
+	unsigned long min_bits= DEFAULT_MIN_BITS;
+	unsigned long max_bytes= DEFAULT_MAX_BYTES;
+	unsigned long max_pi= DEFAULT_MAX_PI_DIGITS;
+	unsigned long factor= 4;
+	unsigned long bits;
+	int async_workers= 0;
+	int mul_ways= 0;
+	unsigned long digit_counts[MAX_DIGIT_COUNTS];
+	int ops[BENCH_NOPS]= { 1, 1, 1, 1, 1, 1, 1 };
+	int ndigit_counts= 0;
+	gmp_randstate_t rs;
+	int opt, op, i;
+
+	while ( (opt= getopt(argc, argv, "A:b:d:f:hjJ:m:o:p:s:t:")) != -1 ) {
+		char *tok;
+
+		switch (opt) {
+		case 'A':
+			async_workers= atoi(optarg);
+			if ( async_workers < 1 ) usage();
+			break;
+		case 'b':
+			backend= optarg;
+			break;
+		case 'd':
+			ndigit_counts= 0;
+			for (tok= strtok(optarg, ","); tok; tok= strtok(NULL, ",")) {
+				if ( ndigit_counts == MAX_DIGIT_COUNTS ) usage();
+				digit_counts[ndigit_counts]= strtoul(tok, NULL, 10);
+				if ( digit_counts[ndigit_counts] == 0 ||
+					digit_counts[ndigit_counts] > INT_MAX )
+				{
+					usage();
+				}
+				++ndigit_counts;
+			}
+			break;
+		case 'f':
+			factor= strtoul(optarg, NULL, 10);
+			if ( factor < 2 ) usage();
+			break;
+		case 'j':
+			json= 1;
+			break;
+		case 'J':
+			mul_ways= atoi(optarg);
+			if ( mul_ways < 1 ) usage();
+			break;
+		case 'm':
+			max_bytes= strtoul(optarg, NULL, 10);
+			break;
+		case 'o':
+			memset(ops, 0, sizeof(ops));
+			for (tok= strtok(optarg, ","); tok; tok= strtok(NULL, ",")) {
+				for (op= 0; op< BENCH_NOPS; ++op)
+					if ( strcmp(tok, op_names[op]) == 0 ) break;
+				if ( op == BENCH_NOPS ) usage();
+				ops[op]= 1;
+			}
+			break;
+		case 'p':
+			max_pi= strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			min_bits= strtoul(optarg, NULL, 10);
+			if ( min_bits == 0 ) usage();
+			break;
+		case 't':
+			min_time= atof(optarg);
+			break;
+		case 'h':
+		default:
+			usage();
+		}
+	}
+
+	argc-= optind;
+	argv+= optind;
+
+	if ( argc != 0 ) usage();
+
+	if ( ! backend_open(&be, backend) ) return 1;
+	if ( strcmp(be.name, "native") == 0 ) mode= be.name;
+
+	gmp_randinit_default(rs);
+
+	if ( json ) printf("[\n");
+	else printf("mode,op,bits,digits,reps,host_marshal_ns,ecall_ns,"
+		"unmarshal_ns,compute_ns,marshal_ns,fetch_ns,ok\n");
+
+	bench_nop(&be);
+	if ( async_workers ) bench_async(&be, async_workers, min_bits, rs);
+
+	for (op= 0; op< BENCH_NOPS; ++op) {
+		if ( ! ops[op] ) continue;
+
+		for (bits= min_bits; bits/8 <= max_bytes; bits*= factor) {
+			unsigned long digits= 0;
+
+			/*
+			 * Floating point results are sized to match the operands,
+			 * unless -d gave the digit counts to try.
+			 */
+
+			if ( IS_FDIV(op) && ndigit_counts ) {
+				for (i= 0; i< ndigit_counts; ++i)
+					if ( ! bench_op(&be, op, bits, digit_counts[i], rs) )
+						break;
+				if ( i < ndigit_counts ) break;
+				continue;
+			}
+
+			if ( IS_FDIV(op) || op == BENCH_PI )
+				digits= (unsigned long) (bits*log10(2))+1;
+			if ( op == BENCH_PI && digits > max_pi ) break;
+
+			/* Once a size fails the larger ones will too. */
+
+			if ( ! bench_op(&be, op, bits, digits, rs) ) break;
+			if ( op == BENCH_MUL && mul_ways &&
+				! bench_mul_job(&be, mul_ways, bits, rs) )
+			{
+				break;
+			}
+		}
+	}
+
+	if ( json ) printf("\n]\n");
+
+	return 0;
+}
+
+static uint64_t now_ns ()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec*1000000000ULL+(uint64_t) ts.tv_nsec;
+}
+
+static void emit (struct sample *s)
+{
+	double n= (s->reps) ? (double) s->reps : 1.0;
+
+	if ( json ) {
+		printf("%s  {\"mode\": \"%s\", \"op\": \"%s\", \"bits\": %lu, "
+			"\"digits\": %lu, \"reps\": %lu, \"host_marshal_ns\": %.0f, "
+			"\"ecall_ns\": %.0f, \"unmarshal_ns\": %.0f, "
+			"\"compute_ns\": %.0f, \"marshal_ns\": %.0f, "
+			"\"fetch_ns\": %.0f, \"ok\": %s}",
+			(nrows) ? ",\n" : "", mode, s->op, s->bits, s->digits,
+			s->reps, s->host_marshal/n, s->ecall/n, s->unmarshal/n,
+			s->compute/n, s->marshal/n, s->fetch/n,
+			(s->ok) ? "true" : "false");
+	} else {
+		printf("%s,%s,%lu,%lu,%lu,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%d\n",
+			mode, s->op, s->bits, s->digits, s->reps,
+			s->host_marshal/n, s->ecall/n, s->unmarshal/n, s->compute/n,
+			s->marshal/n, s->fetch/n, s->ok);
+	}
+
+	fflush(stdout);
+	++nrows;
+}
+
+/* The bare cost of entering and leaving the enclave */
+
+static void bench_nop (struct backend *be)
+{
+	struct sample s;
+	uint64_t start, t;
+
+	memset(&s, 0, sizeof(s));
+	s.op= "nop";
+	s.ok= 1;
+
+	start= now_ns();
+	do {
+		t= now_ns();
+		if ( be->e_nop(be->eid) != SGX_SUCCESS ) {
+			s.ok= 0;
+			break;
+		}
+		s.ecall+= (double) (now_ns()-t);
+		++s.reps;
+	} while ( now_ns()-start < min_time*1e9 && s.reps < MAX_REPS );
+
+	emit(&s);
+}
+
+/*
+ * Throughput through the async engine. Operations are submitted as
+ * fast as they can be, with as many in flight as the ring holds, and
+ * ecall_ns is the wall time per operation from the first submission
+ * to the last completion.
+ */
+
+struct async_tally {
+	unsigned long done;
+	unsigned long failed;
+};
+
+static void bench_async (struct backend *be, int workers,
+	unsigned long bits, gmp_randstate_t rs)
+{
+	struct async_engine *eng;
+	struct async_tally tally;
+	struct sample s;
+	mpz_t a, b;
+	unsigned long sent;
+	uint64_t start;
+	int i;
+
+	eng= async_start(be, workers);
+	if ( eng == NULL ) {
+		fprintf(stderr, "async_start: could not start the engine\n");
+		return;
+	}
+
+	mpz_inits(a, b, NULL);
+	mpz_urandomb(a, rs, bits);
+	mpz_urandomb(b, rs, bits);
+
+	for (i= 0; i< 2; ++i) {
+		memset(&s, 0, sizeof(s));
+		memset(&tally, 0, sizeof(tally));
+		s.op= ( i ) ? "async_add" : "async_nop";
+		s.bits= ( i ) ? bits : 0;
+		sent= 0;
+
+		start= now_ns();
+		do {
+			struct async_op *op= ( i ) ?
+				async_mpz_add(eng, a, b, async_count, &tally) :
+				async_nop(eng, async_count, &tally);
+
+			if ( op == NULL ) break;
+			++sent;
+		} while ( now_ns()-start < min_time*1e9 && sent < MAX_REPS );
+
+		while ( __atomic_load_n(&tally.done, __ATOMIC_ACQUIRE) < sent )
+			sched_yield();
+
+		s.reps= sent;
+		s.ecall= (double) (now_ns()-start);
+		s.ok= ( sent && ! tally.failed );
+		emit(&s);
+	}
+
+	mpz_clears(a, b, NULL);
+	async_stop(eng);
+}
+
+/* Runs on the engine's completion thread. */
+
+static void async_count (struct async_op *op, void *arg)
+{
+	struct async_tally *tally= (struct async_tally *) arg;
+
+	if ( op->status != ASYNC_DONE ) ++tally->failed;
+	__atomic_add_fetch(&tally->done, 1, __ATOMIC_RELEASE);
+}
+
+static int bench_op (struct backend *be, int op, unsigned long bits,
+	unsigned long digits, gmp_randstate_t rs)
+{
+	struct sample s;
+	sgx_status_t status;
+	mpz_t a, b, c;
+	mpf_t fc;
+	uint64_t start, t, ns[4];
+	char *str_a= NULL, *str_b= NULL, *str_c;
+	size_t len;
+	int rv, i;
+
+	memset(&s, 0, sizeof(s));
+	s.op= op_names[op];
+	s.bits= bits;
+	s.digits= digits;
+	s.ok= 1;
+
+	mpz_inits(a, b, c, NULL);
+	mpf_init(fc);
+
+	/* Divisors are half the size of the dividend. */
+
+	mpz_urandomb(a, rs, bits);
+	mpz_setbit(a, bits-1);
+	if ( op == BENCH_DIV || IS_FDIV(op) ) {
+		mpz_urandomb(b, rs, (bits > 1) ? bits/2 : 1);
+		mpz_setbit(b, (bits > 1) ? bits/2-1 : 0);
+	} else {
+		mpz_urandomb(b, rs, bits);
+		mpz_setbit(b, bits-1);
+	}
+
+	start= now_ns();
+	do {
+		if ( op != BENCH_PI ) {
+			t= now_ns();
+			str_a= mpz_serialize(a);
+			str_b= mpz_serialize(b);
+			s.host_marshal+= (double) (now_ns()-t);
+		}
+
+		t= now_ns();
+		status= be->e_bench_op(be->eid, &len, op, (str_a) ? str_a : "",
+			(str_b) ? str_b : "", (int) digits, ns);
+		s.ecall+= (double) (now_ns()-t);
+
+		str_free(str_a);
+		str_free(str_b);
+		str_a= str_b= NULL;
+
+		if ( status != SGX_SUCCESS || len == 0 ) {
+			s.ok= 0;
+			break;
+		}
+
+		/* Take out the cost of the clock OCALL itself. */
+
+		for (i= 0; i< 3; ++i) if ( ns[i] > ns[3] ) ns[i]-= ns[3];
+		s.unmarshal+= (double) ns[0];
+		s.compute+= (double) ns[1];
+		s.marshal+= (double) ns[2];
+
+		t= now_ns();
+		str_c= malloc(len+1);
+		status= be->e_get_result(be->eid, &rv, str_c, len);
+		if ( status != SGX_SUCCESS || rv == 0 ) {
+			free(str_c);
+			s.ok= 0;
+			break;
+		}
+		if ( IS_FDIV(op) || op == BENCH_PI )
+			rv= mpf_deserialize(&fc, str_c, (int) digits);
+		else
+			rv= mpz_deserialize(&c, str_c);
+		s.fetch+= (double) (now_ns()-t);
+		free(str_c);
+
+		if ( rv == -1 ) {
+			s.ok= 0;
+			break;
+		}
+
+		++s.reps;
+	} while ( now_ns()-start < min_time*1e9 && s.reps < MAX_REPS );
+
+	emit(&s);
+
+	mpz_clears(a, b, c, NULL);
+	mpf_clear(fc);
+
+	return s.ok;
+}
+
+/*
+ * mul through e_mul_job, to find where splitting starts to pay. The
+ * host joins the job itself with one e_worker call, so the work items
+ * run one after another, and each phase gets a column of its own:
+ *
+ *   unmarshal  e_mul_job: unpacking and cutting up the operands
+ *   compute    e_worker: all of the work items
+ *   marshal    e_job_finish: interpolating and packing the product
+ *
+ * With enough threads for the items, the wall time would be about
+ * unmarshal + compute/items + marshal, where the job has 2k-1 items
+ * for Toom-k (k = (ways+1)/2, at most 4) and ways for slices. Below
+ * MUL_PAR_MIN_BITS the job is a single whole multiply, so build the
+ * enclave with a smaller one to sweep below it.
+ */
+
+static int bench_mul_job (struct backend *be, int ways, unsigned long bits,
+	gmp_randstate_t rs)
+{
+	struct sample s;
+	sgx_status_t status;
+	mpz_t vals[2], c;
+	uint64_t start, t;
+	void (*gmp_free)(void *, size_t);
+	unsigned char *buf, *res;
+	size_t len;
+	int rv;
+
+	mp_get_memory_functions(NULL, NULL, &gmp_free);
+
+	memset(&s, 0, sizeof(s));
+	s.op= "mul_job";
+	s.bits= bits;
+	s.digits= (unsigned long) ways;
+	s.ok= 1;
+
+	mpz_inits(vals[0], vals[1], c, NULL);
+
+	mpz_urandomb(vals[0], rs, bits);
+	mpz_setbit(vals[0], bits-1);
+	mpz_urandomb(vals[1], rs, bits);
+	mpz_setbit(vals[1], bits-1);
+
+	start= now_ns();
+	do {
+		t= now_ns();
+		buf= mpz_batch_serialize(vals, 2, &len);
+		s.host_marshal+= (double) (now_ns()-t);
+		if ( buf == NULL ) {
+			s.ok= 0;
+			break;
+		}
+
+		t= now_ns();
+		status= be->e_mul_job(be->eid, &rv, buf, len, ways);
+		s.unmarshal+= (double) (now_ns()-t);
+		gmp_free(buf, len);
+		if ( status != SGX_SUCCESS || rv == 0 ) {
+			s.ok= 0;
+			break;
+		}
+
+		t= now_ns();
+		status= be->e_worker(be->eid, &rv);
+		s.compute+= (double) (now_ns()-t);
+
+		t= now_ns();
+		if ( status == SGX_SUCCESS )
+			status= be->e_job_finish(be->eid, &len);
+		else
+			be->e_job_finish(be->eid, &len);
+		s.marshal+= (double) (now_ns()-t);
+		if ( status != SGX_SUCCESS || len == 0 ) {
+			s.ok= 0;
+			break;
+		}
+
+		t= now_ns();
+		res= malloc(len+1);
+		status= be->e_get_result(be->eid, &rv, (char *) res, len);
+		if ( status != SGX_SUCCESS || rv == 0 ) {
+			free(res);
+			s.ok= 0;
+			break;
+		}
+		rv= mpz_batch_deserialize(&c, 1, res, len);
+		s.fetch+= (double) (now_ns()-t);
+		free(res);
+
+		if ( rv == -1 ) {
+			s.ok= 0;
+			break;
+		}
+
+		++s.reps;
+	} while ( now_ns()-start < min_time*1e9 && s.reps < MAX_REPS );
+
+	s.ecall= s.unmarshal+s.compute+s.marshal;
+
+	emit(&s);
+
+	mpz_clears(vals[0], vals[1], c, NULL);
+
+	return s.ok;
+}
@@ -0,0 +1,176 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "sgxgmpclient.h"
+
+void usage ();
+
+static int check (const char *op, int rv);
+static uint64_t now_ns ();
+
+void usage () {
+	fprintf(stderr, "usage: sgxgmpc [-s socket] [-d digits] add|mul|div|fdiv num1 num2\n");
+	fprintf(stderr, "       sgxgmpc [-s socket] pi digits\n");
+	fprintf(stderr, "       sgxgmpc [-s socket] ping [count]\n");
+	fprintf(stderr, "  -s  socket path (default: $%s, or %s)\n",
+		SGXGMPD_SOCKET_ENV, SGXGMPD_SOCKET);
+	fprintf(stderr, "  -d  digits for fdiv (default: 12)\n");
+	exit(1);
+}
+
+int main (int argc, char *argv[])
+{
+	const char *path= NULL;
+	const char *op;
+	int digits= 12;
+	int opt, fd, rv= 0;
+
+	/* Stop at the operation, so that operands can be negative. */
+
+	while ( (opt= getopt(argc, argv, "+d:hs:")) != -1 ) {
+		switch (opt) {
+		case 'd':
+			digits= atoi(optarg);
+			if ( digits < 1 ) usage();
+			break;
+		case 's':
+			path= optarg;
+			break;
+		case 'h':
+		default:
+			usage();
+		}
+	}
+
+	argc-= optind;
+	argv+= optind;
+
+	if ( argc < 1 ) usage();
+	op= argv[0];
+
+	fd= sgxgmpd_connect(path);
+	if ( fd == -1 ) {
+		perror("sgxgmpd_connect");
+		return 1;
+	}
+
+	if ( strcmp(op, "pi") == 0 ) {
+		uint64_t pidigits;
+		mpf_t pi;
+
+		if ( argc != 2 ) usage();
+		pidigits= strtoull(argv[1], NULL, 10);
+		if ( pidigits == 0 ) usage();
+
+		mpf_init(pi);
+		rv= check(op, sgxgmpd_pi(fd, pi, pidigits));
+		if ( rv == 0 ) gmp_printf("%.*Ff\n", (int) pidigits, pi);
+		mpf_clear(pi);
+	} else if ( strcmp(op, "ping") == 0 ) {
+		unsigned long count= 1, i;
+		uint64_t start;
+
+		if ( argc > 2 ) usage();
+		if ( argc == 2 ) count= strtoul(argv[1], NULL, 10);
+		if ( count == 0 ) usage();
+
+		start= now_ns();
+		for (i= 0; i< count && rv == 0; ++i)
+			rv= check(op, sgxgmpd_nop(fd));
+		if ( rv == 0 ) printf("%lu round trips, %.1f us each\n", count,
+			(double) (now_ns()-start)/count/1000);
+	} else {
+		mpz_t a, b, c;
+		mpf_t fc;
+
+		if ( argc != 3 ) usage();
+
+		mpz_inits(a, b, c, NULL);
+		mpf_init(fc);
+		if ( mpz_set_str(a, argv[1], 10) == -1 ||
+			mpz_set_str(b, argv[2], 10) == -1 )
+		{
+			fprintf(stderr, "%s: operands must be base 10 integers\n", op);
+			return 1;
+		}
+
+		if ( strcmp(op, "add") == 0 ) {
+			rv= check(op, sgxgmpd_mpz_add(fd, c, a, b));
+			if ( rv == 0 ) gmp_printf("%Zd\n", c);
+		} else if ( strcmp(op, "mul") == 0 ) {
+			rv= check(op, sgxgmpd_mpz_mul(fd, c, a, b));
+			if ( rv == 0 ) gmp_printf("%Zd\n", c);
+		} else if ( strcmp(op, "div") == 0 ) {
+			rv= check(op, sgxgmpd_mpz_div(fd, c, a, b));
+			if ( rv == 0 ) gmp_printf("%Zd\n", c);
+		} else if ( strcmp(op, "fdiv") == 0 ) {
+			rv= check(op, sgxgmpd_mpf_div(fd, fc, a, b, digits));
+			if ( rv == 0 ) gmp_printf("%.*Ff\n", digits, fc);
+		} else {
+			usage();
+		}
+
+		mpz_clears(a, b, c, NULL);
+		mpf_clear(fc);
+	}
+
+	sgxgmpd_disconnect(fd);
+
+	return rv;
+}
+
+static int check (const char *op, int rv)
+{
+	if ( rv == SGXGMPD_OK ) return 0;
+
+	if ( rv == SGXGMPD_ERR_ECALL )
+		fprintf(stderr, "%s: %s: 0x%04x\n", op, sgxgmpd_strerror(rv),
+			sgxgmpd_detail());
+	else fprintf(stderr, "%s: %s\n", op, sgxgmpd_strerror(rv));
+
+	return 1;
+}
+
+static uint64_t now_ns ()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
@@ -0,0 +1,279 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <gmp.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sgxgmpclient.h"
+#include "serialize.h"
+#include "sockio.h"
+
+static __thread uint32_t last_detail= 0;
+
+static int request (int fd, uint16_t op, uint64_t param, char *str_a,
+	char *str_b, char **result);
+static int discard (int fd, uint64_t len);
+static int mpz_op (int fd, uint16_t op, mpz_t c, mpz_t a, mpz_t b);
+
+int sgxgmpd_connect (const char *path)
+{
+	struct sockaddr_un addr;
+	size_t len;
+	int fd;
+
+	if ( path == NULL ) path= getenv(SGXGMPD_SOCKET_ENV);
+	if ( path == NULL ) path= SGXGMPD_SOCKET;
+
+	len= strlen(path);
+	if ( len >= sizeof(addr.sun_path) ) {
+		errno= ENAMETOOLONG;
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family= AF_UNIX;
+	memcpy(addr.sun_path, path, len+1);
+
+	fd= socket(AF_UNIX, SOCK_STREAM, 0);
+	if ( fd == -1 ) return -1;
+
+	if ( connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 ) {
+		int err= errno;
+
+		close(fd);
+		errno= err;
+		return -1;
+	}
+
+	return fd;
+}
+
+void sgxgmpd_disconnect (int fd)
+{
+	close(fd);
+}
+
+int sgxgmpd_nop (int fd)
+{
+	return request(fd, SGXGMPD_NOP, 0, NULL, NULL, NULL);
+}
+
+int sgxgmpd_mpz_add (int fd, mpz_t c, mpz_t a, mpz_t b)
+{
+	return mpz_op(fd, SGXGMPD_MPZ_ADD, c, a, b);
+}
+
+int sgxgmpd_mpz_mul (int fd, mpz_t c, mpz_t a, mpz_t b)
+{
+	return mpz_op(fd, SGXGMPD_MPZ_MUL, c, a, b);
+}
+
+int sgxgmpd_mpz_div (int fd, mpz_t c, mpz_t a, mpz_t b)
+{
+	return mpz_op(fd, SGXGMPD_MPZ_DIV, c, a, b);
+}
+
+int sgxgmpd_mpf_div (int fd, mpf_t c, mpz_t a, mpz_t b, int digits)
+{
+	char *str_a, *str_b, *str_c= NULL;
+	int rv= SGXGMPD_ERR_NOMEM;
+
+	str_a= mpz_serialize(a);
+	str_b= mpz_serialize(b);
+
+	if ( str_a != NULL && str_b != NULL ) {
+		rv= request(fd, SGXGMPD_MPF_DIV, digits, str_a, str_b, &str_c);
+		if ( rv == SGXGMPD_OK &&
+			mpf_deserialize((mpf_t *) c, str_c, digits) == -1 )
+		{
+			rv= SGXGMPD_ERR_FAILED;
+		}
+	}
+
+	str_free(str_a);
+	str_free(str_b);
+	free(str_c);
+
+	return rv;
+}
+
+int sgxgmpd_pi (int fd, mpf_t pi, uint64_t digits)
+{
+	char *str= NULL;
+	int rv;
+
+	rv= request(fd, SGXGMPD_PI, digits, NULL, NULL, &str);
+	if ( rv == SGXGMPD_OK &&
+		mpf_deserialize((mpf_t *) pi, str, digits) == -1 )
+	{
+		rv= SGXGMPD_ERR_FAILED;
+	}
+
+	free(str);
+
+	return rv;
+}
+
+uint32_t sgxgmpd_detail ()
+{
+	return last_detail;
+}
+
+const char *sgxgmpd_strerror (int status)
+{
+	switch (status) {
+	case SGXGMPD_OK:
+		return "success";
+	case SGXGMPD_ERR_PROTO:
+		return "malformed request";
+	case SGXGMPD_ERR_TOOBIG:
+		return "operand too large";
+	case SGXGMPD_ERR_NOMEM:
+		return "out of memory";
+	case SGXGMPD_ERR_FAILED:
+		return "operation failed";
+	case SGXGMPD_ERR_ECALL:
+		return "ECALL failed";
+	case SGXGMPD_ERR_IO:
+		return "connection to sgxgmpd lost";
+	case SGXGMPD_ERR_STOPPING:
+		return "sgxgmpd is shutting down";
+	}
+
+	return "unknown error";
+}
+
+static int mpz_op (int fd, uint16_t op, mpz_t c, mpz_t a, mpz_t b)
+{
+	char *str_a, *str_b, *str_c= NULL;
+	int rv= SGXGMPD_ERR_NOMEM;
+
+	str_a= mpz_serialize(a);
+	str_b= mpz_serialize(b);
+
+	if ( str_a != NULL && str_b != NULL ) {
+		rv= request(fd, op, 0, str_a, str_b, &str_c);
+		if ( rv == SGXGMPD_OK &&
+			mpz_deserialize((mpz_t *) c, str_c) == -1 )
+		{
+			rv= SGXGMPD_ERR_FAILED;
+		}
+	}
+
+	str_free(str_a);
+	str_free(str_b);
+	free(str_c);
+
+	return rv;
+}
+
+/*
+ * One round trip: the header and operands go out in a single
+ * sendmsg, and the result comes back NULL-terminated in a malloc'd
+ * buffer.
+ */
+
+static int request (int fd, uint16_t op, uint64_t param, char *str_a,
+	char *str_b, char **result)
+{
+	struct sgxgmpd_request req;
+	struct sgxgmpd_reply rep;
+	struct iovec iov[3];
+	char *buf;
+
+	memset(&req, 0, sizeof(req));
+	req.magic= SGXGMPD_MAGIC;
+	req.version= SGXGMPD_VERSION;
+	req.op= op;
+	req.param= param;
+	req.len_a= ( str_a == NULL ) ? 0 : strlen(str_a);
+	req.len_b= ( str_b == NULL ) ? 0 : strlen(str_b);
+
+	iov[0].iov_base= &req;
+	iov[0].iov_len= sizeof(req);
+	iov[1].iov_base= str_a;
+	iov[1].iov_len= req.len_a;
+	iov[2].iov_base= str_b;
+	iov[2].iov_len= req.len_b;
+
+	if ( ! sock_sendv(fd, iov, 3) ) return SGXGMPD_ERR_IO;
+
+	if ( sock_recv(fd, &rep, sizeof(rep)) != sizeof(rep) )
+		return SGXGMPD_ERR_IO;
+	if ( rep.magic != SGXGMPD_MAGIC ) return SGXGMPD_ERR_IO;
+
+	if ( rep.status != SGXGMPD_OK ) {
+		last_detail= rep.detail;
+		if ( ! discard(fd, rep.len) ) return SGXGMPD_ERR_IO;
+		return rep.status;
+	}
+
+	if ( result == NULL ) {
+		if ( ! discard(fd, rep.len) ) return SGXGMPD_ERR_IO;
+		return SGXGMPD_OK;
+	}
+
+	/* Keep the connection in step even if we can't take the result. */
+
+	buf= ( rep.len < SIZE_MAX ) ? malloc(rep.len+1) : NULL;
+	if ( buf == NULL ) {
+		if ( ! discard(fd, rep.len) ) return SGXGMPD_ERR_IO;
+		return SGXGMPD_ERR_NOMEM;
+	}
+
+	if ( sock_recv(fd, buf, rep.len) != (ssize_t) rep.len ) {
+		free(buf);
+		return SGXGMPD_ERR_IO;
+	}
+	buf[rep.len]= '\0';
+
+	*result= buf;
+
+	return SGXGMPD_OK;
+}
+
+static int discard (int fd, uint64_t len)
+{
+	char buf[4096];
+
+	while ( len ) {
+		size_t n= ( len < sizeof(buf) ) ? len : sizeof(buf);
+
+		if ( sock_recv(fd, buf, n) != (ssize_t) n ) return 0;
+		len-= n;
+	}
+
+	return 1;
+}
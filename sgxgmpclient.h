@@ -0,0 +1,71 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __SGXGMPCLIENT_H
+#define __SGXGMPCLIENT_H
+
+#include <gmp.h>
+#include <stdint.h>
+#include "sgxgmpd.h"
+
+/*
+ * A client for sgxgmpd. Connect once and then make as many calls as
+ * needed; each call is one request to the daemon. The calls return
+ * SGXGMPD_OK or one of the SGXGMPD_ERR_ codes from sgxgmpd.h, and
+ * after SGXGMPD_ERR_IO the connection should be closed. A connection
+ * must not be shared between threads without locking.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Path NULL means $SGXGMPD_SOCKET, or SGXGMPD_SOCKET. -1 on error. */
+int sgxgmpd_connect (const char *path);
+void sgxgmpd_disconnect (int fd);
+
+int sgxgmpd_nop (int fd);
+int sgxgmpd_mpz_add (int fd, mpz_t c, mpz_t a, mpz_t b);
+int sgxgmpd_mpz_mul (int fd, mpz_t c, mpz_t a, mpz_t b);
+int sgxgmpd_mpz_div (int fd, mpz_t c, mpz_t a, mpz_t b);
+int sgxgmpd_mpf_div (int fd, mpf_t c, mpz_t a, mpz_t b, int digits);
+int sgxgmpd_pi (int fd, mpf_t pi, uint64_t digits);
+
+/* The status of the last failed ECALL, for SGXGMPD_ERR_ECALL */
+uint32_t sgxgmpd_detail ();
+
+const char *sgxgmpd_strerror (int status);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,724 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sgx_urts.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "EnclaveGmpTest_u.h"
+#include "backend.h"
+#include "ecall_stats.h"
+#include "pool.h"
+#include "serialize.h"
+#include "sgxgmpd.h"
+#include "sockio.h"
+
+#define DEFAULT_INSTANCES	1
+#define DEFAULT_MAX_BYTES	(64UL*1024*1024)
+#define DEFAULT_MAX_DIGITS	10000000UL
+#define DEFAULT_LARGE_COST	65536UL
+#define DEFAULT_CHUNK_TERMS	100UL
+
+static const char *op_names[SGXGMPD_NOPS]= {
+	"nop", "add", "mul", "div", "fdiv", "pi"
+};
+
+static struct enclave_pool pool;
+
+static unsigned long max_bytes= DEFAULT_MAX_BYTES;
+static unsigned long max_digits= DEFAULT_MAX_DIGITS;
+static unsigned long large_cost= DEFAULT_LARGE_COST;
+static unsigned long chunk_terms= DEFAULT_CHUNK_TERMS;
+static unsigned long cache_bytes= 0;
+static int affinity= 0;
+static int verbose= 0;
+static volatile sig_atomic_t stop= 0;
+
+void usage ();
+
+static int listen_socket (const char *path);
+static void on_signal (int sig);
+static void *serve (void *arg);
+static int handle (int fd, struct sgxgmpd_request *req, int *pin);
+static int run (struct sgxgmpd_request *req, char *str_a, char *str_b,
+	char **result, struct sgxgmpd_reply *rep, int *pin);
+static int run_shared (struct backend *be, struct sgxgmpd_request *req,
+	char *str_a, char *str_b, char **result, struct sgxgmpd_reply *rep);
+static sgx_status_t chunked_pi (struct pool_member *m, uint64_t digits,
+	size_t *len);
+static uint64_t request_cost (struct sgxgmpd_request *req);
+static uint64_t now_ns ();
+
+void usage () {
+	fprintf(stderr, "usage: sgxgmpd [-av] [-b backend] [-n enclaves] [-s socket]\n");
+	fprintf(stderr, "          [-m max_bytes] [-p max_digits] [-L large_cost]\n");
+	fprintf(stderr, "          [-r reserved] [-C chunk_terms] [-M cache_bytes]\n");
+	fprintf(stderr, "  -a  keep each connection on one enclave\n");
+	fprintf(stderr, "  -b  sgx or native (default: $%s, or sgx)\n",
+		BACKEND_ENV);
+	fprintf(stderr, "  -n  enclaves to keep loaded (default: %d)\n",
+		DEFAULT_INSTANCES);
+	fprintf(stderr, "  -s  socket path (default: $%s, or %s)\n",
+		SGXGMPD_SOCKET_ENV, SGXGMPD_SOCKET);
+	fprintf(stderr, "  -m  largest operand accepted, in bytes (default: %lu)\n",
+		DEFAULT_MAX_BYTES);
+	fprintf(stderr, "  -p  most digits accepted for fdiv and pi (default: %lu)\n",
+		DEFAULT_MAX_DIGITS);
+	fprintf(stderr, "  -L  cost from which a request is large (default: %lu)\n",
+		DEFAULT_LARGE_COST);
+	fprintf(stderr, "  -r  enclaves kept for small requests (default: 0)\n");
+	fprintf(stderr, "  -C  pi terms per ECALL for large pi (default: %lu)\n",
+		DEFAULT_CHUNK_TERMS);
+	fprintf(stderr, "  -M  cache repeated results in each enclave, up to this "
+		"many bytes\n");
+	fprintf(stderr, "  -v  log each request to stderr\n");
+	exit(1);
+}
+
+int main (int argc, char *argv[])
+{
+	const char *backend= NULL;
+	const char *path= NULL;
+	struct sigaction sa;
+	sigset_t block, old;
+	int npool= DEFAULT_INSTANCES;
+	int nreserve= 0;
+	int opt, lfd, i;
+
+	while ( (opt= getopt(argc, argv, "C:L:M:ab:hm:n:p:r:s:v")) != -1 ) {
+		switch (opt) {
+		case 'C':
+			chunk_terms= strtoul(optarg, NULL, 10);
+			if ( chunk_terms == 0 ) usage();
+			break;
+		case 'L':
+			large_cost= strtoul(optarg, NULL, 10);
+			if ( large_cost == 0 ) usage();
+			break;
+		case 'M':
+			cache_bytes= strtoul(optarg, NULL, 10);
+			if ( cache_bytes == 0 ) usage();
+			break;
+		case 'a':
+			affinity= 1;
+			break;
+		case 'b':
+			backend= optarg;
+			break;
+		case 'm':
+			max_bytes= strtoul(optarg, NULL, 10);
+			if ( max_bytes == 0 ) usage();
+			break;
+		case 'n':
+			npool= atoi(optarg);
+			if ( npool < 1 ) usage();
+			break;
+		case 'p':
+			max_digits= strtoul(optarg, NULL, 10);
+			if ( max_digits == 0 ) usage();
+			break;
+		case 'r':
+			nreserve= atoi(optarg);
+			if ( nreserve < 0 ) usage();
+			break;
+		case 's':
+			path= optarg;
+			break;
+		case 'v':
+			verbose= 1;
+			break;
+		case 'h':
+		default:
+			usage();
+		}
+	}
+
+	argc-= optind;
+	argv+= optind;
+
+	if ( argc != 0 ) usage();
+
+	if ( path == NULL ) path= getenv(SGXGMPD_SOCKET_ENV);
+	if ( path == NULL ) path= SGXGMPD_SOCKET;
+
+	/*
+	 * Pay for detection, enclave creation and tgmp_init once, up
+	 * front.
+	 */
+
+	if ( ! pool_open(&pool, npool, backend) ) return 1;
+
+	for (i= 0; cache_bytes && i< pool.n; ++i) {
+		struct backend *be= &pool.members[i].be;
+		uint64_t old;
+
+		if ( be->e_memo_config(be->eid, &old, cache_bytes) !=
+			SGX_SUCCESS )
+		{
+			fprintf(stderr, "sgxgmpd: could not enable the cache\n");
+			return 1;
+		}
+	}
+
+	/*
+	 * One enclave is always left for large requests, so with only one
+	 * there is nothing to reserve. Small requests still run beside a
+	 * large one in the same enclave, but they queue behind its fdiv
+	 * and pi.
+	 */
+
+	if ( pool_reserve(&pool, nreserve) != nreserve ) {
+		if ( pool.n == 1 ) {
+			fprintf(stderr, "sgxgmpd: -r needs more than one enclave "
+				"(-n), so none are reserved\n");
+		} else {
+			fprintf(stderr, "sgxgmpd: only %d enclave%s can be "
+				"reserved\n", pool.n-1, ( pool.n == 2 ) ? "" : "s");
+		}
+	}
+
+	lfd= listen_socket(path);
+	if ( lfd == -1 ) return 1;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler= on_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);	/* No SA_RESTART: interrupt accept */
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	/* Only this thread takes the signals, so that accept sees them. */
+
+	sigemptyset(&block);
+	sigaddset(&block, SIGINT);
+	sigaddset(&block, SIGTERM);
+
+	fprintf(stderr, "sgxgmpd: %d %s instance%s on %s\n", pool.n,
+		pool.members[0].be.name, ( pool.n == 1 ) ? "" : "s", path);
+
+	while ( ! stop ) {
+		pthread_t tid;
+		int fd;
+
+		fd= accept(lfd, NULL, NULL);
+		if ( fd == -1 ) {
+			if ( errno == EINTR || errno == ECONNABORTED ) continue;
+			perror("accept");
+			break;
+		}
+
+		pthread_sigmask(SIG_BLOCK, &block, &old);
+		if ( pthread_create(&tid, NULL, serve, (void *) (intptr_t) fd) ) {
+			fprintf(stderr, "sgxgmpd: could not start a thread\n");
+			close(fd);
+		} else {
+			pthread_detach(tid);
+		}
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+	}
+
+	close(lfd);
+	unlink(path);
+
+	if ( verbose ) {
+		for (i= 0; i< pool.n; ++i) {
+			struct backend *be= &pool.members[i].be;
+			struct memo_stats ms;
+			unsigned long served;
+			size_t need;
+
+			/* Requests can still be finishing. */
+
+			pthread_mutex_lock(&pool.lock);
+			served= pool.members[i].served;
+			pthread_mutex_unlock(&pool.lock);
+
+			fprintf(stderr, "sgxgmpd: enclave %d served %lu requests\n",
+				i, served);
+
+			if ( cache_bytes && be->e_memo_stats(be->eid, &need,
+				(unsigned char *) &ms, sizeof(ms), 0) == SGX_SUCCESS &&
+				need == sizeof(ms) )
+			{
+				memo_stats_print(&ms);
+			}
+		}
+	}
+
+	/* Requests in progress finish before the enclaves go away. */
+
+	pool_close(&pool);
+
+	fprintf(stderr, "sgxgmpd: exiting\n");
+
+	return 0;
+}
+
+/*
+ * Only the owner may connect. If the path is taken, it is either a
+ * running daemon, or a socket left behind by one that died, which is
+ * safe to replace.
+ */
+
+static int listen_socket (const char *path)
+{
+	struct sockaddr_un addr;
+	size_t len= strlen(path);
+	mode_t mask;
+	int fd, rv;
+
+	if ( len >= sizeof(addr.sun_path) ) {
+		fprintf(stderr, "%s: socket path too long\n", path);
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family= AF_UNIX;
+	memcpy(addr.sun_path, path, len+1);
+
+	fd= socket(AF_UNIX, SOCK_STREAM, 0);
+	if ( fd == -1 ) {
+		perror("socket");
+		return -1;
+	}
+
+	mask= umask(077);
+	rv= bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+	if ( rv == -1 && errno == EADDRINUSE ) {
+		int probe= socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if ( probe != -1 &&
+			connect(probe, (struct sockaddr *) &addr, sizeof(addr)) == -1 &&
+			errno == ECONNREFUSED )
+		{
+			unlink(path);
+			rv= bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+		} else {
+			errno= EADDRINUSE;
+		}
+		if ( probe != -1 ) close(probe);
+	}
+	umask(mask);
+
+	if ( rv == -1 ) {
+		if ( errno == EADDRINUSE )
+			fprintf(stderr, "%s: sgxgmpd is already running\n", path);
+		else perror(path);
+		close(fd);
+		return -1;
+	}
+
+	if ( listen(fd, SOMAXCONN) == -1 ) {
+		perror("listen");
+		close(fd);
+		unlink(path);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void on_signal (int sig)
+{
+	stop= 1;
+}
+
+/*
+ * One thread per connection, serving its requests in order. With -a,
+ * the connection stays on the enclave that served its first request.
+ */
+
+static void *serve (void *arg)
+{
+	int fd= (int) (intptr_t) arg;
+	struct sgxgmpd_request req;
+	int pin= POOL_ANY;
+
+	while ( sock_recv(fd, &req, sizeof(req)) == sizeof(req) ) {
+		if ( ! handle(fd, &req, &pin) ) break;
+	}
+
+	close(fd);
+
+	return NULL;
+}
+
+/*
+ * Read the operands, run the request and send the reply. Returns 0 if
+ * the connection can't be used any more, either because it failed or
+ * because the request was bad enough that we can't find the next one.
+ */
+
+static int handle (int fd, struct sgxgmpd_request *req, int *pin)
+{
+	struct sgxgmpd_reply rep;
+	struct iovec iov[2];
+	char *str_a= NULL, *str_b= NULL, *str_c= NULL;
+	uint64_t start= now_ns();
+	int keep= 1;
+
+	memset(&rep, 0, sizeof(rep));
+	rep.magic= SGXGMPD_MAGIC;
+
+	if ( req->magic != SGXGMPD_MAGIC || req->version != SGXGMPD_VERSION ||
+		req->op >= SGXGMPD_NOPS )
+	{
+		rep.status= SGXGMPD_ERR_PROTO;
+		keep= 0;
+		goto reply;
+	}
+
+	/* Operands we won't read leave the stream out of step. */
+
+	if ( req->len_a > max_bytes || req->len_b > max_bytes ) {
+		rep.status= SGXGMPD_ERR_TOOBIG;
+		keep= 0;
+		goto reply;
+	}
+
+	str_a= malloc(req->len_a+1);
+	str_b= malloc(req->len_b+1);
+	if ( str_a == NULL || str_b == NULL ) {
+		rep.status= SGXGMPD_ERR_NOMEM;
+		keep= 0;
+		goto reply;
+	}
+
+	if ( sock_recv(fd, str_a, req->len_a) != (ssize_t) req->len_a ||
+		sock_recv(fd, str_b, req->len_b) != (ssize_t) req->len_b )
+	{
+		keep= 0;
+		goto done;
+	}
+	str_a[req->len_a]= '\0';
+	str_b[req->len_b]= '\0';
+
+	if ( req->op == SGXGMPD_MPF_DIV || req->op == SGXGMPD_PI ) {
+		if ( req->param == 0 ) {
+			rep.status= SGXGMPD_ERR_PROTO;
+			goto reply;
+		}
+		if ( req->param > max_digits ||
+			( req->op == SGXGMPD_MPF_DIV && req->param > INT_MAX ) )
+		{
+			rep.status= SGXGMPD_ERR_TOOBIG;
+			goto reply;
+		}
+	}
+
+	rep.status= run(req, str_a, str_b, &str_c, &rep, pin);
+
+reply:
+	iov[0].iov_base= &rep;
+	iov[0].iov_len= sizeof(rep);
+	iov[1].iov_base= str_c;
+	iov[1].iov_len= ( str_c == NULL ) ? 0 : rep.len;
+
+	if ( ! sock_sendv(fd, iov, 2) ) keep= 0;
+
+	if ( verbose ) {
+		fprintf(stderr, "fd %d: %s %llu+%llu bytes -> status %u, "
+			"%llu bytes, %llu us\n", fd,
+			( req->op < SGXGMPD_NOPS ) ? op_names[req->op] : "?",
+			(unsigned long long) req->len_a,
+			(unsigned long long) req->len_b, rep.status,
+			(unsigned long long) rep.len,
+			(unsigned long long) (now_ns()-start)/1000);
+	}
+
+done:
+	free(str_a);
+	free(str_b);
+	free(str_c);
+
+	return keep;
+}
+
+/*
+ * The operation and e_get_result have to run on the same enclave.
+ *
+ * Requests whose cost reaches large_cost go in the large lane, so they
+ * wait behind small ones and stay off reserved enclaves. Of those, only
+ * pi can be broken up; a large mul or div holds its enclave until it
+ * is done. Small integer requests don't wait for it, though: they run
+ * beside it on the enclave's other threads (run_shared).
+ */
+
+static int run (struct sgxgmpd_request *req, char *str_a, char *str_b,
+	char **result, struct sgxgmpd_reply *rep, int *pin)
+{
+	struct pool_member *m;
+	struct backend *be;
+	sgx_status_t status= SGX_SUCCESS;
+	uint64_t cost= request_cost(req);
+	size_t len= 0;
+	int rv= 0, ret= SGXGMPD_OK;
+	int lane= ( cost >= large_cost ) ? POOL_LARGE : POOL_SMALL;
+	int shared= 0;
+
+	if ( lane == POOL_SMALL && req->op < SGXGMPD_MPF_DIV )
+		m= pool_share(&pool, *pin, cost, &shared);
+	else
+		m= pool_get(&pool, *pin, lane, cost);
+	if ( m == NULL ) return SGXGMPD_ERR_STOPPING;
+	if ( affinity ) *pin= m-pool.members;
+	be= &m->be;
+
+	if ( shared ) {
+		ret= run_shared(be, req, str_a, str_b, result, rep);
+		pool_unshare(&pool, m, cost);
+		return ret;
+	}
+
+	switch (req->op) {
+	case SGXGMPD_NOP:
+		status= be->e_nop(be->eid);
+		break;
+	case SGXGMPD_MPZ_ADD:
+		status= be->e_mpz_add(be->eid, &len, str_a, str_b);
+		break;
+	case SGXGMPD_MPZ_MUL:
+		status= be->e_mpz_mul(be->eid, &len, str_a, str_b);
+		break;
+	case SGXGMPD_MPZ_DIV:
+		status= be->e_mpz_div(be->eid, &len, str_a, str_b);
+		break;
+	case SGXGMPD_MPF_DIV:
+		status= be->e_mpf_div(be->eid, &len, str_a, str_b,
+			(int) req->param);
+		break;
+	case SGXGMPD_PI:
+		if ( lane == POOL_LARGE )
+			status= chunked_pi(m, req->param, &len);
+		else
+			status= be->e_pi(be->eid, &len, req->param);
+		break;
+	}
+
+	if ( status != SGX_SUCCESS ) {
+		rep->detail= status;
+		ret= SGXGMPD_ERR_ECALL;
+		goto done;
+	}
+	if ( req->op == SGXGMPD_NOP ) goto done;
+	if ( len == 0 ) {
+		ret= SGXGMPD_ERR_FAILED;
+		goto done;
+	}
+
+	/*
+	 * If we can't take the result it stays in the enclave until the
+	 * next operation replaces it.
+	 */
+
+	*result= malloc(len+1);
+	if ( *result == NULL ) {
+		ret= SGXGMPD_ERR_NOMEM;
+		goto done;
+	}
+
+	status= be->e_get_result(be->eid, &rv, *result, len);
+	if ( status != SGX_SUCCESS ) {
+		rep->detail= status;
+		ret= SGXGMPD_ERR_ECALL;
+	} else if ( rv == 0 ) {
+		ret= SGXGMPD_ERR_FAILED;
+	} else {
+		rep->len= len;
+	}
+
+done:
+	pool_put(&pool, m, cost);
+
+	if ( ret != SGXGMPD_OK ) {
+		free(*result);
+		*result= NULL;
+	}
+
+	return ret;
+}
+
+/*
+ * A nop, add, mul or div on an enclave that another call holds. The
+ * other call's result is waiting in the enclave for its e_get_result,
+ * so this goes through e_mpz_ops, which leaves that alone and writes
+ * its result to our buffer. It costs converting the operands to a
+ * batch and back on the host, which for a small request is far less
+ * than waiting, and it bypasses the cache (-M), which only requests
+ * that get an enclave to themselves go through.
+ */
+
+static int run_shared (struct backend *be, struct sgxgmpd_request *req,
+	char *str_a, char *str_b, char **result, struct sgxgmpd_reply *rep)
+{
+	void (*gmp_free)(void *, size_t);
+	sgx_status_t status;
+	mpz_t vals[2];
+	unsigned char op, *in= NULL, *out= NULL;
+	char *str_c;
+	size_t len= 0, olen= 0;
+	int ret= SGXGMPD_ERR_FAILED;
+
+	if ( req->op == SGXGMPD_NOP ) {
+		status= be->e_nop(be->eid);
+		if ( status == SGX_SUCCESS ) return SGXGMPD_OK;
+		rep->detail= status;
+		return SGXGMPD_ERR_ECALL;
+	}
+
+	switch (req->op) {
+	case SGXGMPD_MPZ_ADD:
+		op= MPZ_OP_ADD;
+		break;
+	case SGXGMPD_MPZ_MUL:
+		op= MPZ_OP_MUL;
+		break;
+	default:
+		op= MPZ_OP_DIV;
+	}
+
+	mp_get_memory_functions(NULL, NULL, &gmp_free);
+	mpz_inits(vals[0], vals[1], NULL);
+
+	if ( mpz_deserialize(&vals[0], str_a) == -1 ||
+		mpz_deserialize(&vals[1], str_b) == -1 )
+	{
+		goto done;
+	}
+
+	/* The result fits in its operands' batch, which has a record spare. */
+
+	in= mpz_batch_serialize(vals, 2, &len);
+	if ( in != NULL ) out= malloc(len);
+	if ( out == NULL ) {
+		ret= SGXGMPD_ERR_NOMEM;
+		goto done;
+	}
+
+	status= be->e_mpz_ops(be->eid, &olen, &op, 1, in, len, out, len);
+	if ( status != SGX_SUCCESS ) {
+		rep->detail= status;
+		ret= SGXGMPD_ERR_ECALL;
+		goto done;
+	}
+	if ( olen == 0 || mpz_batch_deserialize(vals, 1, out, olen) == -1 )
+		goto done;
+
+	str_c= mpz_serialize(vals[0]);
+	if ( str_c == NULL ) {
+		ret= SGXGMPD_ERR_NOMEM;
+		goto done;
+	}
+
+	rep->len= strlen(str_c);
+	*result= malloc(rep->len+1);
+	if ( *result == NULL ) {
+		rep->len= 0;
+		ret= SGXGMPD_ERR_NOMEM;
+	} else {
+		memcpy(*result, str_c, rep->len+1);
+		ret= SGXGMPD_OK;
+	}
+	str_free(str_c);
+
+done:
+	mpz_clears(vals[0], vals[1], NULL);
+	if ( in != NULL ) gmp_free(in, len);
+	free(out);
+
+	return ret;
+}
+
+/*
+ * Pi a chunk of terms at a time, letting any small requests that are
+ * waiting for the enclave run between chunks. The result is left for
+ * e_get_result as e_pi would leave it.
+ */
+
+static sgx_status_t chunked_pi (struct pool_member *m, uint64_t digits,
+	size_t *len)
+{
+	struct backend *be= &m->be;
+	sgx_status_t status;
+	int ok= 0, more= 0;
+
+	*len= 0;
+
+	status= be->e_pi_begin(be->eid, &ok, digits);
+	if ( status != SGX_SUCCESS || ! ok ) return status;
+
+	do {
+		status= be->e_pi_step(be->eid, &more, chunk_terms);
+		if ( status != SGX_SUCCESS ) break;
+
+		if ( more == 1 && pool_yield_wanted(&pool, m) )
+			pool_yield(&pool, m);
+	} while ( more == 1 );
+
+	/* This abandons the sum if it isn't finished. */
+
+	if ( status != SGX_SUCCESS ) {
+		be->e_pi_end(be->eid, len);
+		*len= 0;
+		return status;
+	}
+
+	return be->e_pi_end(be->eid, len);
+}
+
+/*
+ * A rough cost, for balancing the pool: the operand bytes plus the
+ * digits asked for. It only has to rank requests against each other.
+ */
+
+static uint64_t request_cost (struct sgxgmpd_request *req)
+{
+	return 1+req->len_a+req->len_b+req->param;
+}
+
+static uint64_t now_ns ()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
@@ -0,0 +1,94 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __SGXGMPD_H
+#define __SGXGMPD_H
+
+#include <stdint.h>
+
+/*
+ * The sgxgmpd wire protocol. A client connects to the daemon's Unix
+ * socket and sends requests one at a time, each a fixed header and
+ * then the operands, and reads back a fixed reply header and the
+ * result. A connection can be reused for any number of requests.
+ *
+ * Operands and results are the strings from serialize.h, without the
+ * terminating NULL, so they are exactly what the ECALLs take and
+ * return. The header fields are in host byte order, since both ends
+ * are on the same machine.
+ */
+
+#define SGXGMPD_MAGIC		0x504d4753	/* "SGMP" */
+#define SGXGMPD_VERSION		1
+
+#define SGXGMPD_SOCKET_ENV	"SGXGMPD_SOCKET"
+#define SGXGMPD_SOCKET		"/tmp/sgxgmpd.sock"
+
+/* Operations */
+
+#define SGXGMPD_NOP		0	/* A round trip to the enclave */
+#define SGXGMPD_MPZ_ADD		1	/* a+b */
+#define SGXGMPD_MPZ_MUL		2	/* a*b */
+#define SGXGMPD_MPZ_DIV		3	/* a/b, rounded down */
+#define SGXGMPD_MPF_DIV		4	/* a/b to param digits */
+#define SGXGMPD_PI		5	/* pi to param digits, no operands */
+#define SGXGMPD_NOPS		6
+
+/* Reply status */
+
+#define SGXGMPD_OK		0
+#define SGXGMPD_ERR_PROTO	1	/* Malformed request */
+#define SGXGMPD_ERR_TOOBIG	2	/* Operand or digits over the limit */
+#define SGXGMPD_ERR_NOMEM	3	/* Daemon is out of memory */
+#define SGXGMPD_ERR_FAILED	4	/* The operation gave no result */
+#define SGXGMPD_ERR_ECALL	5	/* ECALL failed, detail is the status */
+#define SGXGMPD_ERR_IO		6	/* Client side: connection lost */
+#define SGXGMPD_ERR_STOPPING	7	/* Daemon is shutting down */
+
+struct sgxgmpd_request {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t op;
+	uint64_t param;		/* Digits, for SGXGMPD_MPF_DIV and SGXGMPD_PI */
+	uint64_t len_a;		/* Bytes of operand a that follow */
+	uint64_t len_b;		/* Bytes of operand b, after a */
+};
+
+struct sgxgmpd_reply {
+	uint32_t magic;
+	uint16_t status;
+	uint16_t reserved;
+	uint32_t detail;	/* The sgx_status_t, for SGXGMPD_ERR_ECALL */
+	uint32_t reserved2;
+	uint64_t len;		/* Bytes of result that follow */
+};
+
+#endif
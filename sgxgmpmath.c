@@ -32,70 +32,60 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <sgx_urts.h>
+#include <ctype.h>
 #include <gmp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include "EnclaveGmpTest_u.h"
-#include "create_enclave.h"
-#include "sgx_detect.h"
+#include "backend.h"
+#include "mathstream.h"
 #include "serialize.h"
+#include "workers.h"
 
-#define ENCLAVE_NAME "EnclaveGmpTest.signed.so"
+void usage ();
+int stream (int argc, char *argv[]);
+
+void usage ()
+{
+	fprintf(stderr, "usage: sgxgmpmath num1 num2\n");
+	fprintf(stderr, "       sgxgmpmath -f input [-o output] [-t threads] "
+		"[-n batch] [-p]\n");
+	fprintf(stderr, "  -f  run the operations in input (see mathstream.h)\n");
+	fprintf(stderr, "  -o  write the results to output (default: stdout)\n");
+	fprintf(stderr, "  -t  worker threads (default: one per CPU, up to %d)\n",
+		ENCLAVE_MAX_THREADS);
+	fprintf(stderr, "  -n  operations per ECALL (default: %d)\n",
+		MATHSTREAM_BATCH);
+	fprintf(stderr, "  -p  pipeline: parse and format on their own threads, "
+		"and keep\n      one thread making ECALLs\n");
+	exit(1);
+}
 
 int main (int argc, char *argv[])
 {
-	sgx_launch_token_t token= { 0 };
-	sgx_enclave_id_t eid= 0;
+	struct backend be;
 	sgx_status_t status;
-	int updated= 0;
 	int rv= 0;
-	unsigned long support;
 	mpz_t a, b, c;
 	mpf_t fc;
 	char *str_a, *str_b, *str_c, *str_fc;
 	size_t len;
 	int digits= 12; /* For demo purposes */
 
-	if ( argc != 3 ) {
-		fprintf(stderr, "usage: sgxgmptest num1 num2\n");
-		return 1;
-	}
+	/* Anything that starts with a dash but isn't a number is an option. */
+
+	if ( argc > 1 && argv[1][0] == '-' && ! isdigit(argv[1][1]) )
+		return stream(argc, argv);
+
+	if ( argc != 3 ) usage();
 
 	mpz_init_set_str(a, argv[1], 10);	/* Assume base 10 */
 	mpz_init_set_str(b, argv[2], 10);	/* Assume base 10 */
 	mpz_init(c);
 	mpf_init(fc);
 
-#ifndef SGX_HW_SIM
-	support= get_sgx_support();
-	if ( ! SGX_OK(support) ) {
-		sgx_support_perror(support);
-		return 1;
-	}
-#endif
-
-	status= sgx_create_enclave_search(ENCLAVE_NAME, SGX_DEBUG_FLAG,
-		 &token, &updated, &eid, 0);
-	if ( status != SGX_SUCCESS ) {
-		if ( status == SGX_ERROR_ENCLAVE_FILE_ACCESS ) {
-			fprintf(stderr, "sgx_create_enclave: %s: file not found\n",
-				ENCLAVE_NAME);
-			fprintf(stderr, "Did you forget to set LD_LIBRARY_PATH?\n");
-		} else {
-			fprintf(stderr, "%s: 0x%04x\n", ENCLAVE_NAME, status);
-		}
-		return 1;
-	}
-
-	fprintf(stderr, "Enclave launched\n");
-
-	status= tgmp_init(eid);
-	if ( status != SGX_SUCCESS ) {
-		fprintf(stderr, "ECALL test_mpz_add: 0x%04x\n", status);
-		return 1;
-	}
-
-	fprintf(stderr, "libtgmp initialized\n");
+	if ( ! backend_open(&be, NULL) ) return 1;
 
 	/*
 	 * Convert the integers to a compacted string form for marshalling
@@ -126,7 +116,7 @@ int main (int argc, char *argv[])
 
 	/* Add the numbers */
 
-	status= e_mpz_add(eid, &len, str_a, str_b);
+	status= be.e_mpz_add(be.eid, &len, str_a, str_b);
 	if ( status != SGX_SUCCESS ) {
 		fprintf(stderr, "ECALL test_mpz_add_ui: 0x%04x\n", status);
 		return 1;
@@ -137,7 +127,7 @@ int main (int argc, char *argv[])
 	}
 
 	str_c= malloc(len+1);
-	status= e_get_result(eid, &rv, str_c, len);
+	status= be.e_get_result(be.eid, &rv, str_c, len);
 	if ( status != SGX_SUCCESS ) {
 		fprintf(stderr, "ECALL e_mpz_get_result: 0x%04x\n", status);
 		return 1;
@@ -156,7 +146,7 @@ int main (int argc, char *argv[])
 
 	/* Multiply the numbers */
 
-	status= e_mpz_mul(eid, &len, str_a, str_b);
+	status= be.e_mpz_mul(be.eid, &len, str_a, str_b);
 	if ( status != SGX_SUCCESS ) {
 		fprintf(stderr, "ECALL test_mpz_mul: 0x%04x\n", status);
 		return 1;
@@ -168,7 +158,7 @@ int main (int argc, char *argv[])
 
 	str_c= realloc(str_c, len+1);
 
-	status= e_get_result(eid, &rv, str_c, len);
+	status= be.e_get_result(be.eid, &rv, str_c, len);
 	if ( status != SGX_SUCCESS ) {
 		fprintf(stderr, "ECALL e_mpz_get_result: 0x%04x\n", status);
 		return 1;
@@ -187,7 +177,7 @@ int main (int argc, char *argv[])
 
 	/* Integer division */
 
-	status= e_mpz_div(eid, &len, str_a, str_b);
+	status= be.e_mpz_div(be.eid, &len, str_a, str_b);
 	if ( status != SGX_SUCCESS ) {
 		fprintf(stderr, "ECALL test_mpz_div: 0x%04x\n", status);
 		return 1;
@@ -198,7 +188,7 @@ int main (int argc, char *argv[])
 	}
 
 	str_c= realloc(str_c, len+1);
-	status= e_get_result(eid, &rv, str_c, len);
+	status= be.e_get_result(be.eid, &rv, str_c, len);
 	if ( status != SGX_SUCCESS ) {
 		fprintf(stderr, "ECALL e_mpz_get_result: 0x%04x\n", status);
 		return 1;
@@ -222,7 +212,7 @@ int main (int argc, char *argv[])
 	 * of decimal digits. For this demo, we'll use 12.
 	 */
 
-	status= e_mpf_div(eid, &len, str_a, str_b, digits);
+	status= be.e_mpf_div(be.eid, &len, str_a, str_b, digits);
 	if ( status != SGX_SUCCESS ) {
 		fprintf(stderr, "ECALL test_mpz_div: 0x%04x\n", status);
 		return 1;
@@ -234,7 +224,7 @@ int main (int argc, char *argv[])
 
 	str_fc= malloc(len+1);
 
-	status= e_get_result(eid, &rv, str_fc, len);
+	status= be.e_get_result(be.eid, &rv, str_fc, len);
 	if ( status != SGX_SUCCESS ) {
 		fprintf(stderr, "ECALL e_get_result: 0x%04x\n", status);
 		return 1;
@@ -254,3 +244,43 @@ int main (int argc, char *argv[])
 	return 0;
 }
 
+
+int stream (int argc, char *argv[])
+{
+	struct backend be;
+	const char *input= NULL, *output= NULL;
+	size_t batch= 0;
+	int opt, threads= 0, pipeline= 0;
+
+	while ( (opt= getopt(argc, argv, "f:hn:o:pt:")) != -1 ) {
+		switch (opt) {
+		case 'f':
+			input= optarg;
+			break;
+		case 'n':
+			batch= strtoul(optarg, NULL, 10);
+			if ( batch == 0 ) usage();
+			break;
+		case 'o':
+			output= optarg;
+			break;
+		case 'p':
+			pipeline= 1;
+			break;
+		case 't':
+			threads= atoi(optarg);
+			if ( threads < 1 ) usage();
+			break;
+		case 'h':
+		default:
+			usage();
+		}
+	}
+
+	if ( input == NULL || optind != argc ) usage();
+
+	if ( ! backend_open(&be, NULL) ) return 1;
+
+	return mathstream_run(&be, input, output, threads, batch,
+		pipeline);
+}
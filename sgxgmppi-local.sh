@@ -0,0 +1,56 @@
+#! /bin/sh
+#
+# Computes pi with several sgxgmppi workers on this machine, each with
+# its own enclave, and merges their partial sums. On several machines,
+# run the workers there with the same digits and copy the partials back
+# before merging.
+#
+#   sgxgmppi-local.sh [-k] digits [workers]
+#
+# -k keeps the directory of partials. The default is one worker per CPU.
+
+keep=0
+if [ "$1" = "-k" ]; then
+	keep=1
+	shift
+fi
+
+if [ $# -lt 1 -o $# -gt 2 ]; then
+	echo "usage: $0 [-k] digits [workers]" >&2
+	exit 1
+fi
+
+digits=$1
+workers=${2:-$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)}
+pi=${SGXGMPPI:-$(dirname "$0")/sgxgmppi}
+
+dir=$(mktemp -d "${TMPDIR:-/tmp}/sgxgmppi.XXXXXX") || exit 1
+[ $keep -eq 1 ] || trap 'rm -rf "$dir"' EXIT
+
+pids=
+i=0
+while [ $i -lt $workers ]; do
+	"$pi" -w $i/$workers -o "$dir/part.$i" $digits &
+	pids="$pids $!"
+	i=$((i+1))
+done
+
+failed=0
+for pid in $pids; do
+	wait $pid || failed=1
+done
+if [ $failed -ne 0 ]; then
+	echo "$0: a worker failed" >&2
+	exit 1
+fi
+
+parts=
+i=0
+while [ $i -lt $workers ]; do
+	parts="$parts $dir/part.$i"
+	i=$((i+1))
+done
+
+[ $keep -eq 1 ] && echo "partials are in $dir" >&2
+
+"$pi" -c $digits $parts
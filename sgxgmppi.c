@@ -35,36 +35,68 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <gmp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
-#include "sgx_detect.h"
 #include "EnclaveGmpTest_u.h"
-#include "create_enclave.h"
+#include "backend.h"
+#include "ecall_stats.h"
 #include "serialize.h"
 
-#define ENCLAVE_NAME "EnclaveGmpTest.signed.so"
-
 void usage ();
 
+static char *fetch_result (struct backend *be, size_t len);
+static unsigned char *read_parts (char **files, int n, size_t *len);
+static int write_part (const char *file, const char *buf, size_t len);
+
 void usage () {
-	fprintf(stderr, "usage: sgxgmppi digits\n");
+	fprintf(stderr, "usage: sgxgmppi [-m] digits\n");
+	fprintf(stderr, "       sgxgmppi [-m] [-x bytes] -w part/parts [-o file] "
+		"digits\n");
+	fprintf(stderr, "       sgxgmppi [-m] -c [-o file] digits partial ...\n");
+	fprintf(stderr, "  -m  report enclave heap use to stderr\n");
+	fprintf(stderr, "  -w  compute one of parts shares of the sum, counting "
+		"from 0,\n      and write it to file, or stdout\n");
+	fprintf(stderr, "  -c  merge partials for consecutive shares and print "
+		"pi, or with\n      -o write the merged partial to file\n");
+	fprintf(stderr, "  -x  with -w, spill intermediates of at least this many "
+		"bytes out of\n      the enclave, and report the spills to "
+		"stderr\n");
 	exit(1);
 }
 
 int main (int argc, char *argv[])
 {
-	sgx_launch_token_t token= { 0 };
-	sgx_enclave_id_t eid= 0;
+	struct backend be;
 	sgx_status_t status;
-	int updated= 0;
-	unsigned long support;
 	mpf_t pi;
-	char *pi_str;
-	uint64_t digits;
-	int opt, rv;
-	size_t len;
+	char *pi_str, *output= NULL;
+	unsigned char *parts_buf= NULL;
+	uint64_t digits, part= 0, parts= 0;
+	struct heap_stats before, after;
+	struct spill_stats ss;
+	int opt, heap= 0, merge= 0;
+	size_t len, need, parts_len= 0;
+	unsigned long spill_bytes= 0;
 
-	while ( (opt= getopt(argc, argv, "h")) != -1 ) {
+	while ( (opt= getopt(argc, argv, "chmo:w:x:")) != -1 ) {
 		switch (opt) {
+		case 'c':
+			merge= 1;
+			break;
+		case 'm':
+			heap= 1;
+			break;
+		case 'o':
+			output= optarg;
+			break;
+		case 'w':
+			if ( sscanf(optarg, "%lu/%lu", &part, &parts) != 2 ||
+				part >= parts ) usage();
+			break;
+		case 'x':
+			spill_bytes= strtoul(optarg, NULL, 10);
+			if ( spill_bytes == 0 ) usage();
+			break;
 		case 'h':
 		default:
 			usage();
@@ -74,7 +106,10 @@ int main (int argc, char *argv[])
 	argc-= optind;
 	argv+= optind;
 
-	if ( argc != 1 ) usage();
+	if ( merge && parts ) usage();
+	if ( spill_bytes && ! parts ) usage();
+	if ( output != NULL && ! merge && ! parts ) usage();
+	if ( merge ? argc < 2 : argc != 1 ) usage();
 
 	digits= strtoull(argv[0], NULL, 10);
 	if ( digits == 0 ) {
@@ -82,68 +117,208 @@ int main (int argc, char *argv[])
 		return 1;
 	}
 
-#ifndef SGX_HW_SIM
-	support= get_sgx_support();
-	if ( ! SGX_OK(support) ) {
-		sgx_support_perror(support);
-		return 1;
+	if ( merge ) {
+		parts_buf= read_parts(&argv[1], argc-1, &parts_len);
+		if ( parts_buf == NULL ) return 1;
 	}
-#endif
 
-	status= sgx_create_enclave_search(ENCLAVE_NAME, SGX_DEBUG_FLAG,
-		 &token, &updated, &eid, 0);
-	if ( status != SGX_SUCCESS ) {
-		if ( status == SGX_ERROR_ENCLAVE_FILE_ACCESS ) {
-			fprintf(stderr, "sgx_create_enclave: %s: file not found\n",
-				ENCLAVE_NAME);
-			fprintf(stderr, "Did you forget to set LD_LIBRARY_PATH?\n");
-		} else {
-			fprintf(stderr, "%s: 0x%04x\n", ENCLAVE_NAME, status);
+	if ( ! backend_open(&be, NULL) ) return 1;
+
+	mpf_init(pi);
+
+	/* Reset the peak so that it's the peak for this run. */
+
+	if ( heap && ! heap_snapshot(&be, &before, 1) ) return 1;
+
+	if ( merge ) {
+		status= be.e_pi_merge(be.eid, &len, parts_buf, parts_len, digits,
+			output == NULL);
+		if ( status != SGX_SUCCESS ) {
+			fprintf(stderr, "ECALL e_pi_merge: 0x%04x\n", status);
+			return 1;
 		}
-		return 1;
-	}
+		if ( len == 0 ) {
+			fprintf(stderr, "e_pi_merge: the partials don't fit "
+				"together%s\n", ( output == NULL ) ?
+				", or don't cover the whole sum" : "");
+			return 1;
+		}
+	} else if ( parts ) {
+		uint64_t old;
 
-	fprintf(stderr, "Enclave launched\n");
+		if ( spill_bytes ) {
+			status= be.e_spill_config(be.eid, &old, spill_bytes);
+			if ( status != SGX_SUCCESS ) {
+				fprintf(stderr, "ECALL e_spill_config: 0x%04x\n", status);
+				return 1;
+			}
+		}
 
-	status= tgmp_init(eid);
-	if ( status != SGX_SUCCESS ) {
-		fprintf(stderr, "ECALL test_mpz_add: 0x%04x\n", status);
-		return 1;
+		status= be.e_pi_split(be.eid, &len, digits, part, parts);
+		if ( status != SGX_SUCCESS ) {
+			fprintf(stderr, "ECALL e_pi_split: 0x%04x\n", status);
+			return 1;
+		}
+		if ( len == 0 ) {
+			fprintf(stderr, "e_pi_split: no result\n");
+			return 1;
+		}
+	} else {
+		status= be.e_pi(be.eid, &len, digits);
+		if ( status != SGX_SUCCESS ) {
+			fprintf(stderr, "ECALL e_pi: 0x%04x\n", status);
+			return 1;
+		}
+		if ( len == 0 ) {
+			fprintf(stderr, "e_pi: no result\n");
+			return 1;
+		}
 	}
 
-	fprintf(stderr, "libtgmp initialized\n");
+	pi_str= fetch_result(&be, len);
+	if ( pi_str == NULL ) return 1;
 
-	mpf_init(pi);
+	if ( heap ) {
+		if ( ! heap_snapshot(&be, &after, 0) ) return 1;
+		heap_stats_print(&before, &after);
+	}
 
-	status= e_pi(eid, &len, digits);
-	if ( status != SGX_SUCCESS ) {
-		fprintf(stderr, "ECALL e_pi: 0x%04x\n", status);
-		return 1;
+	if ( spill_bytes ) {
+		status= be.e_spill_stats(be.eid, &need, (unsigned char *) &ss,
+			sizeof(ss), 0);
+		if ( status != SGX_SUCCESS || need != sizeof(ss) ) {
+			fprintf(stderr, "e_spill_stats: failed\n");
+			return 1;
+		}
+		spill_stats_print(&ss);
 	}
-	if ( len == 0 ) {
-		fprintf(stderr, "e_pi: no result\n");
+
+	/* A partial goes out as it is */
+
+	if ( parts || output != NULL )
+		return ( write_part(output, pi_str, len) ) ? 0 : 1;
+
+	if ( mpf_deserialize(&pi, pi_str, digits) == -1 ) {
+		fprintf(stderr, "mpf_deserialize: bad result string");
 		return 1;
 	}
 
-	pi_str= malloc(len+1);
+	gmp_printf("pi : %.*Ff\n", digits, pi);
+
+	return 0;
+}
+
+static char *fetch_result (struct backend *be, size_t len)
+{
+	sgx_status_t status;
+	char *buf;
+	int rv;
+
+	buf= malloc(len+1);
+	if ( buf == NULL ) {
+		perror("malloc");
+		return NULL;
+	}
 
-	status= e_get_result(eid, &rv, pi_str, len);
+	status= be->e_get_result(be->eid, &rv, buf, len);
 	if ( status != SGX_SUCCESS ) {
 		fprintf(stderr, "ECALL e_get_result: 0x%04x\n", status);
-		return 1;
+		return NULL;
 	}
 	if ( rv == 0 ) {
 		fprintf(stderr, "e_get_result: bad parameters");
-		return 1;
+		return NULL;
 	}
 
-	if ( mpf_deserialize(&pi, pi_str, digits) == -1 ) {
-		fprintf(stderr, "mpf_deserialize: bad result string");
-		return 1;
+	buf[len]= 0;
+
+	return buf;
+}
+
+/*
+ * Reads partials from files, in order, and joins them into one batch for
+ * e_pi_merge(): a count covering all of them, then each file's records.
+ */
+
+static unsigned char *read_parts (char **files, int n, size_t *len)
+{
+	unsigned char *buf, *nbuf;
+	size_t size, count= 0;
+	int i;
+
+	size= BATCH_HDR_LEN;
+	buf= malloc(size);
+	if ( buf == NULL ) {
+		perror("malloc");
+		return NULL;
 	}
 
-	gmp_printf("pi : %.*Ff\n", digits, pi);
+	for (i= 0; i< n; ++i) {
+		FILE *fp;
+		long flen;
 
-	return 0;
+		fp= fopen(files[i], "rb");
+		if ( fp == NULL ) {
+			perror(files[i]);
+			return NULL;
+		}
+		if ( fseek(fp, 0, SEEK_END) == -1 || (flen= ftell(fp)) == -1 ||
+			fseek(fp, 0, SEEK_SET) == -1 )
+		{
+			perror(files[i]);
+			return NULL;
+		}
+
+		nbuf= realloc(buf, size+flen);
+		if ( nbuf == NULL ) {
+			perror("realloc");
+			return NULL;
+		}
+		buf= nbuf;
+
+		if ( fread(buf+size, 1, flen, fp) != (size_t) flen ) {
+			fprintf(stderr, "%s: short read\n", files[i]);
+			return NULL;
+		}
+		fclose(fp);
+
+		if ( mpz_batch_count(buf+size, flen) != PI_PART_LEN ) {
+			fprintf(stderr, "%s: not a partial pi sum\n", files[i]);
+			return NULL;
+		}
+
+		/* Keep the records, and drop this file's count */
+
+		memmove(buf+size, buf+size+BATCH_HDR_LEN, flen-BATCH_HDR_LEN);
+		size+= flen-BATCH_HDR_LEN;
+		count+= PI_PART_LEN;
+	}
+
+	buf[0]= count & 0xff;
+	buf[1]= (count >> 8) & 0xff;
+	buf[2]= (count >> 16) & 0xff;
+	buf[3]= (count >> 24) & 0xff;
+
+	*len= size;
+
+	return buf;
+}
+
+static int write_part (const char *file, const char *buf, size_t len)
+{
+	FILE *fp;
+
+	fp= ( file == NULL ) ? stdout : fopen(file, "wb");
+	if ( fp == NULL ) {
+		perror(file);
+		return 0;
+	}
+
+	if ( fwrite(buf, 1, len, fp) != len || fclose(fp) == EOF ) {
+		perror(( file == NULL ) ? "stdout" : file);
+		return 0;
+	}
+
+	return 1;
 }
 
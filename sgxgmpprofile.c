@@ -0,0 +1,483 @@
+/*
+
+Copyright 2018 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <sgx_urts.h>
+#include <gmp.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "EnclaveGmpTest_u.h"
+#include "backend.h"
+#include "bench_ops.h"
+#include "ecall_stats.h"
+#include "serialize.h"
+
+/*
+ * The forced fdiv paths aren't profiled, since e_mpf_div() only ever
+ * takes the ones BENCH_FDIV does.
+ */
+
+#define PROFILE_NOPS	(BENCH_PI+1)
+
+#define DEFAULT_MIN_BITS	1024
+#define DEFAULT_MAX_BYTES	(4UL*1024*1024)
+#define DEFAULT_MAX_PI_DIGITS	1000000
+#define DEFAULT_STACK_DEPTH	(768UL*1024)
+#define DEFAULT_MARGIN		25
+#define DEFAULT_CONFIG		"EnclaveGmpTest/EnclaveGmpTest.config.xml"
+
+/*
+ * Room for what the profile can't see: the trusted runtime's own heap
+ * use, and its stack frames on the way into an ECALL.
+ */
+
+#define HEAP_RESERVE		0x40000UL
+#define STACK_RESERVE		0x2000UL
+#define PAGE_SIZE		0x1000UL
+
+static const char *op_names[PROFILE_NOPS]= {
+	"add", "mul", "div", "fdiv", "pi"
+};
+
+/*
+ * The enclave memory one operation needed at one size.
+ *
+ *   heap     GMP's peak above what was already allocated
+ *   marshal  edger8r's copies of the operand strings
+ *   stack    the deepest stack use below the ECALL
+ */
+
+struct profile {
+	int op;
+	unsigned long bits;
+	unsigned long digits;
+	unsigned long heap;
+	unsigned long marshal;
+	unsigned long stack;
+	int ok;
+};
+
+static size_t stack_depth= DEFAULT_STACK_DEPTH;
+
+void usage ();
+
+static int profile_op (struct backend *be, struct profile *p,
+	gmp_randstate_t rs);
+static int write_config (const char *template, const char *path,
+	unsigned long heap, unsigned long stack, int have_fit, double slope,
+	double icept);
+static char *set_tag (char *xml, const char *tag, unsigned long value);
+static unsigned long page_round (double bytes);
+
+void usage () {
+	fprintf(stderr, "usage: sgxgmpprofile [-b backend] [-o op,...] [-s min_bits]\n");
+	fprintf(stderr, "          [-m max_bytes] [-f factor] [-p max_pi_digits]\n");
+	fprintf(stderr, "          [-d stack_depth] [-j jobs] [-M margin]\n");
+	fprintf(stderr, "          [-c template] [-w config]\n");
+	fprintf(stderr, "  -b  sgx or native (default: $%s, or sgx)\n",
+		BACKEND_ENV);
+	fprintf(stderr, "  -o  operations: add,mul,div,fdiv,pi (default: all)\n");
+	fprintf(stderr, "  -s  smallest operand, in bits (default: %d)\n",
+		DEFAULT_MIN_BITS);
+	fprintf(stderr, "  -m  largest operand, in bytes (default: %lu)\n",
+		DEFAULT_MAX_BYTES);
+	fprintf(stderr, "  -f  size multiplier between steps (default: 4)\n");
+	fprintf(stderr, "  -p  largest pi computation, in digits (default: %d)\n",
+		DEFAULT_MAX_PI_DIGITS);
+	fprintf(stderr, "  -d  bytes of stack to watch, must fit in StackMaxSize\n");
+	fprintf(stderr, "      (default: %lu)\n", DEFAULT_STACK_DEPTH);
+	fprintf(stderr, "  -j  operations that may run at once (default: 1)\n");
+	fprintf(stderr, "  -M  safety margin, in percent (default: %d)\n",
+		DEFAULT_MARGIN);
+	fprintf(stderr, "  -c  config to use as a template (default: %s)\n",
+		DEFAULT_CONFIG);
+	fprintf(stderr, "  -w  write a tuned enclave config here\n");
+	exit(1);
+}
+
+int main (int argc, char *argv[])
+{
+	struct backend be;
+	struct profile p;
+	const char *backend= NULL;
+	const char *template= DEFAULT_CONFIG;
+	const char *outpath= NULL;
+	unsigned long min_bits= DEFAULT_MIN_BITS;
+	unsigned long max_bytes= DEFAULT_MAX_BYTES;
+	unsigned long max_pi= DEFAULT_MAX_PI_DIGITS;
+	unsigned long factor= 4;
+	unsigned long max_heap= 0, max_stack= 0, heap, stack;
+	double margin= DEFAULT_MARGIN, px[2]= { 0, 0 }, py[2]= { 0, 0 };
+	double slope= 0, icept= 0;
+	int ops[PROFILE_NOPS]= { 1, 1, 1, 1, 1 };
+	int jobs= 1, npi= 0, failed= 0, saturated= 0;
+	gmp_randstate_t rs;
+	int opt, op;
+
+	while ( (opt= getopt(argc, argv, "b:c:d:f:hj:M:m:o:p:s:w:")) != -1 ) {
+		char *tok;
+
+		switch (opt) {
+		case 'b':
+			backend= optarg;
+			break;
+		case 'c':
+			template= optarg;
+			break;
+		case 'd':
+			stack_depth= strtoul(optarg, NULL, 0);
+			if ( stack_depth < 4096 ) usage();
+			break;
+		case 'f':
+			factor= strtoul(optarg, NULL, 10);
+			if ( factor < 2 ) usage();
+			break;
+		case 'j':
+			jobs= atoi(optarg);
+			if ( jobs < 1 ) usage();
+			break;
+		case 'M':
+			margin= atof(optarg);
+			if ( margin < 0 ) usage();
+			break;
+		case 'm':
+			max_bytes= strtoul(optarg, NULL, 10);
+			break;
+		case 'o':
+			memset(ops, 0, sizeof(ops));
+			for (tok= strtok(optarg, ","); tok; tok= strtok(NULL, ",")) {
+				for (op= 0; op< PROFILE_NOPS; ++op)
+					if ( strcmp(tok, op_names[op]) == 0 ) break;
+				if ( op == PROFILE_NOPS ) usage();
+				ops[op]= 1;
+			}
+			break;
+		case 'p':
+			max_pi= strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			min_bits= strtoul(optarg, NULL, 10);
+			if ( min_bits == 0 ) usage();
+			break;
+		case 'w':
+			outpath= optarg;
+			break;
+		case 'h':
+		default:
+			usage();
+		}
+	}
+
+	argc-= optind;
+	argv+= optind;
+
+	if ( argc != 0 ) usage();
+
+	if ( ! backend_open(&be, backend) ) return 1;
+
+	gmp_randinit_default(rs);
+
+	printf("op,bits,digits,heap_bytes,marshal_bytes,stack_bytes,ok\n");
+
+	for (op= 0; op< PROFILE_NOPS; ++op) {
+		unsigned long bits;
+
+		if ( ! ops[op] ) continue;
+
+		for (bits= min_bits; bits/8 <= max_bytes; bits*= factor) {
+			memset(&p, 0, sizeof(p));
+			p.op= op;
+			p.bits= bits;
+
+			if ( op == BENCH_FDIV || op == BENCH_PI )
+				p.digits= (unsigned long) (bits*log10(2))+1;
+			if ( op == BENCH_PI && p.digits > max_pi ) break;
+
+			if ( ! profile_op(&be, &p, rs) ) return 1;
+
+			printf("%s,%lu,%lu,%lu,%lu,%lu,%d\n", op_names[op], p.bits,
+				p.digits, p.heap, p.marshal, p.stack, p.ok);
+			fflush(stdout);
+
+			/* Larger sizes won't fit either. */
+
+			if ( ! p.ok ) {
+				++failed;
+				break;
+			}
+
+			if ( p.heap+p.marshal > max_heap ) max_heap= p.heap+p.marshal;
+			if ( p.stack > max_stack ) max_stack= p.stack;
+			if ( p.stack >= stack_depth ) saturated= 1;
+
+			if ( op == BENCH_PI ) {
+				px[0]= px[1];
+				py[0]= py[1];
+				px[1]= (double) p.digits;
+				py[1]= (double) (p.heap+p.marshal);
+				++npi;
+			}
+		}
+	}
+
+	if ( max_heap == 0 ) {
+		fprintf(stderr, "nothing was profiled\n");
+		return 1;
+	}
+
+	heap= page_round((double) (max_heap*jobs)*(1+margin/100)+HEAP_RESERVE);
+	stack= page_round((double) max_stack*(1+margin/100)+STACK_RESERVE);
+
+	fprintf(stderr, "peak heap %lu bytes, peak stack %lu bytes\n", max_heap,
+		max_stack);
+	fprintf(stderr, "HeapMaxSize 0x%lx, StackMaxSize 0x%lx\n", heap, stack);
+
+	/*
+	 * Pi's heap use grows a little faster than the digit count, so
+	 * rather than fit every run, draw the line through the two largest.
+	 * That is the better guide for extrapolating to bigger runs.
+	 */
+
+	if ( npi >= 2 && px[1] > px[0] ) {
+		slope= (py[1]-py[0])/(px[1]-px[0]);
+		icept= py[1]-slope*px[1];
+		fprintf(stderr, "e_pi heap: %.2f*digits%+.0f bytes\n", slope,
+			icept);
+		if ( slope > 0 ) {
+			fprintf(stderr, "e_pi digits that fit in one job: %.0f\n",
+				((double) (heap-HEAP_RESERVE)/(1+margin/100)-icept)/
+				slope);
+		}
+	}
+
+	if ( failed ) {
+		fprintf(stderr, "warning: some sizes failed, so the profile stops "
+			"short of them. Profile with a larger heap to cover them.\n");
+	}
+	if ( saturated ) {
+		fprintf(stderr, "warning: stack use reached the probe depth, so "
+			"the stack size is a lower bound. Use a larger -d.\n");
+	}
+
+	if ( outpath != NULL && ! write_config(template, outpath, heap, stack,
+		npi >= 2, slope, icept) ) return 1;
+
+	return 0;
+}
+
+static int profile_op (struct backend *be, struct profile *p,
+	gmp_randstate_t rs)
+{
+	struct heap_stats before, after;
+	sgx_status_t status;
+	mpz_t a, b;
+	char *str_a= NULL, *str_b= NULL, *str_c;
+	uint64_t used= 0;
+	size_t len;
+	int rv;
+
+	/*
+	 * Build the operands before the heap snapshot so that only the
+	 * enclave's allocations are counted, even in the native backend.
+	 */
+
+	if ( p->op != BENCH_PI ) {
+		mpz_inits(a, b, NULL);
+
+		mpz_urandomb(a, rs, p->bits);
+		mpz_setbit(a, p->bits-1);
+		if ( p->op == BENCH_DIV || p->op == BENCH_FDIV ) {
+			mpz_urandomb(b, rs, p->bits/2);
+			mpz_setbit(b, p->bits/2-1);
+		} else {
+			mpz_urandomb(b, rs, p->bits);
+			mpz_setbit(b, p->bits-1);
+		}
+
+		str_a= mpz_serialize(a);
+		str_b= mpz_serialize(b);
+		mpz_clears(a, b, NULL);
+
+		p->marshal= strlen(str_a)+strlen(str_b)+2;
+	}
+
+	if ( ! heap_snapshot(be, &before, 1) ) return 0;
+
+	status= be->e_stack_probe(be->eid, &len, stack_depth, p->op,
+		(str_a) ? str_a : "", (str_b) ? str_b : "", (int) p->digits, &used);
+	if ( status != SGX_SUCCESS ) {
+		fprintf(stderr, "ECALL e_stack_probe: 0x%04x\n", status);
+		return 0;
+	}
+
+	if ( ! heap_snapshot(be, &after, 0) ) return 0;
+
+	str_free(str_a);
+	str_free(str_b);
+
+	p->heap= after.peak_bytes-before.live_bytes;
+	p->stack= used;
+	p->ok= ( len != 0 && after.failures == 0 );
+
+	/* Fetch the result so that it doesn't count against the next run. */
+
+	if ( len ) {
+		str_c= malloc(len+1);
+		if ( str_c == NULL ) {
+			perror("malloc");
+			return 0;
+		}
+
+		status= be->e_get_result(be->eid, &rv, str_c, len);
+		free(str_c);
+		if ( status != SGX_SUCCESS ) {
+			fprintf(stderr, "ECALL e_get_result: 0x%04x\n", status);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Copy the template config, replacing HeapMaxSize and StackMaxSize and
+ * noting the pi fit in a comment.
+ */
+
+static int write_config (const char *template, const char *path,
+	unsigned long heap, unsigned long stack, int have_fit, double slope,
+	double icept)
+{
+	FILE *fp;
+	char *xml;
+	long sz;
+
+	fp= fopen(template, "r");
+	if ( fp == NULL ) {
+		perror(template);
+		return 0;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	sz= ftell(fp);
+	rewind(fp);
+
+	xml= malloc(sz+1);
+	if ( xml == NULL ) {
+		perror("malloc");
+		fclose(fp);
+		return 0;
+	}
+
+	if ( fread(xml, 1, sz, fp) != (size_t) sz ) {
+		perror(template);
+		fclose(fp);
+		free(xml);
+		return 0;
+	}
+	xml[sz]= '\0';
+	fclose(fp);
+
+	xml= set_tag(xml, "HeapMaxSize", heap);
+	if ( xml != NULL ) xml= set_tag(xml, "StackMaxSize", stack);
+	if ( xml == NULL ) {
+		fprintf(stderr, "%s: not an enclave config\n", template);
+		return 0;
+	}
+
+	fp= fopen(path, "w");
+	if ( fp == NULL ) {
+		perror(path);
+		free(xml);
+		return 0;
+	}
+
+	fprintf(fp, "<!-- Sized by sgxgmpprofile");
+	if ( have_fit )
+		fprintf(fp, ". e_pi heap: %.2f*digits%+.0f bytes", slope, icept);
+	fprintf(fp, " -->\n%s", xml);
+
+	free(xml);
+
+	if ( fclose(fp) != 0 ) {
+		perror(path);
+		return 0;
+	}
+
+	fprintf(stderr, "wrote %s\n", path);
+
+	return 1;
+}
+
+/* Replace the value of <tag>. Frees xml and returns NULL on error. */
+
+static char *set_tag (char *xml, const char *tag, unsigned long value)
+{
+	char open[64], close[64], val[32], *start, *end= NULL, *out;
+	size_t len;
+
+	snprintf(open, sizeof(open), "<%s>", tag);
+	snprintf(close, sizeof(close), "</%s>", tag);
+	snprintf(val, sizeof(val), "0x%lx", value);
+
+	start= strstr(xml, open);
+	if ( start != NULL ) end= strstr(start, close);
+	if ( start == NULL || end == NULL ) {
+		free(xml);
+		return NULL;
+	}
+	start+= strlen(open);
+
+	len= (start-xml)+strlen(val)+strlen(end)+1;
+	out= malloc(len);
+	if ( out == NULL ) {
+		free(xml);
+		return NULL;
+	}
+
+	memcpy(out, xml, start-xml);
+	strcpy(out+(start-xml), val);
+	strcat(out, end);
+	free(xml);
+
+	return out;
+}
+
+static unsigned long page_round (double bytes)
+{
+	unsigned long n= (unsigned long) ceil(bytes);
+
+	return (n+PAGE_SIZE-1) & ~(PAGE_SIZE-1);
+}
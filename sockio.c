@@ -0,0 +1,86 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sys/socket.h>
+#include <errno.h>
+#include <string.h>
+#include "sockio.h"
+
+int sock_sendv (int fd, struct iovec *iov, int n)
+{
+	while ( n ) {
+		struct msghdr msg;
+		ssize_t sent;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov= iov;
+		msg.msg_iovlen= n;
+
+		sent= sendmsg(fd, &msg, MSG_NOSIGNAL);
+		if ( sent == -1 ) {
+			if ( errno == EINTR ) continue;
+			return 0;
+		}
+
+		/* Skip past what went out, which may end mid-buffer. */
+
+		while ( n && (size_t) sent >= iov->iov_len ) {
+			sent-= iov->iov_len;
+			++iov;
+			--n;
+		}
+		if ( n ) {
+			iov->iov_base= (char *) iov->iov_base+sent;
+			iov->iov_len-= sent;
+		}
+	}
+
+	return 1;
+}
+
+ssize_t sock_recv (int fd, void *buf, size_t len)
+{
+	size_t got= 0;
+
+	while ( got < len ) {
+		ssize_t n= recv(fd, (char *) buf+got, len-got, 0);
+
+		if ( n == -1 ) {
+			if ( errno == EINTR ) continue;
+			return -1;
+		}
+		if ( n == 0 ) break;
+
+		got+= n;
+	}
+
+	return got;
+}
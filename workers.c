@@ -0,0 +1,110 @@
+/*
+Copyright 2019 Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sgx_urts.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "backend.h"
+#include "workers.h"
+
+/*
+ * Drive a job that was posted inside the enclave (see e_worker in
+ * EnclaveGmpTest.edl). Each host thread makes one ECALL to e_worker and
+ * stays in the enclave until the job has been exhausted.
+ */
+
+struct worker {
+	pthread_t thread;
+	struct backend *be;
+	sgx_status_t status;
+};
+
+static void *worker_main (void *arg);
+
+/*
+ * Clamp a requested thread count to what the enclave supports. Zero
+ * or less means one per online CPU.
+ */
+
+int enclave_threads (int requested)
+{
+	if ( requested <= 0 ) requested= (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if ( requested < 1 ) requested= 1;
+	if ( requested > ENCLAVE_MAX_THREADS ) requested= ENCLAVE_MAX_THREADS;
+
+	return requested;
+}
+
+static void *worker_main (void *arg)
+{
+	struct worker *w= (struct worker *) arg;
+	int rv;
+
+	w->status= w->be->e_worker(w->be->eid, &rv);
+
+	return NULL;
+}
+
+sgx_status_t enclave_run_job (struct backend *be, int nthreads,
+	size_t *len)
+{
+	struct worker w[ENCLAVE_MAX_THREADS];
+	sgx_status_t status= SGX_SUCCESS;
+	int i, started= 0;
+
+	nthreads= enclave_threads(nthreads);
+
+	/* With one thread, e_job_finish does the work itself. */
+
+	if ( nthreads > 1 ) {
+		for (i= 0; i< nthreads; ++i) {
+			w[i].be= be;
+			w[i].status= SGX_SUCCESS;
+			if ( pthread_create(&w[i].thread, NULL, worker_main, &w[i]) )
+				break;
+			++started;
+		}
+
+		for (i= 0; i< started; ++i) {
+			pthread_join(w[i].thread, NULL);
+			if ( w[i].status != SGX_SUCCESS ) status= w[i].status;
+		}
+	}
+
+	/* Always finish the job, even on error, so the enclave is released. */
+
+	if ( status == SGX_SUCCESS ) return be->e_job_finish(be->eid, len);
+
+	be->e_job_finish(be->eid, len);
+	*len= 0;
+
+	return status;
+}